@@ -0,0 +1,120 @@
+#include "acpi.h"
+#include "pmm.h"
+#include "paging.h"
+#include "kprintf.h"
+
+typedef struct {
+    char signature[8];                 // "RSD PTR "
+    UINT8 checksum;
+    char oem[6];
+    UINT8 revision;                    // 2 and up: the XSDT fields are valid
+    UINT32 rsdt;
+    UINT32 length;
+    UINT64 xsdt;
+    UINT8 extChecksum;
+    UINT8 reserved[3];
+} __attribute__((packed)) Rsdp;
+
+typedef struct {
+    char signature[4];
+    UINT32 length;
+    UINT8 revision;
+    UINT8 checksum;
+    char oem[6];
+    char oemTable[8];
+    UINT32 oemRevision;
+    UINT32 creator;
+    UINT32 creatorRevision;
+} __attribute__((packed)) SdtHeader;
+
+// MADT: the header, the local APIC address and flags, then variable-length entries
+#define MADT_LAPIC    0
+#define MADT_IOAPIC   1
+#define MADT_OVERRIDE 2
+
+static AcpiMadt g_madt;
+
+static int sum_ok(const void* p,UINT32 len){
+    UINT8 s = 0;
+    for(UINT32 i=0;i<len;i++) s += ((const UINT8*)p)[i];
+    return s==0;
+}
+
+// Tables may sit past the last RAM page paging_init mapped
+static void map_range(UINT32 addr,UINT32 len){
+    UINT32 phys;
+    for(UINT32 a=addr & ~(PAGE_SIZE-1); a<addr+len; a+=PAGE_SIZE)
+        if(!paging_translate(a,&phys)) paging_map(a,a,0);
+}
+
+static const SdtHeader* table_at(UINT32 addr){
+    map_range(addr,sizeof(SdtHeader));
+    const SdtHeader* h = (const SdtHeader*)(UINTPTR)addr;
+    map_range(addr,h->length);
+    return sum_ok(h,h->length) ? h : 0;
+}
+
+// The RSDP sits on a 16-byte boundary in the first KiB of the EBDA or in the BIOS ROM
+static const Rsdp* scan(UINT32 from,UINT32 to){
+    for(UINT32 a=from; a+sizeof(Rsdp)<=to; a+=16){
+        const Rsdp* r = (const Rsdp*)(UINTPTR)a;
+        const char* sig = r->signature;
+        if(sig[0]=='R' && sig[1]=='S' && sig[2]=='D' && sig[3]==' ' && sig[4]=='P' && sig[5]=='T' &&
+           sig[6]=='R' && sig[7]==' ' && sum_ok(r,20)) return r;
+    }
+    return 0;
+}
+
+static const SdtHeader* find_table(const Rsdp* rsdp,const char* sig){
+    int wide = rsdp->revision>=2 && rsdp->xsdt && rsdp->xsdt < ((UINT64)1<<32);
+    const SdtHeader* root = table_at(wide ? (UINT32)rsdp->xsdt : rsdp->rsdt);
+    if(!root) return 0;
+    UINT32 entry = wide ? 8 : 4;
+    UINT32 n = (root->length-sizeof(SdtHeader))/entry;
+    const UINT8* list = (const UINT8*)(root+1);
+    for(UINT32 i=0;i<n;i++){
+        UINT64 addr = wide ? *(const UINT64*)(list+i*8) : *(const UINT32*)(list+i*4);
+        if(addr >= ((UINT64)1<<32)) continue;
+        const SdtHeader* h = table_at((UINT32)addr);
+        if(h && h->signature[0]==sig[0] && h->signature[1]==sig[1] &&
+           h->signature[2]==sig[2] && h->signature[3]==sig[3]) return h;
+    }
+    return 0;
+}
+
+int acpi_init(void){
+    for(int i=0;i<16;i++){ g_madt.isaGsi[i] = (UINT32)i; g_madt.isaFlags[i] = 0; }
+    // The EBDA segment is in the BIOS data area on page 0, which paging keeps
+    // unmapped to catch NULL; map it read-only just for this (read in asm, as
+    // GCC treats a pointer this close to NULL as out of bounds)
+    UINT32 ebda;
+    paging_map(0,0,0);
+    __asm__ volatile("movzwl 0x40E,%0":"=r"(ebda));
+    ebda <<= 4;
+    paging_unmap(0);
+    const Rsdp* rsdp = ebda ? scan(ebda,ebda+1024) : 0;
+    if(!rsdp) rsdp = scan(0xE0000,0x100000);
+    if(!rsdp){ kprintf("ACPI: no RSDP, one CPU\n"); return 0; }
+    const SdtHeader* madt = find_table(rsdp,"APIC");
+    if(!madt){ kprintf("ACPI: no MADT, one CPU\n"); return 0; }
+
+    const UINT8* p = (const UINT8*)(madt+1);
+    g_madt.lapicBase = *(const UINT32*)p;
+    const UINT8* end = (const UINT8*)madt + madt->length;
+    for(p += 8; p+2<=end && p[1]>=2 && p+p[1]<=end; p += p[1]){
+        if(p[0]==MADT_LAPIC && (*(const UINT32*)(p+4) & 1) && g_madt.cpus<ACPI_MAX_CPUS){
+            g_madt.apicId[g_madt.cpus++] = p[3];           // enabled processor
+        }else if(p[0]==MADT_IOAPIC && !g_madt.ioapicBase){
+            g_madt.ioapicBase = *(const UINT32*)(p+4);
+            g_madt.ioapicGsiBase = *(const UINT32*)(p+8);
+        }else if(p[0]==MADT_OVERRIDE && p[2]==0 && p[3]<16){ // bus 0 is ISA
+            g_madt.isaGsi[p[3]] = *(const UINT32*)(p+4);
+            g_madt.isaFlags[p[3]] = *(const UINT16*)(p+8);
+        }
+    }
+    kprintf("ACPI: MADT lists %d CPU(s), local APIC at %x, I/O APIC at %x\n",
+            g_madt.cpus, g_madt.lapicBase, g_madt.ioapicBase);
+    return g_madt.cpus>0;
+}
+
+const AcpiMadt* acpi_madt(void){ return &g_madt; }
@@ -0,0 +1,26 @@
+#ifndef _ACPI_H_
+#define _ACPI_H_
+
+#include "kernel.h"
+
+// ======= ACPI: just enough for SMP =======
+// Finds the RSDP in the BIOS areas, walks the RSDT (or XSDT) to the MADT and
+// collects the processors' local APIC IDs, the I/O APIC and the ISA interrupt
+// overrides. Needs paging_init (tables outside RAM are mapped on demand).
+#define ACPI_MAX_CPUS 16
+
+typedef struct {
+    int cpus;                          // enabled processors, the boot one included
+    UINT8 apicId[ACPI_MAX_CPUS];
+    UINT32 lapicBase;
+    UINT32 ioapicBase;                 // 0 if the MADT lists none
+    UINT32 ioapicGsiBase;
+    UINT32 isaGsi[16];                 // ISA IRQ -> global system interrupt
+    UINT16 isaFlags[16];               // MPS polarity/trigger bits of the override
+} AcpiMadt;
+
+// 1 if a MADT was found
+int acpi_init(void);
+const AcpiMadt* acpi_madt(void);
+
+#endif
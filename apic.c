@@ -0,0 +1,87 @@
+#include "apic.h"
+#include "pmm.h"
+#include "paging.h"
+#include "interrupts.h"
+#include "kprintf.h"
+
+#define LAPIC_ID      0x020
+#define LAPIC_VERSION 0x030
+#define LAPIC_TPR     0x080
+#define LAPIC_SVR     0x0F0
+#define LAPIC_ICR_LO  0x300
+#define LAPIC_ICR_HI  0x310
+#define ICR_INIT      0x00000500
+#define ICR_STARTUP   0x00000600
+#define ICR_ASSERT    0x00004000
+#define ICR_PENDING   0x00001000
+
+#define IOAPIC_VERSION 0x01
+#define IOAPIC_REDIR   0x10
+#define REDIR_MASKED   0x00010000
+#define REDIR_LEVEL    0x00008000
+#define REDIR_LOW      0x00002000
+
+static volatile UINT32* g_lapic = 0;
+static volatile UINT32* g_ioapic = 0;
+
+static UINT32 lapic_read(UINT32 reg){ return g_lapic[reg/4]; }
+static void lapic_write(UINT32 reg,UINT32 v){ g_lapic[reg/4] = v; (void)g_lapic[LAPIC_ID/4]; }
+
+static UINT32 ioapic_read(UINT32 reg){ g_ioapic[0] = reg; return g_ioapic[4]; }
+static void ioapic_write(UINT32 reg,UINT32 v){ g_ioapic[0] = reg; g_ioapic[4] = v; }
+
+void lapic_enable(void){
+    lapic_write(LAPIC_TPR,0);
+    lapic_write(LAPIC_SVR,0x100 | APIC_SPURIOUS_VECTOR);
+}
+
+UINT8 lapic_id(void){ return g_lapic ? (UINT8)(lapic_read(LAPIC_ID)>>24) : 0; }
+int apic_ready(void){ return g_lapic!=0; }
+
+static void send_ipi(UINT8 apicId,UINT32 cmd){
+    lapic_write(LAPIC_ICR_HI,(UINT32)apicId<<24);
+    lapic_write(LAPIC_ICR_LO,cmd);
+    while(lapic_read(LAPIC_ICR_LO) & ICR_PENDING) __asm__ volatile("pause");
+}
+
+void lapic_send_init(UINT8 apicId){ send_ipi(apicId,ICR_INIT|ICR_ASSERT); }
+
+// The target starts in real mode at trampoline (page aligned, below 1 MiB)
+void lapic_send_startup(UINT8 apicId,UINT32 trampoline){
+    send_ipi(apicId,ICR_STARTUP|ICR_ASSERT|(trampoline>>12));
+}
+
+// ISA lines get the PIC's vectors, with polarity and trigger from the MADT
+// overrides (MPS flags: bits 0-1 polarity, 3 = active low; bits 2-3 trigger, 3 = level)
+static int ioapic_init(const AcpiMadt* madt,UINT8 bspId){
+    if(!madt->ioapicBase) return 0;
+    g_ioapic = (volatile UINT32*)paging_map_mmio(madt->ioapicBase,PAGE_SIZE,PAGE_UNCACHED);
+    if(!g_ioapic) return 0;
+    UINT32 lines = ((ioapic_read(IOAPIC_VERSION)>>16) & 0xFF) + 1;
+    for(UINT32 i=0;i<lines;i++){
+        ioapic_write(IOAPIC_REDIR+2*i,REDIR_MASKED);
+        ioapic_write(IOAPIC_REDIR+2*i+1,0);
+    }
+    for(int irq=0;irq<16;irq++){
+        UINT32 pin = madt->isaGsi[irq]-madt->ioapicGsiBase;
+        if(pin>=lines) continue;
+        UINT32 lo = REDIR_MASKED | (UINT32)(IRQ_BASE+irq);
+        if((madt->isaFlags[irq] & 3)==3) lo |= REDIR_LOW;
+        if(((madt->isaFlags[irq]>>2) & 3)==3) lo |= REDIR_LEVEL;
+        ioapic_write(IOAPIC_REDIR+2*pin,lo);
+        ioapic_write(IOAPIC_REDIR+2*pin+1,(UINT32)bspId<<24);
+    }
+    return (int)lines;
+}
+
+int apic_init(const AcpiMadt* madt){
+    if(!madt->lapicBase) return 0;
+    g_lapic = (volatile UINT32*)paging_map_mmio(madt->lapicBase,PAGE_SIZE,PAGE_UNCACHED);
+    if(!g_lapic) return 0;
+    lapic_enable();
+    UINT8 id = lapic_id();
+    int lines = ioapic_init(madt,id);
+    kprintf("APIC: boot CPU has local APIC %u (version %x), I/O APIC with %d lines (masked, the PIC keeps IRQs)\n",
+            id, lapic_read(LAPIC_VERSION) & 0xFF, lines);
+    return 1;
+}
@@ -0,0 +1,26 @@
+#ifndef _APIC_H_
+#define _APIC_H_
+
+#include "kernel.h"
+#include "acpi.h"
+
+// ======= Local APIC and I/O APIC =======
+// The local APIC is what the boot CPU uses to start the others (INIT and
+// STARTUP IPIs). Device interrupts stay on the 8259 PIC, whose EOI path
+// interrupts.c already has: the I/O APIC is programmed with the same vectors,
+// overrides and destination, but every entry is left masked.
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// Map and software-enable the boot CPU's local APIC, set up the I/O APIC; needs paging_init
+int apic_init(const AcpiMadt* madt);
+
+// For the other CPUs once they run on the kernel's page tables
+void lapic_enable(void);
+UINT8 lapic_id(void);
+int apic_ready(void);
+
+// Returns once the ICR has accepted the IPI
+void lapic_send_init(UINT8 apicId);
+void lapic_send_startup(UINT8 apicId,UINT32 trampoline);
+
+#endif
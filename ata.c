@@ -0,0 +1,308 @@
+#include "ata.h"
+#include "pci.h"
+#include "pmm.h"
+#include "interrupts.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "io.h"
+
+// Primary channel, master drive
+#define ATA_BASE 0x1F0
+#define ATA_CTRL 0x3F6
+
+#define REG_DATA    0
+#define REG_ERROR   1
+#define REG_COUNT   2
+#define REG_LBA0    3
+#define REG_LBA1    4
+#define REG_LBA2    5
+#define REG_DRIVE   6
+#define REG_STATUS  7
+#define REG_COMMAND 7
+
+#define ST_ERR  0x01
+#define ST_DRQ  0x08
+#define ST_DF   0x20
+#define ST_BSY  0x80
+
+#define CMD_READ_PIO   0x20
+#define CMD_WRITE_PIO  0x30
+#define CMD_READ_DMA   0xC8
+#define CMD_WRITE_DMA  0xCA
+#define CMD_FLUSH      0xE7
+#define CMD_IDENTIFY   0xEC
+
+// Bus-master IDE registers (offsets from BAR4, primary channel)
+#define BM_CMD    0
+#define BM_STATUS 2
+#define BM_PRDT   4
+
+#define BM_CMD_START 0x01
+#define BM_CMD_READ  0x08        // device -> memory
+#define BM_ST_ACTIVE 0x01
+#define BM_ST_ERR    0x02
+#define BM_ST_IRQ    0x04
+
+#define TIMEOUT 10000000
+
+#define SCRATCH_SECTORS (8*1024*1024/SECTOR_SIZE)
+
+typedef struct {
+    UINT32 addr;
+    UINT16 bytes;            // 0 means 64 KiB
+    UINT16 flags;            // bit 15: end of table
+} __attribute__((packed)) Prd;
+
+static BlockDev g_dev;
+static int g_present = 0;
+static UINT16 g_bm = 0;      // bus-master I/O base, 0 = no DMA
+static Prd* g_prdt = 0;
+static UINT8* g_bounce = 0;  // ATA_MAX_SECTORS*512 bytes, physically contiguous
+static volatile UINT32 g_irqs = 0;
+
+static void ata_irq(struct regs* r){
+    (void)r;
+    (void)inb(ATA_BASE+REG_STATUS);     // reading status acknowledges the drive
+    g_irqs++;
+}
+
+static int wait_not_busy(void){
+    for(int i=0;i<TIMEOUT;i++){
+        UINT8 st = inb(ATA_BASE+REG_STATUS);
+        if(!(st&ST_BSY)) return (st & (ST_ERR|ST_DF)) ? 0 : 1;
+    }
+    return 0;
+}
+
+static int wait_drq(void){
+    for(int i=0;i<TIMEOUT;i++){
+        UINT8 st = inb(ATA_BASE+REG_STATUS);
+        if(st & (ST_ERR|ST_DF)) return 0;
+        if(!(st&ST_BSY) && (st&ST_DRQ)) return 1;
+    }
+    return 0;
+}
+
+// 400ns settle: four reads of the alternate status register
+static void settle(void){
+    for(int i=0;i<4;i++) (void)inb(ATA_CTRL);
+}
+
+static int issue(UINT8 cmd,UINT32 lba,UINT32 count){
+    if(!wait_not_busy()) return 0;
+    outb(ATA_BASE+REG_DRIVE,0xE0 | ((lba>>24)&0x0F));
+    settle();
+    outb(ATA_BASE+REG_COUNT,(UINT8)(count==ATA_MAX_SECTORS ? 0 : count));
+    outb(ATA_BASE+REG_LBA0,(UINT8)lba);
+    outb(ATA_BASE+REG_LBA1,(UINT8)(lba>>8));
+    outb(ATA_BASE+REG_LBA2,(UINT8)(lba>>16));
+    outb(ATA_BASE+REG_COMMAND,cmd);
+    return 1;
+}
+
+static int check_range(UINT32 lba,UINT32 count){
+    return g_present && count>0 && count<=ATA_MAX_SECTORS && lba+count<=g_dev.sectors && lba<(1u<<28);
+}
+
+// ======= PIO =======
+int ata_read_pio(UINT32 lba,UINT32 count,void* buf){
+    if(!check_range(lba,count) || !issue(CMD_READ_PIO,lba,count)) return 0;
+    UINT16* p = (UINT16*)buf;
+    for(UINT32 s=0;s<count;s++){
+        if(!wait_drq()) return 0;
+        UINT32 words = 256;
+        __asm__ volatile("rep insw":"+D"(p),"+c"(words):"d"((UINT16)(ATA_BASE+REG_DATA)):"memory");
+    }
+    return 1;
+}
+
+int ata_write_pio(UINT32 lba,UINT32 count,const void* buf){
+    if(!check_range(lba,count) || !issue(CMD_WRITE_PIO,lba,count)) return 0;
+    const UINT16* p = (const UINT16*)buf;
+    for(UINT32 s=0;s<count;s++){
+        if(!wait_drq()) return 0;
+        for(int i=0;i<256;i++) outw(ATA_BASE+REG_DATA,*p++);
+    }
+    outb(ATA_BASE+REG_COMMAND,CMD_FLUSH);
+    return wait_not_busy();
+}
+
+// ======= Bus-master DMA =======
+// Build the PRD table for the bounce buffer; no entry may cross a 64 KiB boundary
+static void setup_prdt(UINT32 bytes){
+    UINT32 addr = (UINTPTR)g_bounce;
+    int n=0;
+    while(bytes){
+        UINT32 room = 0x10000 - (addr & 0xFFFF);
+        UINT32 chunk = bytes<room ? bytes : room;
+        g_prdt[n].addr = addr;
+        g_prdt[n].bytes = (UINT16)(chunk & 0xFFFF);
+        g_prdt[n].flags = 0;
+        addr += chunk; bytes -= chunk; n++;
+    }
+    g_prdt[n-1].flags = 0x8000;
+}
+
+static int dma_transfer(UINT8 cmd,UINT32 lba,UINT32 count,int toMemory){
+    setup_prdt(count*SECTOR_SIZE);
+    outl(g_bm+BM_PRDT,(UINTPTR)g_prdt);
+    outb(g_bm+BM_CMD,toMemory ? BM_CMD_READ : 0);
+    outb(g_bm+BM_STATUS,inb(g_bm+BM_STATUS) | BM_ST_ERR | BM_ST_IRQ);   // write 1 to clear
+    if(!issue(cmd,lba,count)) return 0;
+    outb(g_bm+BM_CMD,(toMemory ? BM_CMD_READ : 0) | BM_CMD_START);
+    int ok=0;
+    for(int i=0;i<TIMEOUT;i++){
+        UINT8 st = inb(g_bm+BM_STATUS);
+        if(st & BM_ST_ERR) break;
+        if((st & BM_ST_IRQ) && !(st & BM_ST_ACTIVE)){ ok=1; break; }
+        __asm__ volatile("pause");
+    }
+    outb(g_bm+BM_CMD,0);
+    outb(g_bm+BM_STATUS,BM_ST_ERR | BM_ST_IRQ);
+    UINT8 st = inb(ATA_BASE+REG_STATUS);
+    return ok && !(st & (ST_ERR|ST_DF));
+}
+
+int ata_read_dma(UINT32 lba,UINT32 count,void* buf){
+    if(!g_bm || !check_range(lba,count)) return 0;
+    if(!dma_transfer(CMD_READ_DMA,lba,count,1)) return 0;
+    kmemcpy(buf,g_bounce,count*SECTOR_SIZE);
+    return 1;
+}
+
+int ata_write_dma(UINT32 lba,UINT32 count,const void* buf){
+    if(!g_bm || !check_range(lba,count)) return 0;
+    kmemcpy(g_bounce,buf,count*SECTOR_SIZE);
+    if(!dma_transfer(CMD_WRITE_DMA,lba,count,0)) return 0;
+    outb(ATA_BASE+REG_COMMAND,CMD_FLUSH);
+    return wait_not_busy();
+}
+
+// ======= Block device glue =======
+static int dev_read(BlockDev* d,UINT32 lba,UINT32 count,void* buf){
+    (void)d;
+    UINT8* p=(UINT8*)buf;
+    while(count){
+        UINT32 n = count<ATA_MAX_SECTORS ? count : ATA_MAX_SECTORS;
+        int ok = g_bm ? ata_read_dma(lba,n,p) : ata_read_pio(lba,n,p);
+        if(!ok) return 0;
+        lba+=n; count-=n; p+=n*SECTOR_SIZE;
+    }
+    return 1;
+}
+
+static int dev_write(BlockDev* d,UINT32 lba,UINT32 count,const void* buf){
+    (void)d;
+    const UINT8* p=(const UINT8*)buf;
+    while(count){
+        UINT32 n = count<ATA_MAX_SECTORS ? count : ATA_MAX_SECTORS;
+        int ok = g_bm ? ata_write_dma(lba,n,p) : ata_write_pio(lba,n,p);
+        if(!ok) return 0;
+        lba+=n; count-=n; p+=n*SECTOR_SIZE;
+    }
+    return 1;
+}
+
+static void dma_init(void){
+    int bus,dev,fn;
+    if(!pci_find_class(0x01,0x01,&bus,&dev,&fn)) return;     // IDE controller
+    UINT32 bar4 = pci_read32(bus,dev,fn,0x20);
+    if(!(bar4&1)) return;                                    // must be an I/O BAR
+    g_prdt = (Prd*)(UINTPTR)pmm_alloc_page();
+    g_bounce = (UINT8*)(UINTPTR)pmm_alloc_pages(ATA_MAX_SECTORS*SECTOR_SIZE/PAGE_SIZE);
+    if(!g_prdt || !g_bounce) return;
+    // enable I/O decoding and bus mastering
+    pci_write16(bus,dev,fn,0x04,pci_read16(bus,dev,fn,0x04) | 0x05);
+    g_bm = (UINT16)(bar4 & 0xFFFC);
+}
+
+int ata_init(void){
+    if(inb(ATA_BASE+REG_STATUS)==0xFF) return 0;    // floating bus: no controller
+    outb(ATA_CTRL,0x00);                            // interrupts on (nIEN=0)
+    outb(ATA_BASE+REG_DRIVE,0xA0);
+    settle();
+    outb(ATA_BASE+REG_COUNT,0);
+    outb(ATA_BASE+REG_LBA0,0);
+    outb(ATA_BASE+REG_LBA1,0);
+    outb(ATA_BASE+REG_LBA2,0);
+    outb(ATA_BASE+REG_COMMAND,CMD_IDENTIFY);
+    if(inb(ATA_BASE+REG_STATUS)==0) return 0;       // no drive
+    for(int i=0;i<TIMEOUT;i++){ if(!(inb(ATA_BASE+REG_STATUS)&ST_BSY)) break; }
+    if(inb(ATA_BASE+REG_LBA1) || inb(ATA_BASE+REG_LBA2)) return 0;   // ATAPI/SATA signature
+    if(!wait_drq()) return 0;
+    UINT16 id[256];
+    for(int i=0;i<256;i++) id[i]=inw(ATA_BASE+REG_DATA);
+
+    g_dev.name = "hda";
+    g_dev.sectors = (UINT32)id[60] | ((UINT32)id[61]<<16);
+    g_dev.read = dev_read;
+    g_dev.write = dev_write;
+    if(g_dev.sectors==0) return 0;
+    if(g_dev.sectors > (1u<<28)) g_dev.sectors = 1u<<28;   // LBA28 addressing only
+    g_present = 1;
+    irq_register(14,ata_irq);
+    dma_init();
+    blockdev_register(&g_dev);
+    kprintf("ATA: hda %u MiB, %s\n", g_dev.sectors/2048, g_bm ? "bus-master DMA" : "PIO");
+    return 1;
+}
+
+BlockDev* ata_device(void){ return g_present ? &g_dev : 0; }
+int ata_has_dma(void){ return g_bm!=0; }
+
+// ======= Benchmark =======
+UINT32 ata_scratch_start(void){
+    if(!g_present || g_dev.sectors < 4*SCRATCH_SECTORS) return g_present ? g_dev.sectors : 0;
+    return g_dev.sectors - SCRATCH_SECTORS;
+}
+
+static UINT32 mb_per_s(UINT64 bytes,UINT64 cycles){
+    return (UINT32)(per_second(bytes,cycles)/(1024*1024));
+}
+
+void ata_benchmark(void){
+    UINT32 base = ata_scratch_start();
+    if(!g_present || base==g_dev.sectors){
+        kprintf("ATA bench: skipped (need a disk of at least 32 MiB)\n");
+        return;
+    }
+    UINT32 chunk = ATA_MAX_SECTORS;
+    UINT32 bytes = chunk*SECTOR_SIZE;
+    UINT8* buf = (UINT8*)(UINTPTR)pmm_alloc_pages(bytes/PAGE_SIZE);
+    if(!buf) return;
+    for(UINT32 i=0;i<bytes;i++) buf[i]=(UINT8)(i*7);
+    UINT32 total = 4*1024*1024/SECTOR_SIZE;       // 4 MiB sequential
+
+    int (*wr)(UINT32,UINT32,const void*) = g_bm ? ata_write_dma : ata_write_pio;
+    int (*rd)(UINT32,UINT32,void*) = g_bm ? ata_read_dma : ata_read_pio;
+
+    UINT64 t0=rdtsc();
+    for(UINT32 s=0;s<total;s+=chunk) wr(base+s,chunk,buf);
+    UINT64 t1=rdtsc();
+    for(UINT32 s=0;s<total;s+=chunk) rd(base+s,chunk,buf);
+    UINT64 t2=rdtsc();
+    for(UINT32 s=0;s<total/4;s+=chunk) ata_read_pio(base+s,chunk,buf);
+    UINT64 t3=rdtsc();
+    kprintf("ATA bench seq (%s): write %u MB/s, read %u MB/s; PIO read %u MB/s\n",
+            g_bm ? "DMA" : "PIO", mb_per_s((UINT64)total*SECTOR_SIZE,t1-t0),
+            mb_per_s((UINT64)total*SECTOR_SIZE,t2-t1), mb_per_s((UINT64)total/4*SECTOR_SIZE,t3-t2));
+
+    // random 4 KiB (8-sector) operations across the scratch area
+    const int ops = 256;
+    UINT32 seed = 12345;
+    UINT64 t4=rdtsc();
+    for(int i=0;i<ops;i++){
+        seed = seed*1103515245u+12345u;
+        rd(base + ((seed>>8) % (SCRATCH_SECTORS/8))*8, 8, buf);
+    }
+    UINT64 t5=rdtsc();
+    for(int i=0;i<ops;i++){
+        seed = seed*1103515245u+12345u;
+        wr(base + ((seed>>8) % (SCRATCH_SECTORS/8))*8, 8, buf);
+    }
+    UINT64 t6=rdtsc();
+    kprintf("ATA bench random 4K: read %llu IOPS, write %llu IOPS\n",
+            per_second(ops,t5-t4), per_second(ops,t6-t5));
+    pmm_free_pages((UINTPTR)buf,bytes/PAGE_SIZE);
+}
@@ -0,0 +1,24 @@
+#ifndef _ATA_H_
+#define _ATA_H_
+
+#include "blockdev.h"
+
+#define ATA_MAX_SECTORS 256          // per command (LBA28 count 0 = 256)
+
+// Probe the primary master; registers it as a block device. Returns 1 if found.
+// Bus-master DMA is used when a PCI IDE controller is present, PIO otherwise.
+int ata_init(void);
+BlockDev* ata_device(void);
+int ata_has_dma(void);
+
+// Direct transfer paths (at most ATA_MAX_SECTORS per call), used by the benchmark
+int ata_read_pio(UINT32 lba,UINT32 count,void* buf);
+int ata_write_pio(UINT32 lba,UINT32 count,const void* buf);
+int ata_read_dma(UINT32 lba,UINT32 count,void* buf);
+int ata_write_dma(UINT32 lba,UINT32 count,const void* buf);
+
+// Sequential MB/s and random 4 KiB IOPS on a scratch area at the end of the disk
+void ata_benchmark(void);
+UINT32 ata_scratch_start(void);
+
+#endif
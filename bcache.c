@@ -0,0 +1,282 @@
+#include "bcache.h"
+#include "pmm.h"
+#include "heap.h"
+#include "kprintf.h"
+#include "kstring.h"
+
+#define MAX_RUN 32                    // blocks per merged device transfer (128 KiB)
+#define RA_MIN 2
+#define RA_MAX 32
+
+#define B_VALID 1
+#define B_DIRTY 2
+#define B_AHEAD 4                     // brought in by read-ahead, not yet used
+
+typedef struct Buf Buf;
+struct Buf {
+    BlockDev* dev;                    // the underlying device
+    UINT32 block;
+    UINT32 flags;
+    Buf* hnext;
+    Buf* prev;                        // LRU list, head = most recent
+    Buf* next;
+    UINT8* data;
+};
+
+typedef struct {
+    BlockDev dev;                     // must be first: the wrapper is used as a BlockDev
+    BlockDev* lower;
+    UINT32 lastBlock;                 // for sequential detection
+    UINT32 raWindow;
+} CachedDev;
+
+static Buf* g_bufs = 0;
+static UINT32 g_nbufs = 0;
+static Buf** g_hash = 0;
+static UINT32 g_nhash = 0;
+static Buf* g_lruHead = 0;
+static Buf* g_lruTail = 0;
+static UINT8* g_stage = 0;            // MAX_RUN blocks, for merged reads and writes
+static BcacheStats g_stats;
+static CachedDev g_wrapped[MAX_BLOCKDEVS];
+
+static UINT32 hash_of(BlockDev* dev,UINT32 block){
+    return ((UINT32)dev->id*2654435761u ^ block*40503u) & (g_nhash-1);
+}
+
+
+// ======= LRU and hash maintenance =======
+static void lru_unlink(Buf* b){
+    if(b->prev) b->prev->next=b->next; else g_lruHead=b->next;
+    if(b->next) b->next->prev=b->prev; else g_lruTail=b->prev;
+    b->prev=b->next=0;
+}
+
+static void lru_push(Buf* b){
+    b->prev=0;
+    b->next=g_lruHead;
+    if(g_lruHead) g_lruHead->prev=b;
+    g_lruHead=b;
+    if(!g_lruTail) g_lruTail=b;
+}
+
+static void lru_touch(Buf* b){
+    if(g_lruHead==b) return;
+    lru_unlink(b);
+    lru_push(b);
+}
+
+static void hash_remove(Buf* b){
+    Buf** pp=&g_hash[hash_of(b->dev,b->block)];
+    while(*pp && *pp!=b) pp=&(*pp)->hnext;
+    if(*pp) *pp=b->hnext;
+    b->hnext=0;
+}
+
+static Buf* lookup(BlockDev* dev,UINT32 block){
+    for(Buf* b=g_hash[hash_of(dev,block)]; b; b=b->hnext){
+        if(b->dev==dev && b->block==block && (b->flags&B_VALID)) return b;
+    }
+    return 0;
+}
+
+void bcache_init(UINT32 blocks){
+    g_nbufs = blocks;
+    g_bufs = (Buf*)kzalloc(blocks*sizeof(Buf));
+    g_nhash = 1; while(g_nhash<blocks) g_nhash<<=1;
+    g_hash = (Buf**)kzalloc(g_nhash*sizeof(Buf*));
+    UINT8* pool = (UINT8*)(UINTPTR)pmm_alloc_pages(blocks*BCACHE_BLOCK_SIZE/PAGE_SIZE);
+    g_stage = (UINT8*)(UINTPTR)pmm_alloc_pages(MAX_RUN*BCACHE_BLOCK_SIZE/PAGE_SIZE);
+    if(!g_bufs || !g_hash || !pool || !g_stage){ g_nbufs=0; return; }
+    for(UINT32 i=0;i<blocks;i++){
+        g_bufs[i].data = pool + i*BCACHE_BLOCK_SIZE;
+        lru_push(&g_bufs[i]);
+    }
+}
+
+// ======= Write-back =======
+static UINT32 dev_blocks(BlockDev* dev){ return dev->sectors/BCACHE_BLOCK_SECTORS; }
+
+// Write a run of dirty blocks starting at 'first' (which must be dirty) as one I/O
+static int write_run(BlockDev* dev,UINT32 first){
+    Buf* run[MAX_RUN]; UINT32 n=0;
+    while(n<MAX_RUN){
+        Buf* b = lookup(dev,first+n);
+        if(!b || !(b->flags&B_DIRTY)) break;
+        run[n++]=b;
+    }
+    if(n==0) return 1;
+    for(UINT32 i=0;i<n;i++) kmemcpy(g_stage+i*BCACHE_BLOCK_SIZE,run[i]->data,BCACHE_BLOCK_SIZE);
+    g_stats.writeIos++;
+    if(!dev->write(dev,first*BCACHE_BLOCK_SECTORS,n*BCACHE_BLOCK_SECTORS,g_stage)) return 0;
+    for(UINT32 i=0;i<n;i++) run[i]->flags &= ~B_DIRTY;
+    g_stats.writebacks += n;
+    return 1;
+}
+
+int bcache_sync(BlockDev* dev){
+    BlockDev* lower = dev;
+    for(int i=0;i<MAX_BLOCKDEVS;i++) if(dev==&g_wrapped[i].dev) lower=g_wrapped[i].lower;
+    int ok=1;
+    // repeatedly take the lowest dirty block so runs are written in ascending
+    // order; that is for the disk's sake, not an ordering callers may rely on
+    for(;;){
+        Buf* lowest=0;
+        for(UINT32 i=0;i<g_nbufs;i++){
+            Buf* b=&g_bufs[i];
+            if(!(b->flags&B_DIRTY) || (lower && b->dev!=lower)) continue;
+            if(!lowest || b->dev->id < lowest->dev->id ||
+               (b->dev==lowest->dev && b->block<lowest->block)) lowest=b;
+        }
+        if(!lowest) break;
+        if(!write_run(lowest->dev,lowest->block)){ ok=0; break; }
+    }
+    return ok;
+}
+
+// Take the least recently used buffer, writing it (and dirty neighbours) back first
+static Buf* evict(void){
+    for(Buf* b=g_lruTail; b; b=b->prev){
+        if(!(b->flags&B_VALID)){
+            if(b->dev) hash_remove(b);       // claimed but never filled
+            return b;
+        }
+        if(b->flags&B_DIRTY){
+            // start the merged write at the first dirty block of this neighbourhood,
+            // but close enough that the run still reaches b
+            UINT32 first=b->block, lowest=b->block>=MAX_RUN ? b->block-MAX_RUN+1 : 0;
+            while(first>lowest){ Buf* p=lookup(b->dev,first-1); if(!p || !(p->flags&B_DIRTY)) break; first--; }
+            if(!write_run(b->dev,first) || (b->flags&B_DIRTY)) continue;
+        }
+        hash_remove(b);
+        b->flags=0;
+        g_stats.evictions++;
+        return b;
+    }
+    return 0;
+}
+
+static Buf* claim(BlockDev* dev,UINT32 block){
+    Buf* b = evict();
+    if(!b) return 0;
+    b->dev=dev; b->block=block; b->flags=0;
+    UINT32 h=hash_of(dev,block);
+    b->hnext=g_hash[h]; g_hash[h]=b;
+    lru_touch(b);
+    return b;
+}
+
+// ======= Reads with read-ahead =======
+// Fetch 'count' uncached blocks starting at 'block' in one device read
+static int fill_run(BlockDev* dev,UINT32 block,UINT32 count,UINT32 aheadFrom){
+    if(count>MAX_RUN) count=MAX_RUN;
+    if(count>g_nbufs/2) count=g_nbufs/2 ? g_nbufs/2 : 1;
+    // claim first: evictions may write back through the staging buffer
+    Buf* run[MAX_RUN];
+    for(UINT32 i=0;i<count;i++){
+        run[i]=claim(dev,block+i);
+        if(!run[i]){ count=i; break; }
+    }
+    g_stats.readIos++;
+    int ok = count && dev->read(dev,block*BCACHE_BLOCK_SECTORS,count*BCACHE_BLOCK_SECTORS,g_stage);
+    for(UINT32 i=0;i<count;i++){
+        if(!ok){ hash_remove(run[i]); continue; }
+        kmemcpy(run[i]->data,g_stage+i*BCACHE_BLOCK_SIZE,BCACHE_BLOCK_SIZE);
+        run[i]->flags=B_VALID;
+        if(block+i>=aheadFrom){ run[i]->flags|=B_AHEAD; g_stats.readaheadBlocks++; }
+    }
+    return ok;
+}
+
+static Buf* get_block(CachedDev* cd,UINT32 block){
+    BlockDev* dev=cd->lower;
+    Buf* b=lookup(dev,block);
+    int sequential = (block==cd->lastBlock+1);
+    cd->lastBlock=block;
+    if(b){
+        g_stats.hits++;
+        if(b->flags&B_AHEAD){ b->flags&=~B_AHEAD; g_stats.readaheadHits++; }
+        lru_touch(b);
+        return b;
+    }
+    g_stats.misses++;
+    // grow the window while access stays sequential, fall back to one block otherwise
+    cd->raWindow = sequential ? (cd->raWindow*2>RA_MAX ? RA_MAX : cd->raWindow*2) : RA_MIN;
+    UINT32 n = sequential ? cd->raWindow : 1;
+    UINT32 maxb = dev_blocks(dev);
+    if(block+n>maxb) n=maxb-block;
+    // stop at the first block that is already cached
+    for(UINT32 i=1;i<n;i++) if(lookup(dev,block+i)){ n=i; break; }
+    if(!fill_run(dev,block,n,block+1)) return 0;
+    return lookup(dev,block);
+}
+
+static int cached_read(BlockDev* d,UINT32 lba,UINT32 count,void* buf){
+    CachedDev* cd=(CachedDev*)d;
+    UINT8* out=(UINT8*)buf;
+    while(count){
+        UINT32 block=lba/BCACHE_BLOCK_SECTORS, off=lba%BCACHE_BLOCK_SECTORS;
+        UINT32 n=BCACHE_BLOCK_SECTORS-off; if(n>count) n=count;
+        Buf* b = block<dev_blocks(cd->lower) ? get_block(cd,block) : 0;
+        if(b) kmemcpy(out,b->data+off*SECTOR_SIZE,n*SECTOR_SIZE);
+        else if(!cd->lower->read(cd->lower,lba,n,out)) return 0;   // tail beyond whole blocks
+        out+=n*SECTOR_SIZE; lba+=n; count-=n;
+    }
+    return 1;
+}
+
+static int cached_write(BlockDev* d,UINT32 lba,UINT32 count,const void* buf){
+    CachedDev* cd=(CachedDev*)d;
+    const UINT8* in=(const UINT8*)buf;
+    while(count){
+        UINT32 block=lba/BCACHE_BLOCK_SECTORS, off=lba%BCACHE_BLOCK_SECTORS;
+        UINT32 n=BCACHE_BLOCK_SECTORS-off; if(n>count) n=count;
+        if(block>=dev_blocks(cd->lower)){
+            if(!cd->lower->write(cd->lower,lba,n,in)) return 0;
+        }else{
+            Buf* b=lookup(cd->lower,block);
+            int fresh=0;
+            if(!b && n<BCACHE_BLOCK_SECTORS){                        // partial: read-modify-write
+                b=get_block(cd,block);
+                if(!b) return 0;
+            }
+            if(!b){ b=claim(cd->lower,block); if(!b) return 0; b->flags=B_VALID; fresh=1; }
+            else lru_touch(b);
+            UINT8* dst=b->data+off*SECTOR_SIZE;
+            if(!fresh && kmemcmp(dst,in,n*SECTOR_SIZE)==0){
+                g_stats.cleanSkips++;
+            }else{
+                kmemcpy(dst,in,n*SECTOR_SIZE);
+                b->flags|=B_DIRTY;
+            }
+            b->flags&=~B_AHEAD;
+        }
+        in+=n*SECTOR_SIZE; lba+=n; count-=n;
+    }
+    return 1;
+}
+
+BlockDev* bcache_wrap(BlockDev* lower){
+    if(!lower || lower->id<0 || lower->id>=MAX_BLOCKDEVS || !g_nbufs) return lower;
+    CachedDev* cd=&g_wrapped[lower->id];
+    cd->lower=lower;
+    cd->dev.id=lower->id;
+    cd->dev.name=lower->name;
+    cd->dev.sectors=lower->sectors;
+    cd->dev.read=cached_read;
+    cd->dev.write=cached_write;
+    cd->lastBlock=0xFFFFFFFF;
+    cd->raWindow=RA_MIN;
+    return &cd->dev;
+}
+
+const BcacheStats* bcache_stats(void){ return &g_stats; }
+
+void bcache_report(void){
+    UINT32 lookups = g_stats.hits+g_stats.misses;
+    kprintf("bcache: %u blocks, hit %u miss %u (%u%% hits), evict %u\n",
+            g_nbufs, g_stats.hits, g_stats.misses, lookups ? g_stats.hits*100/lookups : 0, g_stats.evictions);
+    kprintf("bcache: read-ahead %u blocks (%u used), %u reads; write-back %u blocks in %u writes, %u unchanged skipped\n",
+            g_stats.readaheadBlocks, g_stats.readaheadHits, g_stats.readIos,
+            g_stats.writebacks, g_stats.writeIos, g_stats.cleanSkips);
+}
@@ -0,0 +1,38 @@
+#ifndef _BCACHE_H_
+#define _BCACHE_H_
+
+#include "blockdev.h"
+
+// ======= Block cache =======
+// 4 KiB blocks keyed by (device, block number), LRU eviction, sequential
+// read-ahead and write-back with adjacent dirty blocks merged into one I/O.
+#define BCACHE_BLOCK_SIZE 4096
+#define BCACHE_BLOCK_SECTORS (BCACHE_BLOCK_SIZE/SECTOR_SIZE)
+
+typedef struct {
+    UINT32 hits;
+    UINT32 misses;
+    UINT32 readaheadBlocks;   // blocks fetched speculatively
+    UINT32 readaheadHits;     // ...that were later used
+    UINT32 evictions;
+    UINT32 writebacks;        // dirty blocks written
+    UINT32 writeIos;          // device write calls (after merging)
+    UINT32 readIos;
+    UINT32 cleanSkips;        // writes that matched the cached data
+} BcacheStats;
+
+void bcache_init(UINT32 blocks);
+
+// A BlockDev whose reads and writes go through the cache; writes stay dirty
+// in memory until bcache_sync() or eviction
+BlockDev* bcache_wrap(BlockDev* lower);
+
+// Write back every dirty block of 'dev' (0 = all devices); 1 on success.
+// Blocks go out in no promised order: to have one write reach the disk after
+// others, sync those first.
+int bcache_sync(BlockDev* dev);
+
+const BcacheStats* bcache_stats(void);
+void bcache_report(void);
+
+#endif
@@ -0,0 +1,149 @@
+#include "bench.h"
+#include "clock.h"
+#include "heap.h"
+#include "memfs.h"
+#include "keyboard.h"
+#include "expr.h"
+#include "ui.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "serial.h"
+#include "io.h"
+
+typedef struct {
+    const char* name;
+    bench_fn fn;
+    UINT32 iters;
+} BenchCase;
+
+static BenchCase g_cases[BENCH_MAX_CASES];
+static int g_ncases = 0;
+
+void bench_add(const char* name,bench_fn fn,UINT32 iters){
+    if(g_ncases==BENCH_MAX_CASES){ kprintf("bench: registry full, dropping %s\n", name); return; }
+    g_cases[g_ncases].name = name;
+    g_cases[g_ncases].fn = fn;
+    g_cases[g_ncases].iters = iters ? iters : 1;
+    g_ncases++;
+}
+
+int bench_run_all(void){
+    int failed = 0;
+    kprintf("BENCH-BEGIN %u cases, %llu MHz TSC\n", g_ncases, tsc_hz()/1000000);
+    for(int i=0;i<g_ncases;i++){
+        BenchCase* c = &g_cases[i];
+        int ok = c->fn(c->iters);            // warm caches and lazily built state
+        UINT64 best = ~0ULL;
+        for(int r=0;r<BENCH_REPS && ok;r++){
+            UINT64 t0 = rdtsc();
+            ok = c->fn(c->iters);
+            UINT64 dt = rdtsc()-t0;
+            if(dt<best) best=dt;
+        }
+        if(!ok){ kprintf("BENCH-FAIL %s\n", c->name); failed++; continue; }
+        // cycles and ns per operation, with two decimals kept as fixed point
+        UINT64 cyc100 = best*100/c->iters;
+        UINT64 ns100 = cycles_to_ns(best)*100/c->iters;
+        kprintf("BENCH %s %u %llu.%02llu %llu.%02llu\n", c->name, c->iters,
+                cyc100/100, cyc100%100, ns100/100, ns100%100);
+    }
+    kprintf("BENCH-END %u failed\n", failed);
+    return failed;
+}
+
+#ifndef HOSTED
+void qemu_exit(UINT8 code){
+    serial_flush();                 // the runner reads results from COM1
+    outb(QEMU_EXIT_PORT,code);
+    for(;;) __asm__ volatile("cli; hlt");
+}
+#endif
+
+// ======= Built-in cases =======
+static char g_file[4096];
+
+static char g_copy[4096];
+
+static int bench_memcpy(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++) kmemcpy(g_copy,g_file,sizeof(g_file));
+    return kmemcmp(g_copy,g_file,sizeof(g_file))==0;
+}
+
+static int bench_memset(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++) kmemset(g_copy,(int)i,sizeof(g_copy));
+    char last = (char)(iters-1);
+    return g_copy[0]==last && g_copy[sizeof(g_copy)-1]==last;
+}
+
+// Overlapping by one byte in the expensive direction, like a gap buffer insert
+static int bench_memmove(UINT32 iters){
+    g_copy[0] = 'm';
+    for(UINT32 i=0;i<iters;i++) kmemmove(g_copy+1,g_copy,sizeof(g_copy)-1);
+    return g_copy[iters<sizeof(g_copy) ? iters : sizeof(g_copy)-1]=='m';
+}
+
+static int bench_memfs_save(UINT32 iters){
+    int ok = 1;
+    for(UINT32 i=0;i<iters;i++) ok &= memfs_save("bench.txt",g_file,sizeof(g_file));
+    return ok;
+}
+
+static int bench_memfs_load(UINT32 iters){
+    int len, ok = 1;
+    for(UINT32 i=0;i<iters;i++)
+        ok &= memfs_load("bench.txt",g_file,sizeof(g_file),&len) && len==(int)sizeof(g_file);
+    return ok;
+}
+
+// A key through the whole input path: serial console translation, the
+// scancode ring, and getkey's filtering
+static int bench_keyboard(UINT32 iters){
+    int ok = 1;
+    for(UINT32 i=0;i<iters;i++){
+        kbd_feed_ascii('a');
+        ok &= getkey()==0x1E;
+    }
+    return ok;
+}
+
+static int bench_kmalloc(UINT32 iters){
+    int ok = 1;
+    for(UINT32 i=0;i<iters;i++){
+        void* p = kmalloc(64);
+        if(!p) ok = 0;
+        kfree(p);
+    }
+    return ok;
+}
+
+static ExprEnv g_env;
+static ExprProgram g_prog;
+
+// (x+1)*(x-1)/2+x^2 at x=3
+static int bench_expr_eval(UINT32 iters){
+    double v = 0;
+    int ok = 1;
+    for(UINT32 i=0;i<iters;i++) ok &= expr_run(&g_prog,&g_env,&v)==EXPR_OK;
+    return ok && v==13;
+}
+
+void bench_add_builtin(void){
+    for(UINT32 i=0;i<sizeof(g_file);i++) g_file[i] = (char)('a' + i%26);
+    expr_env_init(&g_env);
+    expr_set(&g_env,"x",3);
+    expr_compile("(x+1)*(x-1)/2+x^2",&g_prog,&g_env);
+
+    bench_add("memcpy_4k",bench_memcpy,1000);
+    bench_add("memset_4k",bench_memset,1000);
+    bench_add("memmove_4k",bench_memmove,1000);
+    bench_add("memfs_save_4k",bench_memfs_save,64);
+    bench_add("memfs_load_4k",bench_memfs_load,64);
+    bench_add("keyboard_key",bench_keyboard,200);
+    bench_add("kmalloc_kfree_64",bench_kmalloc,1000);
+    bench_add("expr_eval",bench_expr_eval,1000);
+    bench_add("clearScreen",ui_bench_clear_screen,100);
+    bench_add("vga_full_repaint",ui_bench_full_repaint,20);
+    bench_add("gfx_text_redraw",ui_bench_gfx_redraw,4);
+    bench_add("scrollIfNeeded",ui_bench_scroll,1000);
+    bench_add("console_line_80",ui_bench_console_line,100);
+}
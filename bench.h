@@ -0,0 +1,38 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "kernel.h"
+
+// ======= Microbenchmark suite =======
+// Kernels built with -DBENCH_BUILD (./run.sh bench) run every registered case
+// after boot, print one machine-readable line per case on the log, and power
+// QEMU off through the isa-debug-exit device. Each case runs 'iters'
+// operations per call and returns 0 when its work failed or its result was
+// wrong; the best of BENCH_REPS calls is reported, or a failure:
+//
+//   BENCH <name> <iters> <cycles/op> <ns/op>
+//   BENCH-FAIL <name>
+#define BENCH_MAX_CASES 32
+#define BENCH_REPS 7
+
+// isa-debug-exit at port 0xF4: QEMU exits with status (code<<1)|1
+#define QEMU_EXIT_PORT 0xF4
+#define BENCH_EXIT_OK 0x10        // status 33
+#define BENCH_EXIT_FAIL 0x11      // status 35
+
+typedef int (*bench_fn)(UINT32 iters);
+
+void bench_add(const char* name,bench_fn fn,UINT32 iters);
+
+// Registers the cases for memfs, the keyboard path, the heap, expr and the
+// screen (ui.c)
+void bench_add_builtin(void);
+
+// Runs everything registered; returns the number of cases that failed
+int bench_run_all(void);
+
+// Never returns: exits QEMU, or halts when the device is absent (the hosted
+// build supplies its own, which exits the process)
+void qemu_exit(UINT8 code);
+
+#endif
@@ -0,0 +1,674 @@
+#include "bignum.h"
+
+#define KARATSUBA_THRESHOLD 32   // limbs; below this schoolbook wins
+#define DEC_BASE 1000000000u     // 10^9: nine decimal digits per limb
+#define DEC_DIGITS 9
+#define CONVERT_THRESHOLD 40     // limbs converted by the quadratic base case
+#define MAX_POWERS 32            // 10^(9*2^31) is far beyond any memory we have
+#define NEWTON_THRESHOLD 32      // reciprocals of divisors this small come from Knuth D
+#define BARRETT_THRESHOLD 1500   // divisor limbs from which reciprocal division beats Knuth D
+
+static void* (*g_alloc)(unsigned int);
+static void (*g_release)(void*);
+
+void bn_set_allocator(void* (*alloc)(unsigned int),void (*release)(void*)){
+    g_alloc=alloc;
+    g_release=release;
+}
+
+static bn_limb* limbs_alloc(int n){
+    return g_alloc ? (bn_limb*)g_alloc((unsigned int)(n>0 ? n : 1)*sizeof(bn_limb)) : 0;
+}
+
+static void limbs_free(void* p){
+    if(p && g_release) g_release(p);
+}
+
+// ======= Limb arrays =======
+static void zero(bn_limb* r,int n){ for(int i=0;i<n;i++) r[i]=0; }
+static void copy(bn_limb* r,const bn_limb* a,int n){ for(int i=0;i<n;i++) r[i]=a[i]; }
+
+static int len_of(const bn_limb* a,int n){
+    while(n && !a[n-1]) n--;
+    return n;
+}
+
+static int cmp_mag(const bn_limb* a,int an,const bn_limb* b,int bn){
+    if(an!=bn) return an<bn ? -1 : 1;
+    for(int i=an-1;i>=0;i--) if(a[i]!=b[i]) return a[i]<b[i] ? -1 : 1;
+    return 0;
+}
+
+// r = a + b with an >= bn; returns the carry out of r[an-1]. r may be a or b.
+static bn_limb add_n(bn_limb* r,const bn_limb* a,int an,const bn_limb* b,int bn){
+    bn_dlimb c=0;
+    int i=0;
+    for(;i<bn;i++){ c += (bn_dlimb)a[i]+b[i]; r[i]=(bn_limb)c; c>>=32; }
+    for(;i<an;i++){ c += a[i]; r[i]=(bn_limb)c; c>>=32; }
+    return (bn_limb)c;
+}
+
+// r = a - b with a >= b and an >= bn. r may be a or b.
+static void sub_n(bn_limb* r,const bn_limb* a,int an,const bn_limb* b,int bn){
+    bn_limb borrow=0;
+    int i=0;
+    for(;i<bn;i++){
+        bn_dlimb t = (bn_dlimb)a[i]-b[i]-borrow;
+        r[i]=(bn_limb)t; borrow=(bn_limb)(t>>32)&1;
+    }
+    for(;i<an;i++){
+        bn_dlimb t = (bn_dlimb)a[i]-borrow;
+        r[i]=(bn_limb)t; borrow=(bn_limb)(t>>32)&1;
+    }
+}
+
+// r[0..rn) += b[0..bn); the caller knows the sum fits
+static void add_into(bn_limb* r,int rn,const bn_limb* b,int bn){
+    bn_limb c = add_n(r,r,bn,b,bn);
+    for(int i=bn;c && i<rn;i++){ r[i]+=c; c = r[i]==0; }
+}
+
+// r[0..rn) -= b[0..bn); the caller knows r >= b
+static void sub_into(bn_limb* r,int rn,const bn_limb* b,int bn){
+    sub_n(r,r,rn,b,bn);
+}
+
+// 64/32 division with hi < d (so the quotient fits in a limb)
+static inline void div_2by1(bn_limb hi,bn_limb lo,bn_limb d,bn_limb* q,bn_limb* rem){
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__("divl %4" : "=a"(*q), "=d"(*rem) : "a"(lo), "d"(hi), "rm"(d));
+#else
+    bn_dlimb n = ((bn_dlimb)hi<<32)|lo;
+    *q=(bn_limb)(n/d); *rem=(bn_limb)(n%d);
+#endif
+}
+
+// q = a / d for a single limb d; returns the remainder. q may be a.
+static bn_limb divmod_1(bn_limb* q,const bn_limb* a,int n,bn_limb d){
+    bn_limb rem=0;
+    for(int i=n-1;i>=0;i--) div_2by1(rem,a[i],d,&q[i],&rem);
+    return rem;
+}
+
+// a = a*m + add over n limbs; returns the limb carried out
+static bn_limb mul_add_1(bn_limb* a,int n,bn_limb m,bn_limb add){
+    bn_dlimb c=add;
+    for(int i=0;i<n;i++){ c += (bn_dlimb)a[i]*m; a[i]=(bn_limb)c; c>>=32; }
+    return (bn_limb)c;
+}
+
+// ======= Multiplication =======
+static void mul_school(bn_limb* r,const bn_limb* a,int an,const bn_limb* b,int bn){
+    zero(r,an+bn);
+    for(int i=0;i<bn;i++){
+        bn_dlimb c=0;
+        bn_limb bi=b[i];
+        for(int j=0;j<an;j++){
+            c += (bn_dlimb)a[j]*bi + r[i+j];
+            r[i+j]=(bn_limb)c;
+            c>>=32;
+        }
+        r[i+an]=(bn_limb)c;
+    }
+}
+
+static int mul_raw(bn_limb* r,const bn_limb* a,int an,const bn_limb* b,int bn);
+
+// r[0..total) = a*b, zero-filling above the product
+static int mul_into(bn_limb* r,int total,const bn_limb* a,int an,const bn_limb* b,int bn){
+    an=len_of(a,an); bn=len_of(b,bn);
+    if(!mul_raw(r,a,an,b,bn)) return 0;
+    zero(r+an+bn,total-(an+bn));
+    return 1;
+}
+
+// r[0..an+bn) = a*b; r must not overlap a or b. Returns 0 when out of memory.
+static int mul_raw(bn_limb* r,const bn_limb* a,int an,const bn_limb* b,int bn){
+    if(an<bn){ const bn_limb* t=a; a=b; b=t; int tn=an; an=bn; bn=tn; }
+    if(bn==0){ zero(r,an); return 1; }
+    if(bn<KARATSUBA_THRESHOLD){ mul_school(r,a,an,b,bn); return 1; }
+
+    int m=(an+1)/2;
+    if(bn<=m){
+        // b is short: r = a0*b + (a1*b << m), each half recursing on its own
+        bn_limb* t=limbs_alloc(an-m+bn);
+        if(!t) return 0;
+        int ok = mul_into(r,an+bn,a,m,b,bn) && mul_into(t,an-m+bn,a+m,an-m,b,bn);
+        if(ok) add_into(r+m,an+bn-m,t,an-m+bn);
+        limbs_free(t);
+        return ok;
+    }
+
+    // a = a1*B^m + a0, b = b1*B^m + b0:
+    // a*b = z2*B^2m + (z1 - z0 - z2)*B^m + z0 with z1 = (a0+a1)(b0+b1)
+    bn_limb* sa=limbs_alloc(m+1);
+    bn_limb* sb=limbs_alloc(m+1);
+    bn_limb* z1=limbs_alloc(2*m+2);
+    int ok = sa && sb && z1;
+    if(ok){
+        sa[m]=add_n(sa,a,m,a+m,an-m);
+        sb[m]=add_n(sb,b,m,b+m,bn-m);
+        ok = mul_into(r,2*m,a,m,b,m) &&                     // z0 in the low half
+             mul_into(r+2*m,an+bn-2*m,a+m,an-m,b+m,bn-m) &&  // z2 in the high part
+             mul_into(z1,2*m+2,sa,m+1,sb,m+1);
+    }
+    if(ok){
+        int z1n=len_of(z1,2*m+2);
+        sub_into(z1,z1n,r,len_of(r,2*m));
+        sub_into(z1,z1n,r+2*m,len_of(r+2*m,an+bn-2*m));
+        add_into(r+m,an+bn-m,z1,len_of(z1,z1n));
+    }
+    limbs_free(sa); limbs_free(sb); limbs_free(z1);
+    return ok;
+}
+
+// ======= BigInt =======
+void bn_init(BigInt* a){ a->d=0; a->n=a->cap=0; a->neg=0; }
+
+void bn_free(BigInt* a){
+    limbs_free(a->d);
+    bn_init(a);
+}
+
+static int reserve(BigInt* a,int n){
+    if(a->cap>=n) return 1;
+    int cap = a->cap ? a->cap*2 : 4;
+    while(cap<n) cap*=2;
+    bn_limb* d=limbs_alloc(cap);
+    if(!d) return 0;
+    copy(d,a->d,a->n);
+    limbs_free(a->d);
+    a->d=d; a->cap=cap;
+    return 1;
+}
+
+static void normalize(BigInt* a){
+    a->n=len_of(a->d,a->n);
+    if(!a->n) a->neg=0;
+}
+
+// Hand a freshly computed limb array to a
+static void adopt(BigInt* a,bn_limb* d,int n,int cap,int neg){
+    limbs_free(a->d);
+    a->d=d; a->n=n; a->cap=cap; a->neg=neg;
+    normalize(a);
+}
+
+int bn_set_int(BigInt* a,long long v){
+    unsigned long long m = v<0 ? 0ULL-(unsigned long long)v : (unsigned long long)v;
+    if(!reserve(a,2)) return BN_ERR_NOMEM;
+    a->d[0]=(bn_limb)m; a->d[1]=(bn_limb)(m>>32);
+    a->n=2; a->neg=v<0;
+    normalize(a);
+    return BN_OK;
+}
+
+int bn_copy(BigInt* dst,const BigInt* src){
+    if(dst==src) return BN_OK;
+    if(!reserve(dst,src->n)) return BN_ERR_NOMEM;
+    copy(dst->d,src->d,src->n);
+    dst->n=src->n; dst->neg=src->neg;
+    return BN_OK;
+}
+
+int bn_is_zero(const BigInt* a){ return a->n==0; }
+
+unsigned int bn_bit_length(const BigInt* a){
+    if(!a->n) return 0;
+    unsigned int bits=(unsigned int)(a->n-1)*32;
+    for(bn_limb top=a->d[a->n-1]; top; top>>=1) bits++;
+    return bits;
+}
+
+int bn_cmp(const BigInt* a,const BigInt* b){
+    if(a->neg!=b->neg) return a->neg ? -1 : 1;
+    int c=cmp_mag(a->d,a->n,b->d,b->n);
+    return a->neg ? -c : c;
+}
+
+// r = a + (bneg ? -|b| : |b|)
+static int add_signed(BigInt* r,const BigInt* a,const BigInt* b,int bneg){
+    int an=a->n, bn=b->n, aneg=a->neg;
+    int big = an>bn ? an : bn;
+    if(!reserve(r,big+1)) return BN_ERR_NOMEM;   // may move r->d, and with it a->d or b->d if aliased
+    if(aneg==bneg){
+        const BigInt* x = an>=bn ? a : b;
+        const BigInt* y = an>=bn ? b : a;
+        r->d[big]=add_n(r->d,x->d,x->n,y->d,y->n);
+        r->n=big+1; r->neg=aneg;
+    }else{
+        int c=cmp_mag(a->d,an,b->d,bn);
+        if(c>=0){ sub_n(r->d,a->d,an,b->d,bn); r->n=an; r->neg=aneg; }
+        else{ sub_n(r->d,b->d,bn,a->d,an); r->n=bn; r->neg=bneg; }
+    }
+    normalize(r);
+    return BN_OK;
+}
+
+int bn_add(BigInt* r,const BigInt* a,const BigInt* b){ return add_signed(r,a,b,b->neg); }
+int bn_sub(BigInt* r,const BigInt* a,const BigInt* b){ return add_signed(r,a,b,!b->neg && b->n); }
+
+int bn_mul(BigInt* r,const BigInt* a,const BigInt* b){
+    if(!a->n || !b->n){ r->n=0; r->neg=0; return BN_OK; }
+    int n=a->n+b->n;
+    bn_limb* d=limbs_alloc(n);
+    if(!d || !mul_raw(d,a->d,a->n,b->d,b->n)){ limbs_free(d); return BN_ERR_NOMEM; }
+    adopt(r,d,n,n,a->neg!=b->neg);
+    return BN_OK;
+}
+
+// ======= Division (Knuth, TAOCP vol. 2, 4.3.1 algorithm D) =======
+// q[0..an-bn] = u / v and r[0..bn) = u % v for bn >= 2 and an >= bn
+static int divmod_knuth(bn_limb* q,bn_limb* r,const bn_limb* u,int an,const bn_limb* v,int bn){
+    bn_limb* un=limbs_alloc(an+1);
+    bn_limb* vn=limbs_alloc(bn);
+    if(!un || !vn){ limbs_free(un); limbs_free(vn); return 0; }
+
+    // normalise so the divisor's top bit is set, which keeps each qhat within 2 of the truth
+    int s=0;
+    while(!(v[bn-1]<<s & 0x80000000u)) s++;
+    for(int i=bn-1;i>0;i--) vn[i] = v[i]<<s | (s ? v[i-1]>>(32-s) : 0);
+    vn[0]=v[0]<<s;
+    un[an] = s ? u[an-1]>>(32-s) : 0;
+    for(int i=an-1;i>0;i--) un[i] = u[i]<<s | (s ? u[i-1]>>(32-s) : 0);
+    un[0]=u[0]<<s;
+
+    bn_limb v1=vn[bn-1], v2=vn[bn-2];
+    for(int j=an-bn;j>=0;j--){
+        bn_limb qhat, rl;
+        bn_dlimb rhat;
+        if(un[j+bn]<v1){
+            div_2by1(un[j+bn],un[j+bn-1],v1,&qhat,&rl);
+            rhat=rl;
+        }else{
+            qhat=0xFFFFFFFFu;
+            rhat=(bn_dlimb)un[j+bn-1]+v1;
+        }
+        while(rhat<=0xFFFFFFFFu && (bn_dlimb)qhat*v2 > (rhat<<32 | un[j+bn-2])){
+            qhat--;
+            rhat+=v1;
+        }
+        // un[j..j+bn] -= qhat * vn
+        long long k=0, t;
+        for(int i=0;i<bn;i++){
+            bn_dlimb p=(bn_dlimb)qhat*vn[i];
+            t = (long long)un[i+j] - k - (long long)(p & 0xFFFFFFFFu);
+            un[i+j]=(bn_limb)t;
+            k = (long long)(p>>32) - (t>>32);
+        }
+        t = (long long)un[j+bn] - k;
+        un[j+bn]=(bn_limb)t;
+        if(t<0){
+            // qhat was one too large: add the divisor back
+            qhat--;
+            bn_dlimb c=0;
+            for(int i=0;i<bn;i++){
+                c += (bn_dlimb)un[i+j]+vn[i];
+                un[i+j]=(bn_limb)c;
+                c>>=32;
+            }
+            un[j+bn]+=(bn_limb)c;
+        }
+        q[j]=qhat;
+    }
+    if(r) for(int i=0;i<bn;i++) r[i] = un[i]>>s | (s ? un[i+1]<<(32-s) : 0);
+    limbs_free(un); limbs_free(vn);
+    return 1;
+}
+
+// ======= Division by reciprocal (Newton + Barrett) =======
+// Knuth D is quadratic; for large divisors we instead compute R = floor(B^2n / d)
+// by Newton iteration at O(M(n)) and divide with two multiplications.
+
+// A read-only window of limbs [lo, lo+n) of a, normalised
+static void view(BigInt* v,const BigInt* a,int lo,int n){
+    if(lo>a->n) lo=a->n;
+    if(n>a->n-lo) n=a->n-lo;
+    v->d=a->d+lo; v->n=len_of(v->d,n); v->cap=0; v->neg=0;
+}
+
+static int shl_limbs(BigInt* a,int k){
+    if(!a->n || !k) return BN_OK;
+    if(!reserve(a,a->n+k)) return BN_ERR_NOMEM;
+    for(int i=a->n-1;i>=0;i--) a->d[i+k]=a->d[i];
+    zero(a->d,k);
+    a->n+=k;
+    return BN_OK;
+}
+
+// a = B^k
+static int set_power_of_base(BigInt* a,int k){
+    if(!reserve(a,k+1)) return BN_ERR_NOMEM;
+    zero(a->d,k);
+    a->d[k]=1; a->n=k+1; a->neg=0;
+    return BN_OK;
+}
+
+static int add_small(BigInt* a,long long v){
+    BigInt t;
+    bn_init(&t);
+    int err=bn_set_int(&t,v);
+    if(!err) err=bn_add(a,a,&t);
+    bn_free(&t);
+    return err;
+}
+
+// Given an estimate R of floor(N/d), make it exact; e = N - d*R on entry
+static int fix_quotient(BigInt* R,BigInt* e,const BigInt* d){
+    int err=BN_OK;
+    while(!err && e->neg){ err=add_small(R,-1); if(!err) err=bn_add(e,e,d); }
+    while(!err && bn_cmp(e,d)>=0){ err=add_small(R,1); if(!err) err=bn_sub(e,e,d); }
+    return err;
+}
+
+// R = floor(B^2n / d) with n = d->n, from the reciprocal of d's top half
+static int reciprocal(BigInt* R,const BigInt* d){
+    int n=d->n, err;
+    BigInt N, t, e;
+    bn_init(&N); bn_init(&t); bn_init(&e);
+    err=set_power_of_base(&N,2*n);
+    if(!err && n<=NEWTON_THRESHOLD){
+        err=bn_divmod(R,0,&N,d);
+    }else if(!err){
+        // h top limbs give a relative error of B^-(h-1), which the Newton step
+        // squares; two guard limbs leave an error of a few units to fix up
+        int h=n/2+2;
+        BigInt top;
+        view(&top,d,n-h,h);
+        err=reciprocal(R,&top);                 // B^2h / top ~ B^2n / d / B^(n-h)
+        if(!err) err=shl_limbs(R,n-h);
+        // one Newton step doubles the correct limbs: R += R*(B^2n - d*R) / B^2n
+        if(!err) err=bn_mul(&t,d,R);
+        if(!err) err=bn_sub(&e,&N,&t);
+        if(!err) err=bn_mul(&t,R,&e);
+        if(!err){
+            int neg=t.neg;
+            BigInt step;
+            view(&step,&t,2*n,t.n);
+            step.neg=neg && step.n;
+            err=bn_add(R,R,&step);
+        }
+        if(!err) err=bn_mul(&t,d,R);
+        if(!err) err=bn_sub(&e,&N,&t);
+        if(!err) err=fix_quotient(R,&e,d);
+    }
+    bn_free(&N); bn_free(&t); bn_free(&e);
+    return err;
+}
+
+// q, r = a / d for 0 <= a < B^2n (n = d->n) using R = reciprocal(d) (Barrett)
+static int div_barrett(BigInt* q,BigInt* r,const BigInt* a,const BigInt* d,const BigInt* R){
+    int n=d->n;
+    BigInt hi, t;
+    bn_init(&t);
+    view(&hi,a,n-1,a->n);
+    int err=bn_mul(q,&hi,R);                    // q <= true quotient <= q+2
+    if(!err){
+        BigInt qv;
+        view(&qv,q,n+1,q->n);
+        err=bn_copy(&t,&qv);
+        if(!err) err=bn_copy(q,&t);
+    }
+    if(!err) err=bn_mul(&t,q,d);
+    if(!err) err=bn_sub(r,a,&t);
+    if(!err) err=fix_quotient(q,r,d);
+    bn_free(&t);
+    return err;
+}
+
+// Long division in base B^n, one Barrett step per n-limb chunk of a (a, d > 0)
+static int divmod_newton(BigInt* q,BigInt* r,const BigInt* a,const BigInt* d){
+    int n=d->n;
+    BigInt R, cur, qc, chunk;
+    bn_init(&R); bn_init(&cur); bn_init(&qc);
+    int err=reciprocal(&R,d);
+    int chunks=(a->n+n-1)/n;
+    if(!err && !reserve(q,chunks*n+1)) err=BN_ERR_NOMEM;
+    if(!err){ zero(q->d,chunks*n+1); q->n=chunks*n; q->neg=0; }
+    r->n=0; r->neg=0;
+    for(int c=chunks-1;c>=0 && !err;c--){
+        // cur = r*B^n + chunk c, which is below d*B^n <= B^2n
+        view(&chunk,a,c*n,n);
+        err=bn_copy(&cur,r);
+        if(!err) err=shl_limbs(&cur,n);
+        if(!err) err=bn_add(&cur,&cur,&chunk);
+        if(!err) err=div_barrett(&qc,r,&cur,d,&R);
+        if(!err) copy(q->d+c*n,qc.d,qc.n);      // each quotient chunk is below B^n
+    }
+    if(!err) normalize(q);
+    bn_free(&R); bn_free(&cur); bn_free(&qc);
+    return err;
+}
+
+int bn_divmod(BigInt* q,BigInt* rem,const BigInt* a,const BigInt* b){
+    if(!b->n) return BN_ERR_DIV0;
+    int an=a->n, bn=b->n, aneg=a->neg, qneg=a->neg!=b->neg;
+    if(cmp_mag(a->d,an,b->d,bn)<0){
+        if(rem && bn_copy(rem,a)) return BN_ERR_NOMEM;
+        if(q){ q->n=0; q->neg=0; }
+        return BN_OK;
+    }
+    if(bn>BARRETT_THRESHOLD && an-bn>BARRETT_THRESHOLD){
+        BigInt qq, rr, ma, mb;
+        bn_init(&qq); bn_init(&rr);
+        ma=*a; ma.neg=0; mb=*b; mb.neg=0;
+        int err=divmod_newton(&qq,&rr,&ma,&mb);
+        if(!err){
+            qq.neg=qneg && qq.n; rr.neg=aneg && rr.n;
+            if(q){ bn_free(q); *q=qq; bn_init(&qq); }
+            if(rem){ bn_free(rem); *rem=rr; bn_init(&rr); }
+        }
+        bn_free(&qq); bn_free(&rr);
+        return err;
+    }
+    int qn=an-bn+1;
+    bn_limb* qd=limbs_alloc(qn);
+    bn_limb* rd=limbs_alloc(bn);
+    int ok = qd && rd;
+    if(ok){
+        if(bn==1) rd[0]=divmod_1(qd,a->d,an,b->d[0]);
+        else ok=divmod_knuth(qd,rd,a->d,an,b->d,bn);
+    }
+    if(!ok){ limbs_free(qd); limbs_free(rd); return BN_ERR_NOMEM; }
+    // a, b may alias q or rem, so nothing is written until both results exist
+    if(q) adopt(q,qd,qn,qn,qneg); else limbs_free(qd);
+    if(rem) adopt(rem,rd,bn,bn,aneg); else limbs_free(rd);
+    return BN_OK;
+}
+
+int bn_pow(BigInt* r,const BigInt* a,unsigned int e){
+    BigInt base, acc;
+    bn_init(&base); bn_init(&acc);
+    int err = bn_copy(&base,a);
+    if(!err) err = bn_set_int(&acc,1);
+    while(!err && e){
+        if(e&1) err = bn_mul(&acc,&acc,&base);
+        e>>=1;
+        if(!err && e) err = bn_mul(&base,&base,&base);
+    }
+    if(!err){
+        // hand acc's storage to r
+        limbs_free(r->d);
+        *r=acc;
+        bn_init(&acc);
+    }
+    bn_free(&base); bn_free(&acc);
+    return err;
+}
+
+// ======= Decimal conversion =======
+// pw[k] = 10^(9*2^k), built by repeated squaring
+static int powers_upto(BigInt* pw,int k){
+    if(pw[0].n==0 && bn_set_int(&pw[0],DEC_BASE)) return 0;
+    for(int i=1;i<=k;i++) if(pw[i].n==0 && bn_mul(&pw[i],&pw[i-1],&pw[i-1])) return 0;
+    return 1;
+}
+
+static void powers_free(BigInt* pw){
+    for(int i=0;i<MAX_POWERS;i++) bn_free(&pw[i]);
+}
+
+// Quadratic base case: peel off nine digits at a time, zero-padded to 'width'
+static int dec_base(const bn_limb* a,int n,char* out,int width){
+    bn_limb* t=limbs_alloc(n);
+    char* tmp=(char*)limbs_alloc(n*3+4);           // 12 bytes per limb >= its 9.64 digits
+    if(!t || !tmp){ limbs_free(t); limbs_free(tmp); return -1; }
+    copy(t,a,n);
+    int len=0;
+    while(n){
+        bn_limb chunk=divmod_1(t,t,n,DEC_BASE);
+        n=len_of(t,n);
+        for(int i=0;i<DEC_DIGITS && (n || chunk);i++){ tmp[len++]='0'+chunk%10; chunk/=10; }
+    }
+    int w=0;
+    for(int i=len;i<width;i++) out[w++]='0';
+    if(!width && !len) out[w++]='0';
+    while(len) out[w++]=tmp[--len];
+    limbs_free(t); limbs_free(tmp);
+    return w;
+}
+
+// Writes x < pw[k]^2, exactly 'width' digits when width > 0. inv[k] caches the
+// reciprocal of pw[k], since every split at level k divides by the same power.
+static int to_dec(const BigInt* x,BigInt* pw,BigInt* inv,int k,char* out,int width){
+    if(k<0 || x->n<CONVERT_THRESHOLD) return dec_base(x->d,x->n,out,width);
+    if(!width && cmp_mag(x->d,x->n,pw[k].d,pw[k].n)<0) return to_dec(x,pw,inv,k-1,out,0);
+    BigInt hi, lo;
+    bn_init(&hi); bn_init(&lo);
+    int low=DEC_DIGITS<<k, w=-1, err;
+    if(pw[k].n>BARRETT_THRESHOLD){
+        err = inv[k].n ? BN_OK : reciprocal(&inv[k],&pw[k]);
+        if(!err) err=div_barrett(&hi,&lo,x,&pw[k],&inv[k]);
+    }else{
+        err=bn_divmod(&hi,&lo,x,&pw[k]);
+    }
+    if(!err){
+        int hn=to_dec(&hi,pw,inv,k-1,out,width ? width-low : 0);
+        int ln = hn<0 ? -1 : to_dec(&lo,pw,inv,k-1,out+hn,low);
+        if(ln>=0) w=hn+ln;
+    }
+    bn_free(&hi); bn_free(&lo);
+    return w;
+}
+
+unsigned int bn_decimal_size(const BigInt* a){ return (unsigned int)a->n*10+3; }
+
+int bn_to_string(const BigInt* a,char* out,unsigned int cap){
+    if(cap<bn_decimal_size(a)) return -1;
+    BigInt pw[MAX_POWERS], inv[MAX_POWERS];
+    for(int i=0;i<MAX_POWERS;i++){ bn_init(&pw[i]); bn_init(&inv[i]); }
+    // the deepest split needs pw[k]^2 > a, i.e. pw[k] at least half a's length
+    int k=0;
+    if(a->n>=CONVERT_THRESHOLD){
+        if(!powers_upto(pw,0)){ powers_free(pw); return -1; }
+        while(2*pw[k].n-1<=a->n && k+1<MAX_POWERS){
+            if(!powers_upto(pw,k+1)){ powers_free(pw); return -1; }
+            k++;
+        }
+    }
+    int n=0;
+    if(a->neg) out[n++]='-';
+    BigInt mag=*a;
+    mag.neg=0;
+    int w=to_dec(&mag,pw,inv,a->n>=CONVERT_THRESHOLD ? k : -1,out+n,0);
+    powers_free(pw);
+    powers_free(inv);
+    if(w<0) return -1;
+    n+=w;
+    out[n]=0;
+    return n;
+}
+
+// Value of s[0..len) (digits only), splitting at 9*2^k digits from the right
+static int from_dec(BigInt* r,const char* s,int len,BigInt* pw){
+    if(len<=DEC_DIGITS*CONVERT_THRESHOLD){
+        if(!reserve(r,len/DEC_DIGITS+1)) return BN_ERR_NOMEM;
+        r->n=0; r->neg=0;
+        int i=0, first=len%DEC_DIGITS ? len%DEC_DIGITS : DEC_DIGITS;
+        while(i<len){
+            bn_limb chunk=0, scale=1;
+            for(int j=0;j<first;j++){ chunk=chunk*10+(bn_limb)(s[i+j]-'0'); scale*=10; }
+            bn_limb c=mul_add_1(r->d,r->n,scale,chunk);
+            if(c) r->d[r->n++]=c;
+            i+=first;
+            first=DEC_DIGITS;
+        }
+        normalize(r);
+        return BN_OK;
+    }
+    int k=0;
+    while((DEC_DIGITS<<(k+1))<len) k++;
+    if(!powers_upto(pw,k)) return BN_ERR_NOMEM;
+    int low=DEC_DIGITS<<k;
+    BigInt lo;
+    bn_init(&lo);
+    int err=from_dec(r,s,len-low,pw);
+    if(!err) err=from_dec(&lo,s+len-low,low,pw);
+    if(!err) err=bn_mul(r,r,&pw[k]);
+    if(!err) err=bn_add(r,r,&lo);
+    bn_free(&lo);
+    return err;
+}
+
+int bn_from_string(BigInt* a,const char* s,int len){
+    int neg=0;
+    if(len>0 && s[0]=='-'){ neg=1; s++; len--; }
+    if(len<=0) return BN_ERR_SYNTAX;
+    for(int i=0;i<len;i++) if(s[i]<'0' || s[i]>'9') return BN_ERR_SYNTAX;
+    BigInt pw[MAX_POWERS];
+    for(int i=0;i<MAX_POWERS;i++) bn_init(&pw[i]);
+    int err=from_dec(a,s,len,pw);
+    powers_free(pw);
+    if(!err){ a->neg=neg; normalize(a); }
+    return err;
+}
+
+// ======= Benchmark =======
+static void random_digits(char* s,int n,unsigned int* seed){
+    for(int i=0;i<n;i++){
+        *seed = *seed*1103515245u+12345u;
+        s[i]='0'+(char)((*seed>>16)%10);
+    }
+    if(s[0]=='0') s[0]='7';
+}
+
+void bn_benchmark(const int* digits,int nsizes,int schoolMax,
+                  unsigned long long (*now)(void),bn_bench_report report){
+    unsigned int seed=12345;
+    for(int i=0;i<nsizes;i++){
+        int nd=digits[i];
+        BigInt a, b, p;
+        bn_init(&a); bn_init(&b); bn_init(&p);
+        char* s=(char*)limbs_alloc(nd/4+1);
+        char* out=0;
+        unsigned long long school=0, kara=0, dec=0;
+        if(!s) break;
+        random_digits(s,nd,&seed);
+        int err=bn_from_string(&a,s,nd);
+        random_digits(s,nd,&seed);
+        if(!err) err=bn_from_string(&b,s,nd);
+        int n=a.n+b.n;
+        bn_limb* r=limbs_alloc(n);
+        if(!err && r){
+            if(nd<=schoolMax){
+                unsigned long long t0=now();
+                mul_school(r,a.d,a.n,b.d,b.n);
+                school=now()-t0;
+            }
+            unsigned long long t0=now();
+            err = !mul_raw(r,a.d,a.n,b.d,b.n);
+            kara=now()-t0;
+            if(!err){ adopt(&p,r,n,n,0); r=0; }
+            out=(char*)limbs_alloc((int)bn_decimal_size(&p)/4+1);
+            if(!err && out){
+                t0=now();
+                err = bn_to_string(&p,out,bn_decimal_size(&p))<0;
+                dec=now()-t0;
+            }
+        }
+        limbs_free(r); limbs_free(s); limbs_free(out);
+        bn_free(&a); bn_free(&b); bn_free(&p);
+        if(err) break;
+        report(nd,school,kara,dec);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef _BIGNUM_H_
+#define _BIGNUM_H_
+
+// ======= Arbitrary-precision integers =======
+// Freestanding like expr.c: shared by the kernel calculator and calc, with
+// memory coming from whatever allocator the caller installs. Magnitudes are
+// little-endian arrays of 32-bit limbs with a separate sign.
+//
+// Multiplication switches from schoolbook to Karatsuba above a size threshold,
+// division is Knuth's algorithm D (Newton reciprocal and Barrett reduction for
+// very large operands), and decimal conversion in both directions splits the
+// number by powers 10^(9*2^k) so it runs at multiplication speed instead of
+// quadratically.
+
+typedef unsigned int bn_limb;
+typedef unsigned long long bn_dlimb;
+
+typedef struct {
+    bn_limb* d;
+    int n;                   // limbs in use; 0 means zero
+    int cap;
+    int neg;
+} BigInt;
+
+// Result codes
+#define BN_OK 0
+#define BN_ERR_NOMEM 1
+#define BN_ERR_DIV0 2
+#define BN_ERR_SYNTAX 3
+
+void bn_set_allocator(void* (*alloc)(unsigned int),void (*release)(void*));
+
+void bn_init(BigInt* a);
+void bn_free(BigInt* a);
+int bn_set_int(BigInt* a,long long v);
+int bn_copy(BigInt* dst,const BigInt* src);
+int bn_is_zero(const BigInt* a);
+unsigned int bn_bit_length(const BigInt* a);            // of the magnitude; 0 for zero
+int bn_cmp(const BigInt* a,const BigInt* b);
+
+// The result may alias either operand
+int bn_add(BigInt* r,const BigInt* a,const BigInt* b);
+int bn_sub(BigInt* r,const BigInt* a,const BigInt* b);
+int bn_mul(BigInt* r,const BigInt* a,const BigInt* b);
+int bn_divmod(BigInt* q,BigInt* rem,const BigInt* a,const BigInt* b);  // truncating, like C; q or rem may be 0
+int bn_pow(BigInt* r,const BigInt* a,unsigned int e);
+
+// Decimal text. bn_from_string takes optional '-' then digits only.
+int bn_from_string(BigInt* a,const char* s,int len);
+unsigned int bn_decimal_size(const BigInt* a);                // bytes bn_to_string needs, with the NUL
+int bn_to_string(const BigInt* a,char* out,unsigned int cap);  // returns length, or -1 (cap too small/no memory)
+
+// Benchmark core: for each operand size (decimal digits), times schoolbook and
+// Karatsuba multiplication and conversion of the product to decimal with the
+// caller's clock. Schoolbook is skipped (reported as 0) above schoolMax digits.
+typedef void (*bn_bench_report)(int digits,unsigned long long school,
+                                unsigned long long karatsuba,unsigned long long toDecimal);
+void bn_benchmark(const int* digits,int nsizes,int schoolMax,
+                  unsigned long long (*now)(void),bn_bench_report report);
+
+#endif
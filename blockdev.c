@@ -0,0 +1,15 @@
+#include "blockdev.h"
+
+static BlockDev* g_devs[MAX_BLOCKDEVS];
+static int g_ndevs = 0;
+
+int blockdev_register(BlockDev* d){
+    if(g_ndevs>=MAX_BLOCKDEVS) return -1;
+    d->id = g_ndevs;
+    g_devs[g_ndevs++] = d;
+    return d->id;
+}
+
+BlockDev* blockdev_get(int id){
+    return (id>=0 && id<g_ndevs) ? g_devs[id] : 0;
+}
@@ -0,0 +1,22 @@
+#ifndef _BLOCKDEV_H_
+#define _BLOCKDEV_H_
+
+#include "kernel.h"
+
+#define SECTOR_SIZE 512
+#define MAX_BLOCKDEVS 4
+
+// A sector-addressed device; read/write return 1 on success, 0 on error
+typedef struct BlockDev BlockDev;
+struct BlockDev {
+    int id;                  // assigned by blockdev_register
+    const char* name;
+    UINT32 sectors;
+    int (*read)(BlockDev* d,UINT32 lba,UINT32 count,void* buf);
+    int (*write)(BlockDev* d,UINT32 lba,UINT32 count,const void* buf);
+};
+
+int blockdev_register(BlockDev* d);
+BlockDev* blockdev_get(int id);
+
+#endif
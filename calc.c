@@ -2,6 +2,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "expr.h"
+#include "jit.h"
 
 static void trim(char *s) {
 	size_t n = strlen(s);
@@ -11,12 +20,591 @@ static void trim(char *s) {
 }
 
 static void print_help(void) {
-	printf("Enter: <a> <op> <b>  where op in + - * /\n");
-	printf("Examples: 3 + 4\n         12.5 * 2\nType 'q' or 'quit' to exit.\n");
+	printf("Enter an expression: + - * / %% ^, parentheses, variables (name = expr)\n");
+	printf("Examples: 3 + 4 * 2\n         r = 2.5\n         3.14159 * r^2\n         (ans + 1) / 2\n");
+	printf("Integer expressions are exact: 2^1000, 100000000000000000007 %% 97\n");
+	printf("Type 'q' or 'quit' to exit.\n");
+}
+
+static unsigned long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+/* bignum.c takes its memory from hooks so the kernel can share it */
+static void *bn_malloc(unsigned int n) { return malloc(n); }
+static void bn_release(void *p) { free(p); }
+
+/* ./calc --bench: parse and evaluation throughput of the expression engine */
+static int run_bench(void) {
+	static const char *const samples[] = {
+		"1+2*3-4/5", "(x+y)*(x-y)/2", "-x^2+3*x-7", "((1+2)*(3+4))%5", "z=x*y+1"
+	};
+	ExprBench b;
+	expr_bench(samples, 5, 200000, now_ns, &b);
+	printf("parse: %.0f expr/s\n", b.parseTicks ? b.parses * 1e9 / b.parseTicks : 0.0);
+	printf("eval:  %.0f expr/s\n", b.evalTicks ? b.evals * 1e9 / b.evalTicks : 0.0);
+	return b.failures ? 1 : 0;
+}
+
+/*
+ * Batch mode: ./calc --batch [file|-] [-j threads]
+ *
+ * Evaluates one expression per line and prints one result per line, in input
+ * order. The input is mmapped (or read whole from a pipe) and cut into blocks
+ * of complete lines; worker threads claim blocks and format their results into
+ * per-block buffers, which the main thread writes out in order. Each line is
+ * evaluated on its own, so a variable only lives for the line that assigns it.
+ * Workers stay at most BATCH_RING blocks ahead of the writer, bounding memory.
+ */
+#define BATCH_BLOCK (256 * 1024)    /* input bytes per block (rounded up to a line end) */
+#define BATCH_RING 64               /* blocks in flight */
+#define BATCH_MAX_LINE 4096
+#define BATCH_OUT_BUF (1 << 20)
+
+typedef struct {
+	unsigned long id;
+	const char *begin, *end;
+	char *out;
+	size_t outLen, outCap;
+	unsigned long lines;
+	int done;
+} Block;
+
+typedef struct {
+	const char *data;
+	size_t size, pos;           /* pos: first input byte not yet claimed */
+	unsigned long next;         /* id of the next block to claim */
+	unsigned long written;      /* blocks already written out */
+	int failed;                 /* a worker ran out of memory */
+	Block ring[BATCH_RING];
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} Batch;
+
+static int block_reserve(Block *b, size_t n) {
+	if (b->outCap - b->outLen >= n) {
+		return 1;
+	}
+	size_t cap = b->outCap ? b->outCap * 2 : 64 * 1024;
+	while (cap - b->outLen < n) {
+		cap *= 2;
+	}
+	char *p = realloc(b->out, cap);
+	if (!p) {
+		return 0;
+	}
+	b->out = p;
+	b->outCap = cap;
+	return 1;
+}
+
+static int eval_block(Block *b) {
+	char line[BATCH_MAX_LINE];
+	ExprEnv env;
+	ExprProgram prog;
+	const char *p = b->begin;
+
+	b->outLen = 0;
+	b->lines = 0;
+	while (p < b->end) {
+		const char *nl = memchr(p, '\n', (size_t)(b->end - p));
+		const char *eol = nl ? nl : b->end;
+		size_t n = (size_t)(eol - p);
+		if (n && p[n - 1] == '\r') {
+			n--;
+		}
+		if (!block_reserve(b, 64)) {
+			return 0;
+		}
+		char *out = b->out + b->outLen;
+		if (n >= sizeof(line)) {
+			b->outLen += (size_t)sprintf(out, "error: line too long\n");
+		} else {
+			memcpy(line, p, n);
+			line[n] = '\0';
+			size_t k = 0;
+			while (line[k] == ' ' || line[k] == '\t') {
+				k++;
+			}
+			if (line[k] != '\0') {
+				double v;
+				expr_env_init(&env);
+				int err = expr_compile(line, &prog, &env);
+				if (!err) {
+					err = expr_run(&prog, &env, &v);
+				}
+				if (err) {
+					const char *msg = expr_error(err);
+					memcpy(out, "error: ", 7);
+					size_t m = strlen(msg);
+					memcpy(out + 7, msg, m);
+					b->outLen += 7 + m;
+				} else {
+					b->outLen += (size_t)expr_format(v, out, 48);
+				}
+			}
+			b->out[b->outLen++] = '\n';
+		}
+		b->lines++;
+		p = nl ? nl + 1 : b->end;
+	}
+	return 1;
+}
+
+static void *batch_worker(void *arg) {
+	Batch *bt = arg;
+	pthread_mutex_lock(&bt->lock);
+	for (;;) {
+		while (bt->pos < bt->size && !bt->failed && bt->next - bt->written >= BATCH_RING) {
+			pthread_cond_wait(&bt->cond, &bt->lock);
+		}
+		if (bt->pos >= bt->size || bt->failed) {
+			break;
+		}
+		Block *b = &bt->ring[bt->next % BATCH_RING];
+		b->id = bt->next++;
+		b->begin = bt->data + bt->pos;
+		size_t end = bt->pos + BATCH_BLOCK;
+		if (end >= bt->size) {
+			end = bt->size;
+		} else {
+			const char *nl = memchr(bt->data + end, '\n', bt->size - end);
+			end = nl ? (size_t)(nl - bt->data) + 1 : bt->size;
+		}
+		b->end = bt->data + end;
+		bt->pos = end;
+		pthread_mutex_unlock(&bt->lock);
+
+		int ok = eval_block(b);
+
+		pthread_mutex_lock(&bt->lock);
+		if (!ok) {
+			bt->failed = 1;
+		}
+		b->done = 1;
+		pthread_cond_broadcast(&bt->cond);
+	}
+	pthread_cond_broadcast(&bt->cond);
+	pthread_mutex_unlock(&bt->lock);
+	return NULL;
+}
+
+/* The whole input in memory: mmapped when it is a regular file */
+static const char *map_input(const char *path, size_t *size, int *mapped) {
+	int fd = (path && strcmp(path, "-") != 0) ? open(path, O_RDONLY) : 0;
+	struct stat st;
+	if (fd < 0) {
+		perror(path);
+		return NULL;
+	}
+	*mapped = 0;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED) {
+			madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+			if (fd) {
+				close(fd);
+			}
+			*size = (size_t)st.st_size;
+			*mapped = 1;
+			return p;
+		}
+	}
+	size_t len = 0, cap = 1 << 20;
+	char *buf = malloc(cap);
+	for (;;) {
+		if (!buf) {
+			fprintf(stderr, "Error: out of memory reading input.\n");
+			return NULL;
+		}
+		ssize_t n = read(fd, buf + len, cap - len);
+		if (n <= 0) {
+			break;
+		}
+		len += (size_t)n;
+		if (len == cap) {
+			char *nb = realloc(buf, cap *= 2);
+			if (!nb) {
+				free(buf);
+			}
+			buf = nb;
+		}
+	}
+	if (fd) {
+		close(fd);
+	}
+	*size = len;
+	return buf;
+}
+
+static int run_batch(int argc, char **argv) {
+	const char *path = NULL;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			threads = atol(argv[++i]);
+		} else {
+			path = argv[i];
+		}
+	}
+	if (threads < 1) {
+		threads = 1;
+	}
+
+	static Batch bt;
+	int mapped;
+	unsigned long long t0 = now_ns();
+	bt.data = map_input(path, &bt.size, &mapped);
+	if (!bt.data) {
+		return 1;
+	}
+	pthread_mutex_init(&bt.lock, NULL);
+	pthread_cond_init(&bt.cond, NULL);
+	setvbuf(stdout, NULL, _IOFBF, BATCH_OUT_BUF);
+
+	pthread_t *tids = calloc((size_t)threads, sizeof(pthread_t));
+	long started = 0;
+	while (tids && started < threads && pthread_create(&tids[started], NULL, batch_worker, &bt) == 0) {
+		started++;
+	}
+	if (started == 0) {
+		fprintf(stderr, "Error: could not start worker threads.\n");
+		return 1;
+	}
+
+	/* Writer: blocks go out strictly in claim order */
+	unsigned long lines = 0;
+	pthread_mutex_lock(&bt.lock);
+	for (unsigned long id = 0;; id++) {
+		Block *b = &bt.ring[id % BATCH_RING];
+		while (!(b->done && b->id == id) && !bt.failed && !(id >= bt.next && bt.pos >= bt.size)) {
+			pthread_cond_wait(&bt.cond, &bt.lock);
+		}
+		if (!(b->done && b->id == id)) {
+			break;
+		}
+		pthread_mutex_unlock(&bt.lock);
+		fwrite(b->out, 1, b->outLen, stdout);
+		lines += b->lines;
+		pthread_mutex_lock(&bt.lock);
+		b->done = 0;
+		bt.written++;
+		pthread_cond_broadcast(&bt.cond);
+	}
+	int failed = bt.failed;
+	pthread_mutex_unlock(&bt.lock);
+	for (long i = 0; i < started; i++) {
+		pthread_join(tids[i], NULL);
+	}
+	fflush(stdout);
+
+	double secs = (now_ns() - t0) / 1e9;
+	fprintf(stderr, "%lu lines in %.3f s: %.0f lines/s (%ld threads)\n",
+		lines, secs, secs > 0 ? lines / secs : 0.0, started);
+	if (failed) {
+		fprintf(stderr, "Error: out of memory, output is incomplete.\n");
+	}
+	for (int i = 0; i < BATCH_RING; i++) {
+		free(bt.ring[i].out);
+	}
+	free(tids);
+	if (mapped) {
+		munmap((void *)bt.data, bt.size);
+	} else {
+		free((void *)bt.data);
+	}
+	return failed;
+}
+
+/*
+ * Row mode: one expression evaluated over many rows of numbers.
+ *
+ *   ./calc --map EXPR [file|-] [--no-jit]   one row of numbers per input line
+ *   ./calc --jit-bench EXPR [rows]          interpreter vs JIT on random rows
+ *
+ * Columns (separated by spaces, tabs or commas) bind to the variables EXPR
+ * reads, in the order they first appear: "x*y+x" reads x from column 1 and y
+ * from column 2. The expression is compiled once; rows then go through native
+ * code from jit.c, or through expr_run when the JIT cannot take the program.
+ */
+#define ROW_CHUNK 65536
+
+typedef struct {
+	ExprProgram prog;
+	ExprEnv env;
+	int colOf[EXPR_MAX_VARS];   /* column of each variable slot, -1 if unread */
+	int ncols;
+	Jit jit;
+} RowExpr;
+
+static int rowexpr_init(RowExpr *r, const char *src, int allowJit) {
+	expr_env_init(&r->env);
+	int err = expr_compile(src, &r->prog, &r->env);
+	if (err) {
+		fprintf(stderr, "Error: %s", expr_error(err));
+		if (err == EXPR_ERR_SYNTAX) {
+			fprintf(stderr, " at column %d", r->prog.errPos + 1);
+		}
+		fprintf(stderr, ".\n");
+		return 0;
+	}
+	for (int i = 0; i < EXPR_MAX_VARS; i++) {
+		r->colOf[i] = -1;
+	}
+	r->ncols = 0;
+	for (const unsigned char *ip = r->prog.code; *ip != EXPR_OP_END; ip++) {
+		if (*ip == EXPR_OP_LOAD && r->colOf[ip[1]] < 0) {
+			r->colOf[ip[1]] = r->ncols++;
+		}
+		if (*ip == EXPR_OP_CONST || *ip == EXPR_OP_LOAD || *ip == EXPR_OP_STORE) {
+			ip++;
+		}
+	}
+	if (!allowJit || !jit_compile(&r->prog, r->colOf, &r->jit)) {
+		r->jit.fn = NULL;
+		r->jit.mem = NULL;
+	}
+	return 1;
 }
 
-int main(void) {
-	char line[256];
+static int rowexpr_interp(RowExpr *r, const double *row, double *out) {
+	for (int i = 0; i < r->env.count; i++) {
+		if (r->colOf[i] >= 0) {
+			r->env.vars[i].value = row[r->colOf[i]];
+			r->env.vars[i].set = 1;
+		}
+	}
+	return expr_run(&r->prog, &r->env, out);
+}
+
+/* err[i] receives 0 or the EXPR_ERR_ code for row i */
+static void rowexpr_eval(RowExpr *r, const double *rows, long n, double *out, unsigned char *err) {
+	long i = 0;
+	while (i < n) {
+		if (r->jit.fn) {
+			long done = r->jit.fn(rows + i * r->ncols, n - i, r->ncols * (long)sizeof(double), out + i);
+			memset(err + i, 0, (size_t)done);
+			i += done;
+			if (i == n) {
+				break;
+			}
+		}
+		/* no JIT, or the row the JIT stopped at: the interpreter reports the error */
+		err[i] = (unsigned char)rowexpr_interp(r, rows + i * r->ncols, &out[i]);
+		i++;
+	}
+}
+
+/* Parses up to ncols numbers; returns how many were found */
+static int scan_row(const char *p, const char *end, double *row, int ncols) {
+	int n = 0;
+	while (n < ncols) {
+		while (p < end && (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')) {
+			p++;
+		}
+		if (p == end) {
+			break;
+		}
+		char *stop;
+		row[n] = strtod(p, &stop);
+		if (stop == p || stop > end) {
+			break;
+		}
+		n++;
+		p = stop;
+	}
+	return n;
+}
+
+static int run_map(int argc, char **argv) {
+	const char *src = NULL, *path = NULL;
+	int allowJit = 1;
+	for (int i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "--no-jit") == 0) {
+			allowJit = 0;
+		} else if (!src) {
+			src = argv[i];
+		} else {
+			path = argv[i];
+		}
+	}
+	static RowExpr r;
+	if (!src) {
+		fprintf(stderr, "Usage: calc --map EXPR [file|-] [--no-jit]\n");
+		return 1;
+	}
+	if (!rowexpr_init(&r, src, allowJit)) {
+		return 1;
+	}
+	size_t size;
+	int mapped;
+	const char *data = map_input(path, &size, &mapped);
+	if (!data) {
+		return 1;
+	}
+	int cols = r.ncols ? r.ncols : 1;
+	double *rows = malloc(sizeof(double) * ROW_CHUNK * (size_t)cols);
+	double *out = malloc(sizeof(double) * ROW_CHUNK);
+	unsigned char *err = malloc(ROW_CHUNK);
+	unsigned char *missing = malloc(ROW_CHUNK);
+	if (!rows || !out || !err || !missing) {
+		fprintf(stderr, "Error: out of memory.\n");
+		return 1;
+	}
+	setvbuf(stdout, NULL, _IOFBF, BATCH_OUT_BUF);
+
+	unsigned long long t0 = now_ns();
+	unsigned long total = 0;
+	const char *p = data, *end = data + size;
+	while (p < end) {
+		long n = 0;
+		while (p < end && n < ROW_CHUNK) {
+			const char *nl = memchr(p, '\n', (size_t)(end - p));
+			const char *eol = nl ? nl : end;
+			missing[n] = scan_row(p, eol, rows + n * r.ncols, r.ncols) < r.ncols;
+			n++;
+			p = nl ? nl + 1 : end;
+		}
+		rowexpr_eval(&r, rows, n, out, err);
+		for (long i = 0; i < n; i++) {
+			char buf[48];
+			if (missing[i]) {
+				fputs("error: missing column\n", stdout);
+			} else if (err[i]) {
+				printf("error: %s\n", expr_error(err[i]));
+			} else {
+				int len = expr_format(out[i], buf, sizeof(buf));
+				buf[len] = '\n';
+				fwrite(buf, 1, (size_t)len + 1, stdout);
+			}
+		}
+		total += (unsigned long)n;
+	}
+	fflush(stdout);
+	double secs = (now_ns() - t0) / 1e9;
+	fprintf(stderr, "%lu rows in %.3f s: %.0f rows/s (%s)\n", total, secs,
+		secs > 0 ? total / secs : 0.0, r.jit.fn ? "jit" : "interpreter");
+	jit_free(&r.jit);
+	free(rows);
+	free(out);
+	free(err);
+	free(missing);
+	if (mapped) {
+		munmap((void *)data, size);
+	} else {
+		free((void *)data);
+	}
+	return 0;
+}
+
+static int run_jit_bench(int argc, char **argv) {
+	const char *src = argc > 0 ? argv[0] : "x*y + 3*x - y/2 + (x-1)^2";
+	long n = argc > 1 ? atol(argv[1]) : 10000000;
+	static RowExpr r;
+	if (n < 1 || !rowexpr_init(&r, src, 1)) {
+		return 1;
+	}
+	int cols = r.ncols ? r.ncols : 1;
+	double *rows = malloc(sizeof(double) * (size_t)n * (size_t)cols);
+	double *a = malloc(sizeof(double) * (size_t)n);
+	double *b = malloc(sizeof(double) * (size_t)n);
+	unsigned char *ea = malloc((size_t)n), *eb = malloc((size_t)n);
+	if (!rows || !a || !b || !ea || !eb) {
+		fprintf(stderr, "Error: out of memory for %ld rows.\n", n);
+		return 1;
+	}
+	unsigned long long seed = 88172645463325252ULL;
+	for (long i = 0; i < n * r.ncols; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		rows[i] = (double)(seed % 20001) / 100.0 - 100.0;
+	}
+	Jit jit = r.jit;
+	printf("%s over %ld rows, %d column(s)\n", src, n, r.ncols);
+
+	r.jit.fn = NULL;
+	unsigned long long t0 = now_ns();
+	rowexpr_eval(&r, rows, n, a, ea);
+	double ti = (now_ns() - t0) / 1e9;
+	printf("interpreter: %.3f s, %.1f M rows/s\n", ti, n / ti / 1e6);
+
+	if (!jit.fn) {
+		printf("jit: unavailable for this expression or host\n");
+	} else {
+		r.jit = jit;
+		t0 = now_ns();
+		rowexpr_eval(&r, rows, n, b, eb);
+		double tj = (now_ns() - t0) / 1e9;
+		int same = memcmp(a, b, sizeof(double) * (size_t)n) == 0 && memcmp(ea, eb, (size_t)n) == 0;
+		printf("jit:         %.3f s, %.1f M rows/s (%.1fx), results %s\n",
+			tj, n / tj / 1e6, ti / tj, same ? "identical" : "DIFFER");
+		jit_free(&r.jit);
+	}
+	free(rows);
+	free(a);
+	free(b);
+	free(ea);
+	free(eb);
+	return 0;
+}
+
+/* ./calc --bignum-bench: multiply and to-decimal time against operand size */
+static void bignum_report(int digits, unsigned long long school,
+			  unsigned long long karatsuba, unsigned long long toDecimal) {
+	if (school) {
+		printf("%8d digits: mul %10.3f ms schoolbook, %10.3f ms karatsuba, to-decimal %10.3f ms\n",
+		       digits, school / 1e6, karatsuba / 1e6, toDecimal / 1e6);
+	} else {
+		printf("%8d digits: mul %10s    schoolbook, %10.3f ms karatsuba, to-decimal %10.3f ms\n",
+		       digits, "-", karatsuba / 1e6, toDecimal / 1e6);
+	}
+}
+
+static int run_bignum_bench(void) {
+	static const int digits[] = { 1000, 10000, 100000, 1000000 };
+	bn_benchmark(digits, 4, 100000, now_ns, bignum_report);
+	return 0;
+}
+
+/* Prints an exact result in full; EXPR_ERR_NOMEM if it can't be formatted */
+static int print_exact(const BigInt *r) {
+	unsigned int size = bn_decimal_size(r);
+	char *s = malloc(size);
+	if (!s || bn_to_string(r, s, size) < 0) {
+		free(s);
+		return EXPR_ERR_NOMEM;
+	}
+	printf("= %s\n", s);
+	free(s);
+	return EXPR_OK;
+}
+
+int main(int argc, char **argv) {
+	char line[4096];
+	ExprEnv env;
+	ExprProgram prog;
+
+	bn_set_allocator(bn_malloc, bn_release);
+
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+		return run_bench();
+	}
+	if (argc > 1 && strcmp(argv[1], "--batch") == 0) {
+		return run_batch(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "--map") == 0) {
+		return run_map(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "--jit-bench") == 0) {
+		return run_jit_bench(argc - 2, argv + 2);
+	}
+	if (argc > 1 && strcmp(argv[1], "--bignum-bench") == 0) {
+		return run_bignum_bench();
+	}
+	expr_env_init(&env);
 	print_help();
 	for (;;) {
 		printf("> ");
@@ -35,49 +623,40 @@ int main(void) {
 			continue;
 		}
 
-		double a, b;
-		char op;
-		char extra;
-		if (sscanf(line, "%lf %c %lf %c", &a, &op, &b, &extra) == 4) {
-			printf("Error: too many tokens. Try: 3 + 4\n");
+		double result = 0;
+		BigInt exact;
+		int err = expr_compile(line, &prog, &env);
+		if (err == EXPR_ERR_SYNTAX) {
+			printf("Error: syntax error at column %d. Try 'help'.\n", prog.errPos + 1);
 			continue;
 		}
-		if (sscanf(line, "%lf %c %lf", &a, &op, &b) != 3) {
-			printf("Parse error. Try 'help'.\n");
-			continue;
+		/* Integers first, exactly; doubles for everything else and for 'ans' */
+		bn_init(&exact);
+		int exactErr = EXPR_ERR_INEXACT;
+		if (!err) {
+			exactErr = expr_run_exact(&prog, line, &exact);
+			if (exactErr != EXPR_ERR_INEXACT) {
+				err = exactErr;
+			}
 		}
-
-		double result = 0.0;
-		int ok = 1;
-		switch (op) {
-			case '+':
-				result = a + b;
-				break;
-			case '-':
-				result = a - b;
-				break;
-			case '*':
-				result = a * b;
-				break;
-			case 'x':
-			case 'X':
-				result = a * b;
-				break;
-			case '/':
-				if (b == 0.0) {
-					printf("Error: division by zero.\n");
-					ok = 0;
-				} else {
-					result = a / b;
+		if (!err) {
+			int derr = expr_run(&prog, &env, &result);
+			if (exactErr) {
+				err = derr;
+			} else {
+				if (!derr) {
+					expr_set(&env, "ans", result);
 				}
-				break;
-			default:
-				printf("Unknown op '%c'. Use + - * /\n", op);
-				ok = 0;
-				break;
+				err = print_exact(&exact);
+			}
 		}
-
-		if (ok) {
+		bn_free(&exact);
+		if (err) {
+			printf("Error: %s.\n", expr_error(err));
+			continue;
+		}
+		if (exactErr) {
+			expr_set(&env, "ans", result);
 			printf("= %.10g\n", result);
 		}
 	}
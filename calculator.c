@@ -0,0 +1,205 @@
+#include "calculator.h"
+#include "ui.h"
+#include "keymap.h"
+#include "expr.h"
+#include "clock.h"
+#include "kprintf.h"
+
+// ======= Calculator =======
+// Expressions go through the shared engine in expr.c (also used by calc.c).
+// Integer expressions are evaluated exactly with bignum.c; anything else
+// (fractions, variables, huge powers) falls back to doubles.
+// Variables persist between visits; 'ans' holds the last result.
+#define CALC_CAP 64            // input line, from the app arena
+#define CALC_LOG_DIGITS 4000   // longer exact results are summarized in the log too
+
+static ExprEnv g_calcEnv;
+static ExprProgram g_calcProg;
+
+// Shows an exact result, as "head...tail (N digits)" when it doesn't fit, and
+// puts the digits in the kernel log where [L] can scroll through them
+static int calc_show_exact(const BigInt* r,char* lastRes,int cap){
+    unsigned int size=bn_decimal_size(r);
+    char* s=(char*)kmalloc(size);
+    if(!s) return EXPR_ERR_NOMEM;
+    int n=bn_to_string(r,s,size);
+    if(n<0){ kfree(s); return EXPR_ERR_NOMEM; }
+    if(n<cap){
+        for(int i=0;i<=n;i++) lastRes[i]=s[i];
+    }else{
+        char tail[12];
+        int k=0;
+        for(;k<16;k++) lastRes[k]=s[k];
+        lastRes[k++]='.'; lastRes[k++]='.'; lastRes[k++]='.';
+        for(int i=0;i<8;i++) tail[i]=s[n-8+i];
+        tail[8]='\0';
+        ksnprintf(lastRes+k,cap-k,"%s (%d digits)",tail,s[0]=='-' ? n-1 : n);
+    }
+    if(n<=CALC_LOG_DIGITS) kprintf("calc: %s\n",s);
+    else kprintf("calc: %d-digit result, ends ...%s\n",n,s+n-40);
+    kfree(s);
+    return EXPR_OK;
+}
+
+static void calc_evaluate(const char* src,char* lastRes,int cap){
+    double v=0;
+    BigInt exact;
+    bn_init(&exact);
+    int exactErr=EXPR_ERR_INEXACT;
+    int err = expr_compile(src,&g_calcProg,&g_calcEnv);
+    if(!err){
+        exactErr = expr_run_exact(&g_calcProg,src,&exact);
+        if(exactErr!=EXPR_ERR_INEXACT) err=exactErr;
+    }
+    if(!err){
+        // Doubles give the answer to inexact expressions and 'ans' for exact ones
+        int derr = expr_run(&g_calcProg,&g_calcEnv,&v);
+        if(exactErr) err=derr;
+        else if(!derr) expr_set(&g_calcEnv,"ans",v);
+        if(!exactErr) err = calc_show_exact(&exact,lastRes,cap);
+    }
+    bn_free(&exact);
+    fillAt(4,12,65,' ');
+    if(err){
+        lastRes[0]='\0';
+        if(err==EXPR_ERR_SYNTAX) ksnprintf(lastRes,cap,"Error: syntax at column %d",g_calcProg.errPos+1);
+        else ksnprintf(lastRes,cap,"Error: %s",expr_error(err));
+        return;
+    }
+    if(exactErr){
+        expr_set(&g_calcEnv,"ans",v);
+        expr_format(v,lastRes,cap);
+    }
+}
+
+void run_calculator(void){
+    clearScreen();
+    drawBox(0,0,24,79," Calculator ");
+    // Display box
+    drawBox(1,2,5,77," Display ");
+    writeAt(3,4,"Input: ");
+    writeAt(4,4,"Result: ");
+    // Help
+    writeAt(6,4,"Type, or Arrows+Space on the keypad. Enter:evaluate Del:clear ESC:Menu");
+    writeAt(7,4,"Example: r=2  then  3.14159*r^2  or  (ans+1)/2  or  2^300 (exact)");
+    char* buf = (char*)arena_alloc(&g_appArena,CALC_CAP); int len=0;
+    if(!buf) return;
+    char lastRes[48]; lastRes[0]='\0';
+
+    // Keypad including operators, parentheses, BKSP and ENT
+    const char* keys[5][4]={{"7","8","9","/"},
+                            {"4","5","6","*"},
+                            {"1","2","3","-"},
+                            {"(",")",".","^"},
+                            {"0","+","BKSP","ENT"}};
+    int selR=0, selC=0; // selection (rows 0..4, cols 0..3)
+
+    // draw keypad box
+    drawBox(9,10,21,69," Keypad ");
+    // render function
+    void render(void){
+        // refresh display Input/Result
+        fillAt(3,11,66,' ');
+        for(int i=0;i<len;i++) putCharAt(3,11+i,buf[i]);
+        fillAt(4,12,65,' ');
+        for(int i=0; lastRes[i] && i<60; i++) putCharAt(4,12+i,lastRes[i]);
+        // draw keypad 5x4
+        int baseR=11, baseC=14;
+        for(int r=0;r<5;r++){
+            for(int c=0;c<4;c++){
+                int sel = (selR==r && selC==c);
+                int isWide = (keys[r][c][0]=='B' || keys[r][c][0]=='E');
+                int w = isWide ? 7 : 5;
+                int step = isWide ? 9 : 7;
+                drawButton(baseR + r*2, baseC + c*step, keys[r][c], w, sel);
+            }
+        }
+        // MMIO cost of the previous frame (a full repaint would be 2000 cells)
+        char cells[12]; itoa10((int)vga_stats()->lastCells,cells);
+        fillAt(23,4,40,' ');
+        writeAt(23,4,"VGA cells last frame: ");
+        writeAt(23,26,cells);
+    } render();
+
+    for(;;){
+        unsigned char sc = next_key();
+        if(sc==0x01) return; // ESC
+        if(sc==0x0E){ // Backspace
+            if(len>0) len--;
+            render();
+            continue;
+        }
+        if(sc==0x53){ // Delete: clear the input
+            len=0;
+            render();
+            continue;
+        }
+
+        // Keypad navigation with the arrow keys
+        if(sc==0x48 || sc==0x50 || sc==0x4B || sc==0x4D){
+            if(sc==0x4B && selC>0) selC--;
+            if(sc==0x4D && selC<3) selC++;
+            if(sc==0x48 && selR>0) selR--;
+            if(sc==0x50 && selR<4) selR++;
+            render();
+            continue;
+        }
+
+        // Enter evaluates what was typed; Space presses the selected button
+        if(sc==0x1C || sc==0x39){
+            const char* lab = keys[selR][selC];
+            if(lab[0]=='B' && sc==0x39){ // BKSP
+                if(len>0) len--;
+                render();
+                continue;
+            }
+            if(sc==0x1C || lab[0]=='E'){ // ENT
+                buf[len]='\0';
+                if(len>0) calc_evaluate(buf,lastRes,sizeof(lastRes));
+                len=0;
+                render();
+                continue;
+            }
+            // Otherwise it's a single char button
+            if(len<CALC_CAP-1){
+                buf[len++]=lab[0];
+            }
+            render();
+            continue;
+        }
+
+        char c=scancode_to_ascii(sc);
+        if(c){
+            if(len<CALC_CAP-1){
+                buf[len++]=c;
+            }
+            render();
+        }
+    }
+}
+
+// Parse and evaluation throughput of the expression engine, logged at boot
+static unsigned long long calc_bench_now(void){ return rdtsc(); }
+
+void calc_benchmark(void){
+    static const char* const samples[]={
+        "1+2*3-4/5", "(x+y)*(x-y)/2", "-x^2+3*x-7", "((1+2)*(3+4))%5", "z=x*y+1"
+    };
+    ExprBench b;
+    expr_bench(samples,5,2000,calc_bench_now,&b);
+    kprintf("expr bench: parse %llu expr/s, eval %llu expr/s%s\n",
+            per_second(b.parses,b.parseTicks), per_second(b.evals,b.evalTicks),
+            b.failures ? " (failures)" : "");
+}
+
+// Multiply and to-decimal cost of the integer engine against operand size
+static void bignum_report(int digits,unsigned long long school,
+                          unsigned long long karatsuba,unsigned long long toDecimal){
+    kprintf("bignum bench: %d digits: mul %llu us schoolbook, %llu us karatsuba, to-decimal %llu us\n",
+            digits, cycles_to_ns(school)/1000, cycles_to_ns(karatsuba)/1000, cycles_to_ns(toDecimal)/1000);
+}
+
+void bignum_benchmark(void){
+    static const int digits[]={100,1000,10000};
+    bn_benchmark(digits,3,10000,calc_bench_now,bignum_report);
+}
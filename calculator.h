@@ -0,0 +1,11 @@
+#ifndef _CALCULATOR_H_
+#define _CALCULATOR_H_
+
+// Calculator app; variables and 'ans' persist between visits. Returns on ESC.
+void run_calculator(void);
+
+// Throughput of the expression and integer engines, written with kprintf
+void calc_benchmark(void);
+void bignum_benchmark(void);
+
+#endif
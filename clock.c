@@ -0,0 +1,116 @@
+#include "clock.h"
+#include "interrupts.h"
+#include "io.h"
+
+#define PIT_HZ 1193182
+#define CALIBRATE_MS 10
+
+static UINT64 g_tscHz = 0;
+static UINT64 g_tscBase = 0;            // TSC at clock_init, time zero for now_ns
+static volatile UINT64 g_ticks = 0;
+static Timer* g_timers = 0;             // pending one-shots, earliest first
+
+// Gate PIT channel 2 for CALIBRATE_MS and count TSC ticks until its output goes high
+static UINT64 calibrate_pit2(void){
+    UINT16 count = (UINT16)(PIT_HZ*CALIBRATE_MS/1000);
+    UINT8 gate = inb(0x61);
+    outb(0x61,(gate & ~0x02) | 0x01);     // speaker off, gate channel 2 on
+    outb(0x43,0xB0);                      // channel 2, lobyte/hibyte, mode 0
+    outb(0x42,count & 0xFF);
+    outb(0x42,count>>8);
+    // Restart the count by toggling the gate
+    gate = inb(0x61);
+    outb(0x61,gate & ~0x01);
+    outb(0x61,gate | 0x01);
+    UINT64 start = rdtsc();
+    while(!(inb(0x61)&0x20)) {}
+    UINT64 end = rdtsc();
+    outb(0x61,gate & ~0x03);
+    return (end-start)*(1000/CALIBRATE_MS);
+}
+
+// ======= Tick and one-shot timers =======
+static void timer_irq(struct regs* r){
+    (void)r;
+    g_ticks++;
+    if(!g_timers) return;
+    UINT64 now = now_ns();
+    while(g_timers && g_timers->due<=now){
+        Timer* t = g_timers;
+        g_timers = t->next;
+        t->armed = 0;
+        t->fn(t->arg);
+    }
+}
+
+static void timer_unlink(Timer* t){
+    for(Timer** p=&g_timers; *p; p=&(*p)->next){
+        if(*p==t){ *p=t->next; break; }
+    }
+    t->armed = 0;
+}
+
+void timer_start(Timer* t,UINT32 ms,timer_fn fn,void* arg){
+    UINT32 flags = irq_save();
+    if(t->armed) timer_unlink(t);
+    t->due = now_ns() + (UINT64)ms*1000000ULL;
+    t->fn = fn; t->arg = arg;
+    Timer** p = &g_timers;
+    while(*p && (*p)->due<=t->due) p=&(*p)->next;
+    t->next = *p;
+    *p = t;
+    t->armed = 1;
+    irq_restore(flags);
+}
+
+void timer_cancel(Timer* t){
+    UINT32 flags = irq_save();
+    if(t->armed) timer_unlink(t);
+    irq_restore(flags);
+}
+
+UINT64 clock_ticks(void){
+    UINT32 flags = irq_save();      // two 32-bit loads; don't let IRQ0 land in between
+    UINT64 t = g_ticks;
+    irq_restore(flags);
+    return t;
+}
+
+UINT64 now_ns(void){ return cycles_to_ns(rdtsc()-g_tscBase); }
+
+void sleep_ms(UINT32 ms){
+    UINT64 due = now_ns() + (UINT64)ms*1000000ULL;
+    // Each tick ends the hlt, so we overshoot by at most one tick period
+    while(now_ns()<due) __asm__ volatile("sti; hlt":::"memory");
+}
+
+void clock_init(void){
+    // Take the best of a few runs; a slow first pass (cold caches, VM exits) reads high
+    UINT64 best = 0;
+    for(int i=0;i<3;i++){
+        UINT64 hz = calibrate_pit2();
+        if(best==0 || hz<best) best=hz;
+    }
+    g_tscHz = best ? best : 1000000000ULL;
+    g_tscBase = rdtsc();
+
+    // Channel 0, lobyte/hibyte, mode 2 (rate generator)
+    UINT16 div = (UINT16)((PIT_HZ + TICK_HZ/2)/TICK_HZ);
+    outb(0x43,0x34);
+    outb(0x40,div & 0xFF);
+    outb(0x40,div>>8);
+    irq_register(0,timer_irq);
+}
+
+UINT64 tsc_hz(void){ return g_tscHz; }
+
+UINT64 cycles_to_ns(UINT64 cycles){
+    if(!g_tscHz) return 0;
+    // split to avoid overflowing 64 bits for long intervals
+    return (cycles/g_tscHz)*1000000000ULL + (cycles%g_tscHz)*1000000000ULL/g_tscHz;
+}
+
+UINT64 per_second(UINT64 count,UINT64 cycles){
+    if(!cycles) return 0;
+    return count*g_tscHz/cycles;
+}
@@ -0,0 +1,50 @@
+#ifndef _CLOCK_H_
+#define _CLOCK_H_
+
+#include "kernel.h"
+
+static inline UINT64 rdtsc(void){
+    UINT32 lo, hi;
+    __asm__ volatile("rdtsc":"=a"(lo),"=d"(hi));
+    return ((UINT64)hi<<32) | lo;
+}
+
+#define TICK_HZ 1000    // PIT channel 0 periodic interrupt (IRQ0) rate
+
+// Measure the TSC rate against PIT channel 2 (one-shot, no interrupts needed),
+// then start the channel 0 tick on IRQ0. Needs interrupts_init() first.
+void clock_init(void);
+
+// TSC ticks per second as measured by clock_init()
+UINT64 tsc_hz(void);
+
+// Convert a TSC delta to nanoseconds / a per-second rate
+UINT64 cycles_to_ns(UINT64 cycles);
+UINT64 per_second(UINT64 count,UINT64 cycles);
+
+// Monotonic nanoseconds since clock_init(), read from the TSC
+UINT64 now_ns(void);
+
+// IRQ0 ticks since clock_init()
+UINT64 clock_ticks(void);
+
+// Halt (interrupts on) until at least ms milliseconds have passed
+void sleep_ms(UINT32 ms);
+
+// One-shot timers, checked on every tick. The caller owns the Timer, which
+// must stay alive while armed; fn runs in IRQ0 context with interrupts off,
+// so it should only record or wake something.
+typedef void (*timer_fn)(void* arg);
+
+typedef struct Timer {
+    UINT64 due;             // now_ns() deadline
+    timer_fn fn;
+    void* arg;
+    struct Timer* next;     // pending list, sorted by due
+    int armed;
+} Timer;
+
+void timer_start(Timer* t,UINT32 ms,timer_fn fn,void* arg);   // re-arms a pending timer
+void timer_cancel(Timer* t);
+
+#endif
@@ -0,0 +1,241 @@
+#include "diskfs.h"
+#include "memfs.h"
+#include "heap.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "bcache.h"
+#include "clock.h"
+#include "sched.h"
+
+#define STAGE_SECTORS 128            // 64 KiB staging buffer
+
+typedef struct {
+    UINT32 magic;
+    UINT32 version;
+    UINT32 files;
+    UINT32 bytes;                    // length of the record stream
+    UINT32 checksum;                 // over the record stream
+    UINT32 generation;               // bumped on every sync
+    UINT32 start;                    // first sector of the record stream (version 2)
+} Superblock;
+
+// Sequential reader/writer over the record stream, one staging buffer at a time
+typedef struct {
+    BlockDev* dev;
+    UINT32 lba;                      // next sector to transfer
+    UINT32 end;                      // first sector past the usable area
+    UINT8* buf;
+    UINT32 pos;                      // offset within buf
+    UINT32 avail;                    // valid bytes in buf (reader)
+    UINT32 total;
+    UINT32 sum;
+    int ok;
+} Stream;
+
+static BlockDev* g_dev = 0;
+static UINT32 g_limit = 0;
+static UINT32 g_generation = 0;
+static UINT32 g_start = 0;           // stream of the image on disk, 0 if none
+
+// The two stream areas share the sectors after the superblock
+static UINT32 area_size(void){ return (g_limit-1)/2; }
+static UINT32 area_start(int area){ return 1 + (UINT32)area*area_size(); }
+
+static void checksum(Stream* s,const UINT8* p,UINT32 n){
+    for(UINT32 i=0;i<n;i++) s->sum = ((s->sum<<5)|(s->sum>>27)) ^ p[i];
+}
+
+static void stream_flush(Stream* s){
+    if(!s->ok || s->pos==0) return;
+    UINT32 sectors = (s->pos+SECTOR_SIZE-1)/SECTOR_SIZE;
+    kmemset(s->buf+s->pos,0,sectors*SECTOR_SIZE-s->pos);
+    if(s->lba+sectors > s->end || !s->dev->write(s->dev,s->lba,sectors,s->buf)) s->ok=0;
+    s->lba += sectors;
+    s->pos = 0;
+}
+
+static void stream_put(Stream* s,const void* data,UINT32 n){
+    const UINT8* p=(const UINT8*)data;
+    checksum(s,p,n);
+    s->total += n;
+    while(n && s->ok){
+        UINT32 room = STAGE_SECTORS*SECTOR_SIZE - s->pos;
+        UINT32 k = n<room ? n : room;
+        kmemcpy(s->buf+s->pos,p,k);
+        s->pos+=k; p+=k; n-=k;
+        if(s->pos==STAGE_SECTORS*SECTOR_SIZE) stream_flush(s);
+    }
+}
+
+static void stream_get(Stream* s,void* data,UINT32 n){
+    UINT8* p=(UINT8*)data;
+    UINT32 want=n;
+    while(n && s->ok){
+        if(s->pos==s->avail){
+            UINT32 sectors = s->end-s->lba < STAGE_SECTORS ? s->end-s->lba : STAGE_SECTORS;
+            if(sectors==0 || !s->dev->read(s->dev,s->lba,sectors,s->buf)){ s->ok=0; break; }
+            s->lba += sectors;
+            s->pos = 0;
+            s->avail = sectors*SECTOR_SIZE;
+        }
+        UINT32 k = s->avail-s->pos; if(k>n) k=n;
+        kmemcpy(p,s->buf+s->pos,k);
+        s->pos+=k; p+=k; n-=k;
+    }
+    if(s->ok) checksum(s,(UINT8*)data,want);
+}
+
+static int stream_open(Stream* s,UINT32 startLba,UINT32 endLba){
+    s->dev = g_dev;
+    s->lba = startLba;
+    s->end = endLba;
+    s->pos = s->avail = s->total = s->sum = 0;
+    s->buf = (UINT8*)kmalloc(STAGE_SECTORS*SECTOR_SIZE);
+    s->ok = s->buf!=0;
+    return s->ok;
+}
+
+int diskfs_mounted(void){ return g_dev!=0; }
+
+int diskfs_mount(BlockDev* dev,UINT32 limitSectors){
+    g_dev = dev;
+    g_limit = limitSectors;
+    Superblock* sb = (Superblock*)kmalloc(SECTOR_SIZE);
+    if(!sb) return -1;
+    if(!dev->read(dev,0,1,sb) || sb->magic!=DISKFS_MAGIC || sb->version<1 || sb->version>2 ||
+       (sb->version==2 && (sb->start<1 || sb->start>=limitSectors))){
+        kfree(sb);
+        kprintf("diskfs: %s has no memfs image, it will be created on first save\n", dev->name);
+        return -1;
+    }
+    UINT32 files = sb->files, bytes = sb->bytes, sum = sb->checksum;
+    g_generation = sb->generation;
+    g_start = sb->version==1 ? 1 : sb->start;       // version 1 had one stream at sector 1
+    kfree(sb);
+
+    Stream s;
+    if(!stream_open(&s,g_start,g_limit)) return -1;
+    char name[MEMFS_NAME_MAX];
+    UINT8* chunk = (UINT8*)kmalloc(4096);
+    UINT32 loaded = 0;
+    for(UINT32 i=0;i<files && s.ok && chunk;i++){
+        UINT32 hdr[2];
+        stream_get(&s,hdr,sizeof(hdr));
+        if(hdr[0]==0 || hdr[0]>=MEMFS_NAME_MAX){ s.ok=0; break; }
+        stream_get(&s,name,hdr[0]);
+        name[hdr[0]]='\0';
+        MemFile* f = memfs_open(name,1);
+        if(f) memfs_truncate(f,0);
+        for(UINT32 left=hdr[1]; left && s.ok; ){
+            UINT32 k = left<4096 ? left : 4096;
+            stream_get(&s,chunk,k);
+            if(f) memfs_append(f,chunk,k);
+            left -= k;
+        }
+        loaded++;
+    }
+    kfree(chunk);
+    kfree(s.buf);
+    if(!s.ok || s.sum!=sum){
+        kprintf("diskfs: image on %s is damaged (%u of %u files read)\n", dev->name, loaded, files);
+        return loaded;
+    }
+    kprintf("diskfs: mounted %s, %u files, %u bytes, generation %u\n", dev->name, files, bytes, g_generation);
+    return (int)loaded;
+}
+
+int diskfs_sync(void){
+    if(!g_dev) return 0;
+    // never overwrite the stream the superblock describes
+    UINT32 start = area_start(g_start==area_start(0) ? 1 : 0);
+    Stream s;
+    if(!stream_open(&s,start,start+area_size())) return 0;
+    UINT8* chunk = (UINT8*)kmalloc(4096);
+    UINT32 files = 0;
+    for(MemFile* f=memfs_next(0); f && s.ok && chunk; f=memfs_next(f)){
+        if(memfs_borrowed(f)) continue;      // unchanged initrd file, back next boot
+        const char* name = memfs_name(f);
+        UINT32 hdr[2];
+        hdr[0]=0; while(name[hdr[0]]) hdr[0]++;
+        hdr[1]=memfs_size(f);
+        stream_put(&s,hdr,sizeof(hdr));
+        stream_put(&s,name,hdr[0]);
+        for(UINT32 off=0; off<hdr[1] && s.ok; ){
+            int k = memfs_read(f,off,chunk,4096);
+            stream_put(&s,chunk,(UINT32)k);
+            off += (UINT32)k;
+        }
+        files++;
+    }
+    stream_flush(&s);
+    int ok = s.ok && chunk;
+    kfree(chunk);
+    kfree(s.buf);
+    // the device is normally a cache wrapper: the stream has to be on disk
+    // before the superblock that points at it
+    if(!ok || !bcache_sync(g_dev)) return 0;
+
+    // the superblock goes last so it only ever describes a complete stream;
+    // until it is written the previous image stays intact in the other area
+    Superblock* sb = (Superblock*)kzalloc(SECTOR_SIZE);
+    if(!sb) return 0;
+    sb->magic = DISKFS_MAGIC;
+    sb->version = 2;
+    sb->files = files;
+    sb->bytes = s.total;
+    sb->checksum = s.sum;
+    sb->generation = g_generation+1;
+    sb->start = start;
+    ok = g_dev->write(g_dev,0,1,sb);
+    kfree(sb);
+    if(!ok) return 0;
+    // from here on the cache holds a superblock pointing at this stream, so
+    // the next sync must use the other area even if this flush fails
+    g_generation++;
+    g_start = start;
+    return bcache_sync(g_dev);
+}
+
+// ======= Background flush =======
+// Saving only copies a document into memfs; this thread then writes memfs
+// out to disk while the editor keeps taking keys. g_fsLock keeps memfs from
+// changing underneath diskfs_sync(). Zeroed, both are ready to use.
+static Mutex g_fsLock;
+static WaitQueue g_flushWait;
+static volatile int g_flushPending = 0;
+
+void diskfs_lock(void){ mutex_lock(&g_fsLock); }
+void diskfs_unlock(void){ mutex_unlock(&g_fsLock); }
+
+static void flusher_main(void* arg){
+    (void)arg;
+    for(;;){
+        UINT32 flags = irq_save();
+        while(!g_flushPending) sched_wait(&g_flushWait);
+        g_flushPending = 0;
+        irq_restore(flags);
+
+        UINT64 t0 = now_ns();
+        diskfs_lock();
+        int ok = diskfs_sync();
+        diskfs_unlock();
+        if(ok){
+            kprintf("diskfs: background sync took %llu ms\n", (now_ns()-t0)/1000000);
+            bcache_report();
+        }else{
+            kprintf("diskfs: background sync failed\n");
+        }
+    }
+}
+
+int diskfs_start_flusher(void){
+    return thread_create("flusher",flusher_main,0,SCHED_PRIO_BACKGROUND)!=0;
+}
+
+// Coalesces: saves made while a sync runs are picked up by one more pass
+void diskfs_request_sync(void){
+    UINT32 flags = irq_save();
+    g_flushPending = 1;
+    sched_wake_one(&g_flushWait);
+    irq_restore(flags);
+}
@@ -0,0 +1,32 @@
+#ifndef _DISKFS_H_
+#define _DISKFS_H_
+
+#include "blockdev.h"
+
+// ======= On-disk image of memfs =======
+// Sector 0 holds a superblock; the sectors after it are split into two areas
+// for the record stream, one record per file:
+//   UINT32 name length, UINT32 data length, name bytes, data bytes
+// diskfs_sync() writes the whole store into the area the superblock does not
+// point at and only then rewrites the superblock, so a crash or an I/O error
+// mid-sync leaves the previous image readable by diskfs_mount().
+#define DISKFS_MAGIC 0x3153464D      // "MFS1"
+
+// Load files from the device into memfs; returns the number of files, -1 if unformatted
+int diskfs_mount(BlockDev* dev,UINT32 limitSectors);
+
+// Write the current memfs contents to the mounted device and flush the block
+// cache; blocks whose contents did not change are not rewritten. Initrd files
+// that were never written are left out, the module brings them back. 1 on success
+int diskfs_sync(void);
+int diskfs_mounted(void);
+
+// Background writer thread (needs sched_init): diskfs_request_sync() wakes it
+// to run diskfs_sync(); requests made during a sync are coalesced into one
+// more pass. Code that touches memfs, even to read, holds diskfs_lock() meanwhile.
+int diskfs_start_flusher(void);
+void diskfs_request_sync(void);
+void diskfs_lock(void);
+void diskfs_unlock(void);
+
+#endif
@@ -0,0 +1,42 @@
+#include "kernel.h"
+
+// ======= 64-bit division helpers =======
+// gcc lowers 64-bit '/' and '%' on i386 to these libgcc routines. The kernel is
+// linked without libgcc, so provide them here (shift-subtract, with a fast path
+// when both operands fit in 32 bits).
+#ifndef __x86_64__
+
+UINT64 __udivmoddi4(UINT64 n,UINT64 d,UINT64* rem){
+    if(d==0){ if(rem) *rem=0; return 0; }
+    if((n>>32)==0 && (d>>32)==0){
+        UINT32 q=(UINT32)n/(UINT32)d;
+        if(rem) *rem=(UINT32)n-q*(UINT32)d;
+        return q;
+    }
+    UINT64 q=0, r=0;
+    int bits = 64-__builtin_clzll(n);
+    for(int i=bits-1;i>=0;i--){
+        r = (r<<1) | ((n>>i)&1);
+        if(r>=d){ r-=d; q|=(UINT64)1<<i; }
+    }
+    if(rem) *rem=r;
+    return q;
+}
+
+UINT64 __udivdi3(UINT64 n,UINT64 d){ return __udivmoddi4(n,d,0); }
+
+UINT64 __umoddi3(UINT64 n,UINT64 d){ UINT64 r; __udivmoddi4(n,d,&r); return r; }
+
+long long __divdi3(long long n,long long d){
+    int neg = (n<0)!=(d<0);
+    UINT64 q = __udivmoddi4(n<0 ? -(UINT64)n : (UINT64)n, d<0 ? -(UINT64)d : (UINT64)d, 0);
+    return neg ? -(long long)q : (long long)q;
+}
+
+long long __moddi3(long long n,long long d){
+    UINT64 r;
+    __udivmoddi4(n<0 ? -(UINT64)n : (UINT64)n, d<0 ? -(UINT64)d : (UINT64)d, &r);
+    return n<0 ? -(long long)r : (long long)r;
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "editor.h"
+#include "ui.h"
+#include "keymap.h"
+#include "textbuf.h"
+#include "memfs.h"
+#include "diskfs.h"
+#include "kprintf.h"
+
+// ======= Text Editor =======
+// Gap-buffer editor (textbuf.c): insert/delete at a movable cursor, arrow-key
+// navigation, undo/redo, and documents limited only by memory.
+
+// Text area inside the box: rows 2..22, columns 2..77. Lines are not wrapped;
+// the view scrolls sideways to keep the cursor visible.
+#define ED_TOP 2
+#define ED_ROWS 21
+#define ED_LEFT 2
+#define ED_COLS 76
+#define ED_IO_CHUNK 4096
+
+typedef struct {
+    TextBuf tb;
+    UINT32 topLine;          // first line shown
+    UINT32 leftCol;          // first column shown
+    UINT32 wantCol;          // column kept while moving up/down through short lines
+    // what is on screen, so a keystroke that stays inside one line redraws only that row
+    UINT32 shownTop, shownLeft, shownLines;
+    int redrawAll;
+} Editor;
+
+// Move to a line, keeping the remembered column where the line is long enough
+static void ed_goto_line(Editor* ed,UINT32 line){
+    UINT32 lines=tb_line_count(&ed->tb);
+    if(line>=lines) line=lines-1;
+    UINT32 len=tb_line_length(&ed->tb,line);
+    UINT32 col = ed->wantCol < len ? ed->wantCol : len;
+    tb_set_cursor(&ed->tb,tb_line_start(&ed->tb,line)+col);
+}
+
+static void ed_draw_row(Editor* ed,int r,UINT32 pos){
+    UINT32 line=ed->topLine+r;
+    int c=0;
+    if(line<tb_line_count(&ed->tb)){
+        UINT32 len=tb_line_length(&ed->tb,line);
+        for(UINT32 i=ed->leftCol; i<len && c<ED_COLS; i++) putCharAt(ED_TOP+r,ED_LEFT+c++,tb_char_at(&ed->tb,pos+i));
+    }
+    fillAt(ED_TOP+r,ED_LEFT+c,ED_COLS-c,' ');
+}
+
+// Cost depends on the rows redrawn, not on the size of the document: line
+// starts come from the index, walking outwards from the cursor's line.
+static void ed_render(Editor* ed){
+    UINT32 line=tb_cursor_line(&ed->tb), col=tb_cursor_col(&ed->tb);
+    if(line<ed->topLine) ed->topLine=line;
+    if(line>=ed->topLine+ED_ROWS) ed->topLine=line-ED_ROWS+1;
+    if(col<ed->leftCol) ed->leftCol=col;
+    if(col>=ed->leftCol+ED_COLS) ed->leftCol=col-ED_COLS+1;
+
+    UINT32 lines=tb_line_count(&ed->tb);
+    if(ed->redrawAll || ed->topLine!=ed->shownTop || ed->leftCol!=ed->shownLeft || lines!=ed->shownLines){
+        UINT32 pos=tb_line_start(&ed->tb,ed->topLine);
+        for(int r=0;r<ED_ROWS;r++){
+            ed_draw_row(ed,r,pos);
+            pos += tb_line_length(&ed->tb,ed->topLine+r)+1;
+        }
+        ed->shownTop=ed->topLine; ed->shownLeft=ed->leftCol; ed->shownLines=lines;
+        ed->redrawAll=0;
+    }else{
+        ed_draw_row(ed,(int)(line-ed->topLine),tb_cursor(&ed->tb)-col);
+    }
+    setCursor(ED_TOP+(int)(line-ed->topLine),ED_LEFT+(int)(col-ed->leftCol));
+
+    char status[48];
+    ksnprintf(status,sizeof(status),"Ln %u/%u, Col %u  %u bytes",line+1,lines,col+1,tb_length(&ed->tb));
+    fillAt(23,2,46,' ');
+    writeAt(23,2,status);
+}
+
+// The file is grown to the document's length before anything is overwritten:
+// only that step (or copying an initrd file off the module, which happens on
+// the first write) can run out of memory, and either leaves the old contents.
+static int ed_save(Editor* ed,const char* name,char* chunk){
+    MemFile* f=memfs_open(name,1);
+    UINT32 len=tb_length(&ed->tb);
+    if(!f || (len>memfs_size(f) && !memfs_truncate(f,len))) return 0;
+    for(UINT32 off=0;off<len;){
+        UINT32 n=tb_read(&ed->tb,off,chunk,ED_IO_CHUNK);
+        if(memfs_write(f,off,chunk,n)<0) return 0;
+        off+=n;
+    }
+    return memfs_truncate(f,len);
+}
+
+// 1 when opened, 0 if there is no such file, -1 if it did not fit in memory
+// (the buffer is left empty rather than holding part of the file)
+static int ed_open(Editor* ed,const char* name,char* chunk){
+    MemFile* f=memfs_open(name,0);
+    if(!f) return 0;
+    tb_clear(&ed->tb);
+    UINT32 size=memfs_size(f);
+    int ok=1;
+    for(UINT32 off=0;off<size && ok;){
+        int n=memfs_read(f,off,chunk,ED_IO_CHUNK);
+        ok = n>0 && tb_load(&ed->tb,chunk,(UINT32)n);
+        off+=(UINT32)n;
+    }
+    if(!ok) tb_clear(&ed->tb);
+    tb_set_cursor(&ed->tb,0);
+    ed->topLine=0; ed->leftCol=0; ed->wantCol=0;
+    ed->redrawAll=1;
+    return ok ? 1 : -1;
+}
+
+void run_editor(void){
+    clearScreen();
+    drawBox(0,0,24,79," Editor ");
+    writeAt(24,2,"ESC:Menu F2:Save F3:Open F4:Undo F5:Redo Arrows/Home/End/PgUp/PgDn");
+    Editor ed;
+    char* chunk = (char*)arena_alloc(&g_appArena,ED_IO_CHUNK);
+    if(!chunk || !tb_init(&ed.tb)) return;
+    ed.topLine=0; ed.leftCol=0; ed.wantCol=0;
+    ed.redrawAll=1;
+    for(;;){
+        ed_render(&ed);
+        unsigned char sc = next_key();
+        UINT32 line;
+        if(sc==0x01){ // ESC
+            break;
+        }
+        if(sc==0x3C){ // F2 Save (make code)
+            // Prompt filename
+            writeAt(1,2,"Save as:             ");
+            fillAt(1,11,16,' ');
+            char name[16];
+            read_line_gui(1,11,name,16);
+            // Clear message line
+            fillAt(1,2,76,' ');
+            if(name[0]){
+                diskfs_lock();
+                int saved = ed_save(&ed,name,chunk);
+                diskfs_unlock();
+                if(saved){
+                    if(!diskfs_mounted()) writeAt(1,2,"Saved (RAM only, no disk).");
+                    else{ diskfs_request_sync(); writeAt(1,2,"Saved; writing to disk in the background (see log)."); }
+                }else{
+                    writeAt(1,2,"Save failed (out of memory).");
+                }
+            }else{
+                writeAt(1,2,"Cancelled.");
+            }
+            continue;
+        }
+        if(sc==0x3D){ // F3 Open
+            writeAt(1,2,"Open:                ");
+            fillAt(1,8,16,' ');
+            char name[16];
+            if(read_line_gui(1,8,name,16)){
+                fillAt(1,2,76,' ');
+                diskfs_lock();
+                int opened = ed_open(&ed,name,chunk);
+                diskfs_unlock();
+                if(opened>0) writeAt(1,2,"Opened.");
+                else if(opened<0) writeAt(1,2,"Open failed (out of memory).");
+                else writeAt(1,2,"Not found.");
+            }
+            continue;
+        }
+        if(sc==0x3E || sc==0x3F){ // F4 Undo, F5 Redo
+            int ok = sc==0x3E ? tb_undo(&ed.tb) : tb_redo(&ed.tb);
+            fillAt(1,2,76,' ');
+            if(!ok) writeAt(1,2, sc==0x3E ? "Nothing to undo." : "Nothing to redo.");
+            ed.wantCol=tb_cursor_col(&ed.tb);
+            ed.redrawAll=1;
+            continue;
+        }
+        // Navigation
+        if(sc==0x48 || sc==0x50 || sc==0x49 || sc==0x51){ // Up, Down, PgUp, PgDn
+            line=tb_cursor_line(&ed.tb);
+            if(sc==0x48) line = line>0 ? line-1 : 0;
+            if(sc==0x50) line = line+1;
+            if(sc==0x49) line = line>ED_ROWS ? line-ED_ROWS : 0;
+            if(sc==0x51) line = line+ED_ROWS;
+            ed_goto_line(&ed,line);
+            continue;
+        }
+        if(sc==0x4B || sc==0x4D || sc==0x47 || sc==0x4F){ // Left, Right, Home, End
+            UINT32 pos=tb_cursor(&ed.tb);
+            if(sc==0x4B && pos>0) pos--;
+            if(sc==0x4D) pos++;
+            if(sc==0x47 || sc==0x4F){
+                pos -= tb_cursor_col(&ed.tb);
+                if(sc==0x4F) pos += tb_line_length(&ed.tb,tb_cursor_line(&ed.tb));
+            }
+            tb_set_cursor(&ed.tb,pos);
+            ed.wantCol=tb_cursor_col(&ed.tb);
+            continue;
+        }
+        // Editing
+        if(sc==0x0E) tb_delete_back(&ed.tb);          // Backspace
+        else if(sc==0x53) tb_delete_forward(&ed.tb);  // Delete
+        else if(sc==0x1C) tb_insert(&ed.tb,"\n",1);  // Enter
+        else {
+            char c = scancode_to_ascii(sc);
+            if(!c) continue;
+            if(!tb_insert(&ed.tb,&c,1)) writeAt(1,2,"Out of memory.");
+        }
+        ed.wantCol=tb_cursor_col(&ed.tb);
+    }
+    tb_free(&ed.tb);
+}
@@ -0,0 +1,8 @@
+#ifndef _EDITOR_H_
+#define _EDITOR_H_
+
+// Full-screen text editor; saves and opens memfs files and returns on ESC.
+// Saving asks diskfs to write back in the background when a disk is mounted.
+void run_editor(void);
+
+#endif
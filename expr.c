@@ -0,0 +1,494 @@
+#include "expr.h"
+#if __STDC_HOSTED__
+#include <stdlib.h>          // strtod, for literals too long to scale exactly
+#endif
+
+// ======= Variables =======
+static int name_eq(const char* a,const char* b,int n){
+    for(int i=0;i<n;i++) if(a[i]!=b[i]) return 0;
+    return a[n]==0;
+}
+
+// Slot for a name of length n, created if missing; -1 when the table is full
+static int var_slot(ExprEnv* env,const char* name,int n){
+    for(int i=0;i<env->count;i++) if(name_eq(env->vars[i].name,name,n)) return i;
+    if(env->count==EXPR_MAX_VARS || n>=EXPR_NAME_MAX) return -1;
+    ExprVar* v = &env->vars[env->count];
+    for(int i=0;i<n;i++) v->name[i]=name[i];
+    v->name[n]=0;
+    v->value=0; v->set=0;
+    return env->count++;
+}
+
+void expr_env_init(ExprEnv* env){ env->count=0; }
+
+void expr_set(ExprEnv* env,const char* name,double v){
+    int n=0; while(name[n]) n++;
+    int slot = var_slot(env,name,n);
+    if(slot<0) return;
+    env->vars[slot].value=v;
+    env->vars[slot].set=1;
+}
+
+// ======= Compiler =======
+typedef struct {
+    const char* s;
+    int pos;
+    ExprProgram* p;
+    ExprEnv* env;
+    int depth, maxDepth;     // VM stack use of the code emitted so far
+    int err;
+} Comp;
+
+static int is_alpha(char c){ return (c>='a'&&c<='z') || (c>='A'&&c<='Z') || c=='_'; }
+static int is_digit(char c){ return c>='0'&&c<='9'; }
+
+static void skip_ws(Comp* c){ while(c->s[c->pos]==' '||c->s[c->pos]=='\t') c->pos++; }
+
+static char peek(Comp* c){ skip_ws(c); return c->s[c->pos]; }
+
+static void fail(Comp* c,int err){
+    if(!c->err){ c->err=err; c->p->errPos=c->pos; }
+}
+
+static void emit(Comp* c,unsigned char b){
+    if(c->p->ncode==EXPR_MAX_CODE){ fail(c,EXPR_ERR_TOO_BIG); return; }
+    c->p->code[c->p->ncode++]=b;
+}
+
+// Track stack depth: pushes are +1, binary operators -1
+static void stack_adjust(Comp* c,int d){
+    c->depth += d;
+    if(c->depth>c->maxDepth) c->maxDepth=c->depth;
+    if(c->maxDepth>EXPR_MAX_STACK) fail(c,EXPR_ERR_TOO_BIG);
+}
+
+// The constant's text is src[start..c->pos); a zero length marks it unusable
+// by the exact evaluator (only possible for absurdly long sources)
+static void emit_const(Comp* c,double v,int start){
+    if(c->p->nconsts==EXPR_MAX_CONSTS){ fail(c,EXPR_ERR_TOO_BIG); return; }
+    ExprConstSrc* cs=&c->p->constSrc[c->p->nconsts];
+    int len=c->pos-start;
+    cs->pos = c->pos<=0xFFFF ? (unsigned short)start : 0;
+    cs->len = c->pos<=0xFFFF ? (unsigned short)len : 0;
+    cs->neg = 0;
+    c->p->consts[c->p->nconsts]=v;
+    emit(c,EXPR_OP_CONST); emit(c,(unsigned char)c->p->nconsts++);
+    stack_adjust(c,1);
+}
+
+// Powers of ten that are exact doubles
+static const double g_pow10[23] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Up to 18 significant digits; 0 once the mantissa is full
+static int add_digit(unsigned long long* m,char ch){
+    if(*m >= 100000000000000000ull) return 0;
+    *m = *m*10 + (unsigned)(ch-'0');
+    return 1;
+}
+
+// The digits become an integer mantissa and a decimal exponent, scaled once
+// at the end: a single correctly rounded operation while the mantissa is
+// below 2^53 and the exponent within 22, which covers ordinary literals.
+// Anything longer goes to strtod where there is a libc, else is scaled in steps.
+static double parse_number(Comp* c){
+    const char* s=c->s;
+    int start=c->pos;
+    unsigned long long m=0;
+    int exp10=0;
+    while(is_digit(s[c->pos])){ if(!add_digit(&m,s[c->pos])) exp10++; c->pos++; }
+    if(s[c->pos]=='.'){
+        c->pos++;
+        while(is_digit(s[c->pos])){ if(add_digit(&m,s[c->pos])) exp10--; c->pos++; }
+    }
+    if((s[c->pos]=='e'||s[c->pos]=='E') &&
+       (is_digit(s[c->pos+1]) || ((s[c->pos+1]=='-'||s[c->pos+1]=='+') && is_digit(s[c->pos+2])))){
+        c->pos++;
+        int neg = s[c->pos]=='-';
+        if(s[c->pos]=='-'||s[c->pos]=='+') c->pos++;
+        int e=0;
+        while(is_digit(s[c->pos])){ if(e<400) e = e*10 + (s[c->pos]-'0'); c->pos++; }
+        exp10 += neg ? -e : e;
+    }
+    double v=(double)m;
+    if(m==0) return 0;
+    if(m < (1ull<<53) && exp10>=-22 && exp10<=22)
+        return exp10<0 ? v/g_pow10[-exp10] : v*g_pow10[exp10];
+#if __STDC_HOSTED__
+    char buf[64];
+    int len=c->pos-start;
+    if(len<(int)sizeof(buf)){
+        for(int i=0;i<len;i++) buf[i]=s[start+i];
+        buf[len]=0;
+        return strtod(buf,0);
+    }
+#else
+    (void)start;
+#endif
+    while(exp10>22){ v*=1e22; exp10-=22; }
+    while(exp10<-22){ v/=1e22; exp10+=22; }
+    return exp10<0 ? v/g_pow10[-exp10] : v*g_pow10[exp10];
+}
+
+static void parse_expr(Comp* c);
+static void parse_unary(Comp* c);
+
+static void parse_primary(Comp* c){
+    char ch=peek(c);
+    if(is_digit(ch) || (ch=='.' && is_digit(c->s[c->pos+1]))){
+        int start=c->pos;
+        double v=parse_number(c);
+        emit_const(c,v,start);
+    }else if(is_alpha(ch)){
+        int start=c->pos;
+        while(is_alpha(c->s[c->pos]) || is_digit(c->s[c->pos])) c->pos++;
+        int slot = var_slot(c->env,c->s+start,c->pos-start);
+        if(slot<0){ fail(c,EXPR_ERR_VARS); return; }
+        emit(c,EXPR_OP_LOAD); emit(c,(unsigned char)slot);
+        stack_adjust(c,1);
+    }else if(ch=='('){
+        c->pos++;
+        parse_expr(c);
+        if(peek(c)!=')'){ fail(c,EXPR_ERR_SYNTAX); return; }
+        c->pos++;
+    }else{
+        fail(c,EXPR_ERR_SYNTAX);
+    }
+}
+
+static void parse_power(Comp* c){
+    parse_primary(c);
+    if(!c->err && peek(c)=='^'){
+        c->pos++;
+        parse_unary(c);              // 2^-1 and 2^3^2 == 2^(3^2)
+        emit(c,EXPR_OP_POW); stack_adjust(c,-1);
+    }
+}
+
+static void parse_unary(Comp* c){
+    char ch=peek(c);
+    if(ch=='-' || ch=='+'){
+        c->pos++;
+        int at=c->p->ncode;
+        parse_unary(c);
+        if(ch=='+' || c->err) return;
+        // fold "-constant" into the constant itself
+        if(c->p->ncode==at+2 && c->p->code[at]==EXPR_OP_CONST){
+            c->p->consts[c->p->code[at+1]] *= -1;
+            c->p->constSrc[c->p->code[at+1]].neg ^= 1;
+        }else emit(c,EXPR_OP_NEG);
+        return;
+    }
+    parse_power(c);
+}
+
+static void parse_term(Comp* c){
+    parse_unary(c);
+    for(;;){
+        char ch=peek(c);
+        if(c->err || (ch!='*' && ch!='/' && ch!='%')) return;
+        c->pos++;
+        parse_unary(c);
+        emit(c, ch=='*' ? EXPR_OP_MUL : ch=='/' ? EXPR_OP_DIV : EXPR_OP_MOD);
+        stack_adjust(c,-1);
+    }
+}
+
+static void parse_expr(Comp* c){
+    parse_term(c);
+    for(;;){
+        char ch=peek(c);
+        if(c->err || (ch!='+' && ch!='-')) return;
+        c->pos++;
+        parse_term(c);
+        emit(c, ch=='+' ? EXPR_OP_ADD : EXPR_OP_SUB);
+        stack_adjust(c,-1);
+    }
+}
+
+int expr_compile(const char* src,ExprProgram* prog,ExprEnv* env){
+    Comp c;
+    c.s=src; c.pos=0; c.p=prog; c.env=env;
+    c.depth=c.maxDepth=0; c.err=0;
+    prog->ncode=prog->nconsts=0; prog->errPos=0;
+
+    // "name = expr" assigns; anything else is a plain expression
+    int target=-1;
+    skip_ws(&c);
+    if(is_alpha(src[c.pos])){
+        int start=c.pos, end=c.pos;
+        while(is_alpha(src[end]) || is_digit(src[end])) end++;
+        c.pos=end;
+        if(peek(&c)=='='){
+            target = var_slot(env,src+start,end-start);
+            if(target<0) return EXPR_ERR_VARS;
+            c.pos++;
+        }else{
+            c.pos=start;
+        }
+    }
+    parse_expr(&c);
+    if(!c.err && peek(&c)!=0) fail(&c,EXPR_ERR_SYNTAX);
+    if(target>=0){ emit(&c,EXPR_OP_STORE); emit(&c,(unsigned char)target); }
+    emit(&c,EXPR_OP_END);
+    return c.err;
+}
+
+// ======= VM =======
+static int is_integer(double x){
+    return x>-9.0e18 && x<9.0e18 && x==(double)(long long)x;
+}
+
+static int power(double a,double b,double* out){
+    if(!is_integer(b) || b>1e9 || b<-1e9) return EXPR_ERR_DOMAIN;
+    long long n = (long long)b;
+    int neg = n<0;
+    if(neg){
+        if(a==0) return EXPR_ERR_DIV0;
+        n=-n;
+    }
+    double r=1;
+    while(n){
+        if(n&1) r*=a;
+        a*=a;
+        n>>=1;
+    }
+    *out = neg ? 1/r : r;
+    return EXPR_OK;
+}
+
+int expr_run(const ExprProgram* prog,ExprEnv* env,double* out){
+    double st[EXPR_MAX_STACK];
+    int sp=0;
+    const unsigned char* ip=prog->code;
+    for(;;){
+        switch(*ip++){
+        case EXPR_OP_END:
+            *out = st[sp-1];
+            return EXPR_OK;
+        case EXPR_OP_CONST: st[sp++]=prog->consts[*ip++]; break;
+        case EXPR_OP_LOAD: {
+            const ExprVar* v=&env->vars[*ip++];
+            if(!v->set) return EXPR_ERR_UNDEF;
+            st[sp++]=v->value;
+            break;
+        }
+        case EXPR_OP_STORE: {
+            ExprVar* v=&env->vars[*ip++];
+            v->value=st[sp-1]; v->set=1;
+            break;
+        }
+        case EXPR_OP_ADD: sp--; st[sp-1]+=st[sp]; break;
+        case EXPR_OP_SUB: sp--; st[sp-1]-=st[sp]; break;
+        case EXPR_OP_MUL: sp--; st[sp-1]*=st[sp]; break;
+        case EXPR_OP_DIV:
+            sp--;
+            if(st[sp]==0) return EXPR_ERR_DIV0;
+            st[sp-1]/=st[sp];
+            break;
+        case EXPR_OP_MOD: {
+            sp--;
+            if(st[sp]==0) return EXPR_ERR_DIV0;
+            double q = st[sp-1]/st[sp];
+            if(q<=-9.0e18 || q>=9.0e18) return EXPR_ERR_DOMAIN;
+            st[sp-1] -= (double)(long long)q * st[sp];     // truncating, like C's fmod
+            break;
+        }
+        case EXPR_OP_POW: {
+            sp--;
+            int err = power(st[sp-1],st[sp],&st[sp-1]);
+            if(err) return err;
+            break;
+        }
+        case EXPR_OP_NEG: st[sp-1] = -st[sp-1]; break;
+        default: return EXPR_ERR_SYNTAX;
+        }
+    }
+}
+
+// ======= Exact VM =======
+// Same bytecode over BigInts. Constants are re-read from their source text,
+// since the double in consts has already lost digits past 2^53.
+static int exact_const(const ExprConstSrc* cs,const char* src,BigInt* out){
+    if(!cs->len) return EXPR_ERR_INEXACT;
+    for(int i=0;i<cs->len;i++) if(!is_digit(src[cs->pos+i])) return EXPR_ERR_INEXACT;
+    if(bn_from_string(out,src+cs->pos,cs->len)) return EXPR_ERR_NOMEM;
+    out->neg = cs->neg && out->n;
+    return EXPR_OK;
+}
+
+static int exact_pow(BigInt* a,const BigInt* b){
+    if(b->neg) return EXPR_ERR_INEXACT;
+    if(!b->n) return bn_set_int(a,1) ? EXPR_ERR_NOMEM : EXPR_OK;
+    // 0, 1 and -1 stay small whatever the exponent
+    if(a->n==0 || (a->n==1 && a->d[0]==1)){
+        if(!(b->d[0]&1)) a->neg=0;
+        return EXPR_OK;
+    }
+    if(b->n>1 || b->d[0]>EXPR_EXACT_MAX_BITS/bn_bit_length(a)) return EXPR_ERR_INEXACT;
+    return bn_pow(a,a,b->d[0]) ? EXPR_ERR_NOMEM : EXPR_OK;
+}
+
+static int exact_op(unsigned char op,BigInt* a,const BigInt* b){
+    int err=BN_OK;
+    switch(op){
+    case EXPR_OP_ADD: err=bn_add(a,a,b); break;
+    case EXPR_OP_SUB: err=bn_sub(a,a,b); break;
+    case EXPR_OP_MUL:
+        if(bn_bit_length(a)+bn_bit_length(b)>EXPR_EXACT_MAX_BITS) return EXPR_ERR_INEXACT;
+        err=bn_mul(a,a,b);
+        break;
+    case EXPR_OP_DIV: {
+        if(!b->n) return EXPR_ERR_DIV0;
+        BigInt rem; bn_init(&rem);
+        err=bn_divmod(a,&rem,a,b);
+        int inexact=!err && rem.n;
+        bn_free(&rem);
+        if(inexact) return EXPR_ERR_INEXACT;
+        break;
+    }
+    case EXPR_OP_MOD:
+        if(!b->n) return EXPR_ERR_DIV0;
+        err=bn_divmod(0,a,a,b);
+        break;
+    case EXPR_OP_POW: return exact_pow(a,b);
+    default: return EXPR_ERR_SYNTAX;
+    }
+    return err ? EXPR_ERR_NOMEM : EXPR_OK;
+}
+
+int expr_run_exact(const ExprProgram* prog,const char* src,BigInt* out){
+    BigInt st[EXPR_MAX_STACK];
+    int sp=0, err=EXPR_OK;
+    const unsigned char* ip=prog->code;
+    while(!err){
+        unsigned char op=*ip++;
+        if(op==EXPR_OP_END){
+            err = bn_copy(out,&st[sp-1]) ? EXPR_ERR_NOMEM : EXPR_OK;
+            break;
+        }else if(op==EXPR_OP_CONST){
+            bn_init(&st[sp]);
+            err=exact_const(&prog->constSrc[*ip],src,&st[sp]);
+            sp++; ip++;
+        }else if(op==EXPR_OP_LOAD || op==EXPR_OP_STORE){
+            err=EXPR_ERR_INEXACT;        // variables hold doubles
+        }else if(op==EXPR_OP_NEG){
+            st[sp-1].neg = !st[sp-1].neg && st[sp-1].n;
+        }else{
+            sp--;
+            err=exact_op(op,&st[sp-1],&st[sp]);
+            bn_free(&st[sp]);
+        }
+    }
+    while(sp) bn_free(&st[--sp]);
+    return err;
+}
+
+const char* expr_error(int code){
+    switch(code){
+    case EXPR_OK: return "ok";
+    case EXPR_ERR_SYNTAX: return "syntax error";
+    case EXPR_ERR_TOO_BIG: return "expression too long";
+    case EXPR_ERR_VARS: return "too many variables";
+    case EXPR_ERR_UNDEF: return "undefined variable";
+    case EXPR_ERR_DIV0: return "division by zero";
+    case EXPR_ERR_DOMAIN: return "out of domain";
+    case EXPR_ERR_INEXACT: return "not an exact integer";
+    case EXPR_ERR_NOMEM: return "out of memory";
+    default: return "error";
+    }
+}
+
+// ======= Formatting =======
+static int put(char* out,int cap,int n,char ch){
+    if(n<cap-1) out[n]=ch;
+    return n+1;
+}
+
+static int put_uint(char* out,int cap,int n,unsigned long long v){
+    char tmp[24]; int k=0;
+    do{ tmp[k++]='0'+(int)(v%10); v/=10; }while(v);
+    while(k--) n=put(out,cap,n,tmp[k]);
+    return n;
+}
+
+int expr_format(double v,char* out,int cap){
+    int n=0;
+    if(cap<=0) return 0;
+    if(v!=v){
+        n=put(out,cap,n,'n'); n=put(out,cap,n,'a'); n=put(out,cap,n,'n');
+    }else{
+        if(v<0){ n=put(out,cap,n,'-'); v=-v; }
+        if(v>1.7976931348623157e308){
+            n=put(out,cap,n,'i'); n=put(out,cap,n,'n'); n=put(out,cap,n,'f');
+        }else if(v<1e10 && v==(double)(long long)v){   // up to 10 digits: exact and %g-style
+            n=put_uint(out,cap,n,(unsigned long long)(long long)v);
+        }else{
+            // scale into [1,10) and keep 10 significant digits
+            int e=0;
+            while(v>=10){ v/=10; e++; }
+            while(v<1){ v*=10; e--; }
+            long long digits = (long long)(v*1e9+0.5);
+            if(digits>=10000000000LL){ digits/=10; e++; }
+            char d[10];
+            for(int i=9;i>=0;i--){ d[i]='0'+(int)(digits%10); digits/=10; }
+            int last=9; while(last>0 && d[last]=='0') last--;
+            if(e>=-4 && e<10){
+                if(e<0){
+                    n=put(out,cap,n,'0'); n=put(out,cap,n,'.');
+                    for(int i=-1;i>e;i--) n=put(out,cap,n,'0');
+                    for(int i=0;i<=last;i++) n=put(out,cap,n,d[i]);
+                }else{
+                    for(int i=0;i<=e;i++) n=put(out,cap,n,d[i]);
+                    if(last>e){
+                        n=put(out,cap,n,'.');
+                        for(int i=e+1;i<=last;i++) n=put(out,cap,n,d[i]);
+                    }
+                }
+            }else{
+                n=put(out,cap,n,d[0]);
+                if(last>0){
+                    n=put(out,cap,n,'.');
+                    for(int i=1;i<=last;i++) n=put(out,cap,n,d[i]);
+                }
+                n=put(out,cap,n,'e');
+                n=put(out,cap,n, e<0 ? '-' : '+');
+                if(e<0) e=-e;
+                if(e<10) n=put(out,cap,n,'0');
+                n=put_uint(out,cap,n,(unsigned long long)e);
+            }
+        }
+    }
+    out[n<cap ? n : cap-1]=0;
+    return n;
+}
+
+// ======= Benchmark =======
+// Samples may use x and y, which are preset; assignments in samples are kept.
+void expr_bench(const char* const* samples,int n,int reps,
+                unsigned long long (*now)(void),ExprBench* out){
+    static ExprEnv env;
+    static ExprProgram prog;
+    volatile double sink;
+    out->parses=out->parseTicks=out->evals=out->evalTicks=0;
+    out->failures=0;
+    expr_env_init(&env);
+    expr_set(&env,"x",1.5);
+    expr_set(&env,"y",-2);
+    for(int i=0;i<n;i++){
+        unsigned long long t0=now();
+        int err=0;
+        for(int r=0;r<reps;r++) err|=expr_compile(samples[i],&prog,&env);
+        unsigned long long t1=now();
+        out->parses += reps; out->parseTicks += t1-t0;
+        if(err){ out->failures++; continue; }
+        double v=0;
+        for(int r=0;r<reps;r++) err|=expr_run(&prog,&env,&v);
+        out->evals += reps; out->evalTicks += now()-t1;
+        sink=v; (void)sink;
+        if(err) out->failures++;
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef _EXPR_H_
+#define _EXPR_H_
+
+#include "bignum.h"
+
+// ======= Expression engine =======
+// Shared by the kernel calculator and the hosted calc tool, so it uses no libc
+// (strtod aside, and only in hosted builds) and no kernel headers. Source text is compiled once into bytecode for a small
+// stack VM; running a compiled program does no parsing. Integer-only programs
+// can also be run exactly over bignum.c's arbitrary-precision integers.
+//
+//   stmt    := name '=' expr | expr
+//   expr    := term (('+'|'-') term)*
+//   term    := unary (('*'|'/'|'%') unary)*
+//   unary   := ('-'|'+') unary | power
+//   power   := primary ('^' unary)?          (right associative, binds tighter than unary minus)
+//   primary := number | name | '(' expr ')'
+
+#define EXPR_MAX_CODE 128        // bytes of bytecode per program
+#define EXPR_MAX_CONSTS 32
+#define EXPR_MAX_STACK 32
+#define EXPR_MAX_VARS 16
+#define EXPR_NAME_MAX 12
+
+// Result codes
+#define EXPR_OK 0
+#define EXPR_ERR_SYNTAX 1
+#define EXPR_ERR_TOO_BIG 2       // out of code, constant or stack space
+#define EXPR_ERR_VARS 3          // variable table full
+#define EXPR_ERR_UNDEF 4         // variable read before it was assigned
+#define EXPR_ERR_DIV0 5
+#define EXPR_ERR_DOMAIN 6        // e.g. a fractional power
+#define EXPR_ERR_INEXACT 7       // expr_run_exact only: needs doubles instead
+#define EXPR_ERR_NOMEM 8
+
+// Results of expr_run_exact larger than this give EXPR_ERR_INEXACT (~79,000 digits)
+#define EXPR_EXACT_MAX_BITS (1u<<18)
+
+typedef struct {
+    char name[EXPR_NAME_MAX];
+    double value;
+    int set;
+} ExprVar;
+
+// Variables live outside programs so they persist from one line to the next
+typedef struct {
+    ExprVar vars[EXPR_MAX_VARS];
+    int count;
+} ExprEnv;
+
+// Bytecode: one opcode byte, followed by an operand byte for CONST (index into
+// consts), LOAD and STORE (variable slot). Exposed for the calc JIT (jit.c).
+enum {
+    EXPR_OP_END, EXPR_OP_CONST, EXPR_OP_LOAD, EXPR_OP_STORE,
+    EXPR_OP_ADD, EXPR_OP_SUB, EXPR_OP_MUL, EXPR_OP_DIV, EXPR_OP_MOD, EXPR_OP_POW, EXPR_OP_NEG
+};
+
+// Where a constant came from, so the exact evaluator can re-read its digits
+typedef struct {
+    unsigned short pos, len;
+    unsigned char neg;           // negated by unary minus folding
+} ExprConstSrc;
+
+typedef struct {
+    unsigned char code[EXPR_MAX_CODE];
+    double consts[EXPR_MAX_CONSTS];
+    ExprConstSrc constSrc[EXPR_MAX_CONSTS];
+    int ncode, nconsts;
+    int errPos;                  // offset in the source of a syntax error
+} ExprProgram;
+
+void expr_env_init(ExprEnv* env);
+void expr_set(ExprEnv* env,const char* name,double v);   // silently ignored when full
+
+// Variables named by the program are given slots in env while compiling
+int expr_compile(const char* src,ExprProgram* prog,ExprEnv* env);
+int expr_run(const ExprProgram* prog,ExprEnv* env,double* out);
+const char* expr_error(int code);
+
+// Runs a program compiled from src over arbitrary-precision integers. Gives
+// EXPR_ERR_INEXACT when the answer isn't an integer that can be computed exactly:
+// fractional or exponent constants, variables, inexact division, negative or
+// oversized powers. out must be bn_init'ed; the allocator is bignum's.
+int expr_run_exact(const ExprProgram* prog,const char* src,BigInt* out);
+
+// Up to 10 significant digits, like printf("%.10g"); returns the length
+int expr_format(double v,char* out,int cap);
+
+// Benchmark core: parses and then evaluates each sample 'reps' times using the
+// caller's clock, which keeps timing and printing out of this file
+typedef struct {
+    unsigned long long parses, parseTicks;
+    unsigned long long evals, evalTicks;
+    int failures;
+} ExprBench;
+
+void expr_bench(const char* const* samples,int n,int reps,
+                unsigned long long (*now)(void),ExprBench* out);
+
+#endif
@@ -0,0 +1,34 @@
+#include "fb.h"
+#include "paging.h"
+#include "kprintf.h"
+
+static Surface g_fb;
+
+Surface* fb_init(multiboot_info_t* mbi){
+    if(!mbi || !(mbi->flags & MULTIBOOT_INFO_FRAMEBUFFER)) return 0;
+    if(mbi->framebuffer_type==MULTIBOOT_FRAMEBUFFER_TEXT) return 0;
+    if(mbi->framebuffer_type!=MULTIBOOT_FRAMEBUFFER_RGB || mbi->framebuffer_bpp!=32 ||
+       mbi->red_mask_size!=8 || mbi->green_mask_size!=8 || mbi->blue_mask_size!=8){
+        kprintf("fb: %ux%u, %u bpp type %u is not 32-bit RGB, staying in text mode\n",
+                mbi->framebuffer_width, mbi->framebuffer_height, mbi->framebuffer_bpp, mbi->framebuffer_type);
+        return 0;
+    }
+    UINT64 addr = mbi->framebuffer_addr;
+    UINT32 size = mbi->framebuffer_pitch*mbi->framebuffer_height;
+    if(addr+size > ((UINT64)1<<32)){
+        kprintf("fb: frame buffer above 4 GiB, staying in text mode\n");
+        return 0;
+    }
+    // One WC mapping: stores are merged into full-line bursts instead of going
+    // out one by one as they would uncached
+    void* p = paging_map_mmio((UINT32)addr,size,PAGE_WC);
+    if(!p){
+        kprintf("fb: cannot map %u KiB at %x\n", size/1024, (UINT32)addr);
+        return 0;
+    }
+    gfx_surface(&g_fb,p,(int)mbi->framebuffer_width,(int)mbi->framebuffer_height,(int)mbi->framebuffer_pitch,
+                mbi->red_field_position,mbi->green_field_position,mbi->blue_field_position);
+    kprintf("fb: %ux%u 32 bpp at %x, pitch %u, write-combining\n",
+            mbi->framebuffer_width, mbi->framebuffer_height, (UINT32)addr, mbi->framebuffer_pitch);
+    return &g_fb;
+}
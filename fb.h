@@ -0,0 +1,15 @@
+#ifndef _FB_H_
+#define _FB_H_
+
+#include "multiboot.h"
+#include "gfx.h"
+
+// ======= Linear frame buffer =======
+// The VBE mode GRUB set from the Multiboot header's video request (QEMU's std
+// VGA offers it). Only 32-bit RGB modes are used; anything else, and text
+// mode, leaves the kernel on the VGA text page.
+
+// Needs paging_init: maps the frame buffer write-combining. 0 if none is usable
+Surface* fb_init(multiboot_info_t* mbi);
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _FONT_H_
+#define _FONT_H_
+
+#include "kernel.h"
+
+// ======= Bitmap font =======
+// 8x8 glyphs for printable ASCII, one byte per row, bit 0 the leftmost pixel
+#define FONT_FIRST 32
+#define FONT_LAST 126
+
+extern const UINT8 g_font8x8[FONT_LAST-FONT_FIRST+1][8];
+
+#endif
@@ -0,0 +1,194 @@
+#include "gfx.h"
+#include "font.h"
+#include "heap.h"
+#include "kstring.h"
+#include "clock.h"
+#include "kprintf.h"
+
+#define GLYPHS (FONT_LAST-FONT_FIRST+2)     // slot 0 stands in for anything outside the font
+#define GLYPH_PIXELS (GLYPH_W*GLYPH_H)
+#define GLYPH_SETS 8                        // attributes kept rendered at once
+#define CELL_BATCH 32
+
+// The 16 text-mode colours as 0xRRGGBB
+static const UINT32 g_palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+// ======= Surfaces =======
+void gfx_surface(Surface* s,void* pixels,int width,int height,int pitchBytes,
+                 int rshift,int gshift,int bshift){
+    s->pixels = (UINT32*)pixels;
+    s->width = width;
+    s->height = height;
+    s->pitch = pitchBytes/4;
+    s->rshift = (UINT8)rshift;
+    s->gshift = (UINT8)gshift;
+    s->bshift = (UINT8)bshift;
+}
+
+UINT32 gfx_rgb(const Surface* s,UINT32 rgb){
+    return ((rgb>>16)&0xFF)<<s->rshift | ((rgb>>8)&0xFF)<<s->gshift | (rgb&0xFF)<<s->bshift;
+}
+
+// Trim a rectangle to the surface; 0 if nothing is left
+static int clip(const Surface* s,int* x,int* y,int* w,int* h){
+    if(*x<0){ *w += *x; *x = 0; }
+    if(*y<0){ *h += *y; *y = 0; }
+    if(*w > s->width-*x) *w = s->width-*x;
+    if(*h > s->height-*y) *h = s->height-*y;
+    return *w>0 && *h>0;
+}
+
+// Rows are written front to back and never read, which is what a
+// write-combining frame buffer wants
+void gfx_fill(Surface* s,int x,int y,int w,int h,UINT32 pixel){
+    if(!clip(s,&x,&y,&w,&h)) return;
+    UINT32* row = s->pixels + y*s->pitch + x;
+    for(int r=0;r<h;r++,row+=s->pitch) kmemset32(row,pixel,(UINT32)w);
+}
+
+void gfx_blit(Surface* dst,int dx,int dy,const Surface* src,int sx,int sy,int w,int h){
+    // clip against the source, then the destination, moving the other corner along
+    if(sx<0){ w += sx; dx -= sx; sx = 0; }
+    if(sy<0){ h += sy; dy -= sy; sy = 0; }
+    if(w > src->width-sx) w = src->width-sx;
+    if(h > src->height-sy) h = src->height-sy;
+    int x = dx, y = dy;
+    if(!clip(dst,&x,&y,&w,&h)) return;
+    sx += x-dx; sy += y-dy;
+    const UINT32* from = src->pixels + sy*src->pitch + sx;
+    UINT32* to = dst->pixels + y*dst->pitch + x;
+    int step = 1;
+    if(src==dst && y>sy){               // overlapping move down: bottom row first
+        from += (h-1)*src->pitch;
+        to += (h-1)*dst->pitch;
+        step = -1;
+    }
+    for(int r=0;r<h;r++,from+=step*src->pitch,to+=step*dst->pitch)
+        kmemmove(to,from,(UINT32)w*4);
+}
+
+// ======= Glyph cache =======
+// One set holds every glyph pre-rendered in one attribute's colours and one
+// pixel format. Sets are replaced least recently used first, but never while
+// the batch being drawn still points into them.
+typedef struct {
+    UINT32 key;             // attribute and pixel format
+    UINT32 used;            // g_stamp of the last lookup
+    UINT32* pix;            // GLYPHS x GLYPH_H x GLYPH_W
+} GlyphSet;
+
+static GlyphSet g_sets[GLYPH_SETS];
+static UINT32 g_stamp = 0;
+static UINT32 g_renders = 0;
+
+static int glyph_index(UINT8 ch){
+    if(ch==0) return ' '-FONT_FIRST+1;
+    if(ch<FONT_FIRST || ch>FONT_LAST) return 0;
+    return ch-FONT_FIRST+1;
+}
+
+// Font rows are 8 pixels high, so each is drawn twice
+static void render_glyph(UINT32* p,int glyph,UINT32 fg,UINT32 bg){
+    const UINT8* bits = g_font8x8[glyph ? glyph-1 : '?'-FONT_FIRST];
+    for(int r=0;r<GLYPH_H;r++){
+        UINT8 b = bits[r*8/GLYPH_H];
+        for(int x=0;x<GLYPH_W;x++) *p++ = (b>>x)&1 ? fg : bg;
+    }
+}
+
+// The glyphs for attr; 0 when out of memory or when every set is in use by
+// the current batch
+static const UINT32* glyph_set(const Surface* s,UINT8 attr){
+    UINT32 key = attr | (UINT32)s->rshift<<8 | (UINT32)s->gshift<<16 | (UINT32)s->bshift<<24;
+    GlyphSet* victim = &g_sets[0];
+    for(int i=0;i<GLYPH_SETS;i++){
+        GlyphSet* g = &g_sets[i];
+        if(g->pix && g->key==key){ g->used = g_stamp; return g->pix; }
+        if(g->used < victim->used) victim = g;
+    }
+    if(victim->pix && victim->used==g_stamp) return 0;
+    if(!victim->pix) victim->pix = (UINT32*)kmalloc(GLYPHS*GLYPH_PIXELS*sizeof(UINT32));
+    if(!victim->pix) return 0;
+    UINT32 fg = gfx_rgb(s,g_palette[attr&15]), bg = gfx_rgb(s,g_palette[attr>>4]);
+    for(int c=0;c<GLYPHS;c++) render_glyph(victim->pix+c*GLYPH_PIXELS,c,fg,bg);
+    victim->key = key;
+    victim->used = g_stamp;
+    g_renders++;
+    return victim->pix;
+}
+
+// Without a cached set: straight from the font bitmap
+static void draw_uncached(Surface* s,int x,int y,UINT16 cell){
+    UINT32 glyph[GLYPH_PIXELS];
+    UINT8 attr = (UINT8)(cell>>8);
+    render_glyph(glyph,glyph_index((UINT8)cell),gfx_rgb(s,g_palette[attr&15]),gfx_rgb(s,g_palette[attr>>4]));
+    for(int r=0;r<GLYPH_H;r++)
+        for(int i=0;i<GLYPH_W;i++) s->pixels[(y+r)*s->pitch+x+i] = glyph[r*GLYPH_W+i];
+}
+
+void gfx_cells(Surface* s,int x,int y,const UINT16* cells,int count){
+    if(x<0 || y<0 || y+GLYPH_H>s->height) return;
+    if(count > (s->width-x)/GLYPH_W) count = (s->width-x)/GLYPH_W;
+    const UINT32* glyph[CELL_BATCH];
+    while(count>0){
+        // Look a batch up first, then write it one scanline at a time: the
+        // frame buffer sees long sequential runs of 32-bit stores
+        g_stamp++;
+        int n = 0;
+        while(n<count && n<CELL_BATCH){
+            const UINT32* set = glyph_set(s,(UINT8)(cells[n]>>8));
+            if(!set) break;
+            glyph[n] = set + glyph_index((UINT8)cells[n])*GLYPH_PIXELS;
+            n++;
+        }
+        if(!n){
+            draw_uncached(s,x,y,cells[0]);
+            n = 1;
+        }else{
+            for(int r=0;r<GLYPH_H;r++){
+                UINT32* d = s->pixels + (y+r)*s->pitch + x;
+                for(int i=0;i<n;i++,d+=GLYPH_W){
+                    const UINT32* g = glyph[i] + r*GLYPH_W;
+                    d[0]=g[0]; d[1]=g[1]; d[2]=g[2]; d[3]=g[3];
+                    d[4]=g[4]; d[5]=g[5]; d[6]=g[6]; d[7]=g[7];
+                }
+            }
+        }
+        cells += n; count -= n; x += n*GLYPH_W;
+    }
+}
+
+// ======= Benchmark =======
+#define BENCH_FRAMES 16
+
+void gfx_benchmark(Surface* s){
+    int cols = s->width/GLYPH_W, rows = s->height/GLYPH_H;
+    UINT16* line = (UINT16*)kmalloc(cols*sizeof(UINT16));
+    UINT32* copy = (UINT32*)kmalloc((UINT32)s->width*s->height*4);
+    if(!line){ kfree(copy); return; }
+    for(int c=0;c<cols;c++) line[c] = (UINT16)(('A'+c%26) | 0x0F00);
+
+    UINT64 t0 = rdtsc();
+    for(int f=0;f<BENCH_FRAMES;f++) gfx_fill(s,0,0,s->width,s->height,gfx_rgb(s,g_palette[f&15]));
+    UINT64 t1 = rdtsc();
+    for(int f=0;f<BENCH_FRAMES;f++)
+        for(int r=0;r<rows;r++) gfx_cells(s,0,r*GLYPH_H,line,cols);
+    UINT64 t2 = rdtsc();
+    UINT64 blit = 0;
+    if(copy){
+        Surface back;
+        gfx_surface(&back,copy,s->width,s->height,s->width*4,s->rshift,s->gshift,s->bshift);
+        gfx_fill(&back,0,0,back.width,back.height,gfx_rgb(s,0x0000AA));
+        UINT64 t3 = rdtsc();
+        for(int f=0;f<BENCH_FRAMES;f++) gfx_blit(s,0,0,&back,0,0,back.width,back.height);
+        blit = per_second(BENCH_FRAMES,rdtsc()-t3);
+    }
+    kprintf("gfx bench (%dx%d): fill %llu fps, %dx%d text %llu fps, blit %llu fps, %u glyph sets rendered\n",
+            s->width, s->height, per_second(BENCH_FRAMES,t1-t0), cols, rows,
+            per_second(BENCH_FRAMES,t2-t1), blit, g_renders);
+    kfree(copy);
+    kfree(line);
+}
@@ -0,0 +1,39 @@
+#ifndef _GFX_H_
+#define _GFX_H_
+
+#include "kernel.h"
+
+// ======= 2D drawing on 32-bit surfaces =======
+// A surface is a block of 32-bit pixels: the linear frame buffer or plain
+// memory. Coordinates are clipped to the surface. Pixels are in the surface's
+// own format; gfx_rgb() converts from 0xRRGGBB.
+typedef struct {
+    UINT32* pixels;
+    int width, height;
+    int pitch;                  // pixels from one row to the next
+    UINT8 rshift, gshift, bshift;
+} Surface;
+
+void gfx_surface(Surface* s,void* pixels,int width,int height,int pitchBytes,
+                 int rshift,int gshift,int bshift);
+UINT32 gfx_rgb(const Surface* s,UINT32 rgb);
+
+void gfx_fill(Surface* s,int x,int y,int w,int h,UINT32 pixel);
+// Copy a w x h block; src and dst may be the same surface
+void gfx_blit(Surface* dst,int dx,int dy,const Surface* src,int sx,int sy,int w,int h);
+
+// ======= Text cells =======
+// VGA text cells (character in the low byte, attribute in the high byte) drawn
+// as GLYPH_W x GLYPH_H glyphs in the 16 VGA colours. Glyphs are pre-rendered
+// per attribute into a small cache, so a cell is GLYPH_H row copies.
+#define GLYPH_W 8
+#define GLYPH_H 16
+
+// count cells of one text row, left to right from pixel x,y
+void gfx_cells(Surface* s,int x,int y,const UINT16* cells,int count);
+
+// Full-screen redraw rate on s (the frame buffer, or a heap surface when
+// there is none), via kprintf
+void gfx_benchmark(Surface* s);
+
+#endif
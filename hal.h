@@ -0,0 +1,28 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include "kernel.h"
+
+// ======= Hardware abstraction for the portable modules =======
+// ui.c, the apps (editor.c, calculator.c, wordgame.c), keymap.c and the
+// engines under them (memfs, textbuf, expr, bignum, bench) reach the machine
+// only through this file and a few calls declared elsewhere:
+//   screen    hal_text_page()                      (below), or a frame
+//             buffer passed to ui_set_surface()    (ui.h, gfx.h)
+//   keyboard  getkey, getkey_timeout, kbd_shift,    (keyboard.h)
+//             kbd_feed_ascii
+//   time      rdtsc, tsc_hz, cycles_to_ns,          (clock.h)
+//             per_second, now_ns
+//   memory    kmalloc and friends, arenas           (heap.h)
+//   log       serial_write                          (serial.h, via kprintf)
+//   disk      diskfs_mounted, diskfs_lock/unlock,   (diskfs.h)
+//             diskfs_request_sync
+// Port I/O and interrupt masking stay in the drivers. The kernel backs these
+// with VGA memory, the PS/2 driver and the TSC; the hosted build (-DHOSTED,
+// host.c) with an array, a key script and the host's clock and malloc.
+
+// The 80x25 text page vga_flush() copies changed cells to (character in the
+// low byte, attribute in the high byte)
+volatile UINT16* hal_text_page(void);
+
+#endif
@@ -0,0 +1,315 @@
+#include "heap.h"
+#include "pmm.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "interrupts.h"
+
+#define SLAB_MAGIC 0x51AB51ABu
+#define BIG_MAGIC  0xB16B10C5u
+#define NUM_CLASSES 7            // 16, 32, ... 1024
+
+typedef struct Slab Slab;
+typedef struct Cache Cache;
+
+// Header at the start of every slab page; objects follow it
+struct Slab {
+    UINT32 magic;
+    Cache* cache;
+    Slab* next;
+    Slab* prev;
+    void* freelist;
+    UINT16 inuse;
+    UINT16 total;
+};
+
+// Header at the start of a large allocation's first page
+typedef struct {
+    UINT32 magic;
+    UINT32 pages;
+    UINT32 pad[2];               // keep the payload 16-byte aligned
+} BigHeader;
+
+struct Cache {
+    UINT32 size;
+    Slab* partial;               // slabs with at least one free object
+    Slab* full;
+    Slab* empty;                 // at most one spare, the rest go back to the PMM
+    UINT32 slabs;
+    UINT32 inuse;
+    UINT32 allocs;
+    UINT32 frees;
+};
+
+static Cache g_caches[NUM_CLASSES];
+
+static struct {
+    UINT64 allocCycles, freeCycles;
+    UINT32 allocMax, freeMax;
+    UINT32 allocs, frees;
+    UINT64 requested, granted;   // cumulative, for internal fragmentation
+    UINT32 bigPages;             // pages held by live large allocations
+    UINT32 bigLive;
+} g_stats;
+
+static int class_index(UINT32 size){
+    int c=0; UINT32 s=16;
+    while(s<size){ s<<=1; c++; }
+    return c;
+}
+
+static void list_remove(Slab** head,Slab* s){
+    if(s->prev) s->prev->next=s->next; else *head=s->next;
+    if(s->next) s->next->prev=s->prev;
+    s->next=s->prev=0;
+}
+
+static void list_push(Slab** head,Slab* s){
+    s->prev=0; s->next=*head;
+    if(*head) (*head)->prev=s;
+    *head=s;
+}
+
+void heap_init(void){
+    for(int i=0;i<NUM_CLASSES;i++){
+        g_caches[i].size = 16u<<i;
+        g_caches[i].partial = g_caches[i].full = g_caches[i].empty = 0;
+        g_caches[i].slabs = g_caches[i].inuse = g_caches[i].allocs = g_caches[i].frees = 0;
+    }
+}
+
+static Slab* slab_new(Cache* c){
+    UINT32 page = pmm_alloc_page();
+    if(!page) return 0;
+    Slab* s = (Slab*)(UINTPTR)page;
+    s->magic = SLAB_MAGIC;
+    s->cache = c;
+    s->next = s->prev = 0;
+    s->inuse = 0;
+    // first object starts at the next multiple of the object size (max 64) past the header
+    UINT32 align = c->size<64 ? c->size : 64;
+    UINT32 first = (sizeof(Slab)+align-1) & ~(align-1);
+    s->total = (UINT16)((PAGE_SIZE-first)/c->size);
+    s->freelist = 0;
+    for(int i=s->total-1;i>=0;i--){
+        void** obj = (void**)(UINTPTR)(page+first+i*c->size);
+        *obj = s->freelist;
+        s->freelist = obj;
+    }
+    c->slabs++;
+    return s;
+}
+
+static void* cache_alloc(Cache* c){
+    Slab* s = c->partial;
+    if(!s){
+        if(c->empty){ s=c->empty; list_remove(&c->empty,s); }
+        else if(!(s=slab_new(c))) return 0;
+        list_push(&c->partial,s);
+    }
+    void** obj = (void**)s->freelist;
+    s->freelist = *obj;
+    s->inuse++;
+    if(s->inuse==s->total){ list_remove(&c->partial,s); list_push(&c->full,s); }
+    c->inuse++;
+    c->allocs++;
+    return obj;
+}
+
+static void cache_free(Slab* s,void* p){
+    Cache* c = s->cache;
+    if(s->inuse==s->total){ list_remove(&c->full,s); list_push(&c->partial,s); }
+    *(void**)p = s->freelist;
+    s->freelist = p;
+    s->inuse--;
+    c->inuse--;
+    c->frees++;
+    if(s->inuse==0){
+        list_remove(&c->partial,s);
+        if(!c->empty) list_push(&c->empty,s);
+        else { s->magic=0; pmm_free_page((UINTPTR)s); c->slabs--; }
+    }
+}
+
+static void* big_alloc(UINT32 size){
+    UINT32 pages = (size+sizeof(BigHeader)+PAGE_SIZE-1)/PAGE_SIZE;
+    UINT32 base = pmm_alloc_pages(pages);
+    if(!base) return 0;
+    BigHeader* h = (BigHeader*)(UINTPTR)base;
+    h->magic = BIG_MAGIC;
+    h->pages = pages;
+    g_stats.bigPages += pages;
+    g_stats.bigLive++;
+    return h+1;
+}
+
+// kmalloc and kfree run with interrupts off: threads are preempted at any
+// point, and the slab lists and statistics are shared by all of them
+void* kmalloc(UINT32 size){
+    if(size==0) size=1;
+    UINT32 flags = irq_save();
+    UINT64 t0 = rdtsc();
+    void* p;
+    UINT32 granted;
+    if(size<=HEAP_MAX_SMALL){
+        Cache* c = &g_caches[class_index(size)];
+        p = cache_alloc(c);
+        granted = c->size;
+    }else{
+        p = big_alloc(size);
+        granted = ((size+sizeof(BigHeader)+PAGE_SIZE-1)/PAGE_SIZE)*PAGE_SIZE;
+    }
+    UINT32 dt = (UINT32)(rdtsc()-t0);
+    if(p){
+        g_stats.allocs++;
+        g_stats.allocCycles += dt;
+        if(dt>g_stats.allocMax) g_stats.allocMax=dt;
+        g_stats.requested += size;
+        g_stats.granted += granted;
+    }
+    irq_restore(flags);
+    return p;
+}
+
+void* kzalloc(UINT32 size){
+    UINT8* p = (UINT8*)kmalloc(size);
+    if(p) kmemset(p,0,size);
+    return p;
+}
+
+UINT32 ksize(void* p){
+    if(!p) return 0;
+    UINTPTR base = (UINTPTR)p & ~(UINTPTR)(PAGE_SIZE-1);
+    if(((Slab*)base)->magic==SLAB_MAGIC) return ((Slab*)base)->cache->size;
+    BigHeader* h = (BigHeader*)base;
+    if(h->magic==BIG_MAGIC && (void*)(h+1)==p) return h->pages*PAGE_SIZE-sizeof(BigHeader);
+    return 0;
+}
+
+void kfree(void* p){
+    if(!p) return;
+    UINT32 flags = irq_save();
+    UINT64 t0 = rdtsc();
+    UINTPTR base = (UINTPTR)p & ~(UINTPTR)(PAGE_SIZE-1);
+    Slab* s = (Slab*)base;
+    BigHeader* h = (BigHeader*)base;
+    if(s->magic==SLAB_MAGIC){
+        cache_free(s,p);
+    }else if(h->magic==BIG_MAGIC && (void*)(h+1)==p){
+        UINT32 pages = h->pages;
+        h->magic = 0;
+        g_stats.bigPages -= pages;
+        g_stats.bigLive--;
+        pmm_free_pages(base,pages);
+    }else{
+        irq_restore(flags);
+        kprintf("kfree: bad pointer %p\n", p);
+        return;
+    }
+    UINT32 dt = (UINT32)(rdtsc()-t0);
+    g_stats.frees++;
+    g_stats.freeCycles += dt;
+    if(dt>g_stats.freeMax) g_stats.freeMax=dt;
+    irq_restore(flags);
+}
+
+void* krealloc(void* p,UINT32 size){
+    if(!p) return kmalloc(size);
+    UINT32 old = ksize(p);
+    if(size<=old) return p;
+    UINT8* q = (UINT8*)kmalloc(size);
+    if(!q) return 0;
+    kmemcpy(q,p,old);
+    kfree(p);
+    return q;
+}
+
+// ======= Arenas =======
+#define ARENA_CHUNK_PAGES 4
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    UINT32 pages;
+    UINT32 used;                 // bytes used including this header
+    UINT32 pad;
+};
+
+void arena_init(Arena* a){
+    a->head = 0;
+    a->bytes = 0;
+    a->chunks = 0;
+}
+
+void* arena_alloc(Arena* a,UINT32 size){
+    size = (size+7) & ~7u;
+    ArenaChunk* c = a->head;
+    if(!c || c->used+size > c->pages*PAGE_SIZE){
+        UINT32 pages = (size+sizeof(ArenaChunk)+PAGE_SIZE-1)/PAGE_SIZE;
+        if(pages<ARENA_CHUNK_PAGES) pages=ARENA_CHUNK_PAGES;
+        UINT32 base = pmm_alloc_pages(pages);
+        if(!base) return 0;
+        c = (ArenaChunk*)(UINTPTR)base;
+        c->next = a->head;
+        c->pages = pages;
+        c->used = sizeof(ArenaChunk);
+        a->head = c;
+        a->chunks++;
+    }
+    void* p = (UINT8*)c + c->used;
+    c->used += size;
+    a->bytes += size;
+    return p;
+}
+
+void arena_release(Arena* a){
+    ArenaChunk* c = a->head;
+    while(c){
+        ArenaChunk* next = c->next;
+        pmm_free_pages((UINTPTR)c,c->pages);
+        c = next;
+    }
+    arena_init(a);
+}
+
+// ======= Statistics =======
+void heap_report(void){
+    UINT32 allocAvg = g_stats.allocs ? (UINT32)(g_stats.allocCycles/g_stats.allocs) : 0;
+    UINT32 freeAvg = g_stats.frees ? (UINT32)(g_stats.freeCycles/g_stats.frees) : 0;
+    kprintf("Heap: %u allocs, %u frees; latency avg/max cycles: alloc %u/%u, free %u/%u\n",
+            g_stats.allocs, g_stats.frees, allocAvg, g_stats.allocMax, freeAvg, g_stats.freeMax);
+    UINT32 slabBytes=0, liveBytes=0;
+    for(int i=0;i<NUM_CLASSES;i++){
+        Cache* c = &g_caches[i];
+        if(!c->slabs) continue;
+        UINT32 util = c->inuse*c->size*100/(c->slabs*PAGE_SIZE);
+        kprintf("  slab %4u: %u slabs, %u live, %u%% of slab memory used\n",
+                c->size, c->slabs, c->inuse, util);
+        slabBytes += c->slabs*PAGE_SIZE;
+        liveBytes += c->inuse*c->size;
+    }
+    UINT32 internal = g_stats.granted ? (UINT32)((g_stats.granted-g_stats.requested)*100/g_stats.granted) : 0;
+    UINT32 external = slabBytes ? (slabBytes-liveBytes)*100/slabBytes : 0;
+    kprintf("  large: %u live, %u pages; fragmentation: internal %u%%, slab free space %u%%\n",
+            g_stats.bigLive, g_stats.bigPages, internal, external);
+}
+
+#define BENCH_OBJS 2048
+
+void heap_benchmark(void){
+    static void* objs[BENCH_OBJS];
+    // mixed small sizes, freed in an interleaved order to exercise partial slabs
+    UINT64 t0 = rdtsc();
+    for(int i=0;i<BENCH_OBJS;i++) objs[i] = kmalloc(8 + (i*37)%1000);
+    UINT64 t1 = rdtsc();
+    for(int i=0;i<BENCH_OBJS;i+=2) kfree(objs[i]);
+    for(int i=1;i<BENCH_OBJS;i+=2) kfree(objs[i]);
+    UINT64 t2 = rdtsc();
+    Arena a; arena_init(&a);
+    UINT64 t3 = rdtsc();
+    for(int i=0;i<BENCH_OBJS;i++) arena_alloc(&a,8 + (i*37)%1000);
+    arena_release(&a);
+    UINT64 t4 = rdtsc();
+    kprintf("Heap bench (%u objs): kmalloc %llu/s, kfree %llu/s, arena alloc+release %llu/s\n",
+            BENCH_OBJS, per_second(BENCH_OBJS,t1-t0), per_second(BENCH_OBJS,t2-t1),
+            per_second(BENCH_OBJS,t4-t3));
+}
@@ -0,0 +1,38 @@
+#ifndef _HEAP_H_
+#define _HEAP_H_
+
+#include "kernel.h"
+
+// ======= Kernel heap =======
+// Requests up to HEAP_MAX_SMALL bytes come from per-size-class slab caches
+// (one page per slab); larger ones get whole contiguous pages from the PMM.
+#define HEAP_MAX_SMALL 1024
+
+void heap_init(void);
+void* kmalloc(UINT32 size);
+void* kzalloc(UINT32 size);
+void* krealloc(void* p,UINT32 size);
+void kfree(void* p);
+
+// Usable size of a live allocation (the size class, not the requested size)
+UINT32 ksize(void* p);
+
+// ======= Region arenas =======
+// Bump allocation from a chain of page runs; everything is released at once.
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+    ArenaChunk* head;
+    UINT32 bytes;        // handed out since the last release
+    UINT32 chunks;
+} Arena;
+
+void arena_init(Arena* a);
+void* arena_alloc(Arena* a,UINT32 size);     // 8-byte aligned, never freed individually
+void arena_release(Arena* a);
+
+// Latency and fragmentation statistics, written with kprintf (log + serial)
+void heap_report(void);
+void heap_benchmark(void);
+
+#endif
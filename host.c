@@ -0,0 +1,435 @@
+/*
+ * Hosted build: the kernel's portable modules (ui.c, the apps, memfs,
+ * textbuf, expr, bignum, the benchmark suite) linked into a Linux program,
+ * so they can be run under perf, valgrind or a debugger. This file is the
+ * hosted side of hal.h: an array stands in for VGA text memory, the keyboard
+ * replays a script of terminal input, and the heap, clock and log come from
+ * libc.
+ *
+ *   ./hosted bench                  boot-time benchmarks, then the BENCH suite
+ *   ./hosted APP [KEYS | -]         run calc, editor, words or log, print the screen
+ *
+ * KEYS is what a terminal would send on the serial console: text, \r for
+ * Enter, \x7f for Backspace and VT100 sequences (\e[A for Up, \eOQ for F2,
+ * \e[3~ for Delete; see keymap.c). '-' reads them from stdin. Once the script
+ * is used up every key is ESC, so apps return to where the menu would be; the
+ * final screen goes to stdout and the kernel log to stderr.
+ *
+ * With INITRD set to a ustar archive, its files are attached to memfs first,
+ * as the kernel does with its boot module (e.g. words.txt for the word game).
+ * With FRAME set to a file name, the app draws on a 1024x768 surface as on the
+ * kernel's frame buffer, and the final frame is written there as a PPM image
+ * instead of printing the text screen.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+#include "hal.h"
+#include "ui.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "clock.h"
+#include "heap.h"
+#include "kprintf.h"
+#include "kstring.h"
+#include "serial.h"
+#include "diskfs.h"
+#include "memfs.h"
+#include "initrd.h"
+#include "gfx.h"
+#include "textbuf.h"
+#include "bignum.h"
+#include "bench.h"
+#include "editor.h"
+#include "calculator.h"
+#include "wordgame.h"
+
+#define SCRIPT_END_KEYS 64      /* ESCs handed out after the script before giving up */
+
+/* ======= Screen ======= */
+static UINT16 g_page[VGA_WIDTH * VGA_HEIGHT];
+
+volatile UINT16 *hal_text_page(void) {
+	return g_page;
+}
+
+static void print_screen(void) {
+	for (int r = 0; r < VGA_HEIGHT; r++) {
+		char line[VGA_WIDTH + 1];
+		int n = 0;
+		for (int c = 0; c < VGA_WIDTH; c++) {
+			char ch = (char)(g_page[r * VGA_WIDTH + c] & 0xFF);
+			line[c] = ch ? ch : ' ';
+			if (line[c] != ' ') {
+				n = c + 1;
+			}
+		}
+		line[n] = '\0';
+		printf("%s\n", line);
+	}
+}
+
+#define FRAME_W 1024
+#define FRAME_H 768
+
+static Surface g_frame;
+
+static int write_frame(const char *path) {
+	FILE *out = fopen(path, "wb");
+	if (!out) {
+		return 0;
+	}
+	fprintf(out, "P6\n%d %d\n255\n", g_frame.width, g_frame.height);
+	for (int y = 0; y < g_frame.height; y++) {
+		for (int x = 0; x < g_frame.width; x++) {
+			UINT32 p = g_frame.pixels[y * g_frame.pitch + x];
+			fputc((int)(p >> 16 & 0xFF), out);
+			fputc((int)(p >> 8 & 0xFF), out);
+			fputc((int)(p & 0xFF), out);
+		}
+	}
+	return fclose(out) == 0;
+}
+
+/* ======= Scripted keyboard ======= */
+/* Script bytes are translated as the serial console does (kbd_feed_ascii in
+   keyboard.c), except that a lone ESC is resolved by the next byte or the end
+   of the script instead of a timer. */
+static const char *g_script = "";
+static size_t g_scriptLen, g_scriptPos;
+static UINT8 g_queue[16];
+static int g_qHead, g_qTail;
+static int g_escState, g_escParam;
+static int g_shift;
+static int g_endKeys;
+
+static void push(UINT8 sc) {
+	g_queue[g_qHead++ & 15] = sc;
+}
+
+void kbd_feed_ascii(char c) {
+	if (g_escState == 1) {
+		if (c == '[') {
+			g_escState = 2;
+			g_escParam = 0;
+			return;
+		}
+		if (c == 'O') {
+			g_escState = 3;
+			return;
+		}
+		g_escState = 0;
+		push(0x01);
+	} else if (g_escState >= 2) {
+		if (g_escState == 2 && c >= '0' && c <= '9') {
+			g_escParam = g_escParam * 10 + (c - '0');
+			return;
+		}
+		if (g_escState == 2 && c == ';') {
+			return;
+		}
+		UINT8 sc = keymap_from_vt100(c, g_escParam);
+		g_escState = 0;
+		if (sc) {
+			push(sc);
+		}
+		return;
+	}
+	if (c == 0x1B) {
+		g_escState = 1;
+		return;
+	}
+	UINT8 sc[3];
+	int n = keymap_from_ascii(c, sc);
+	for (int i = 0; i < n; i++) {
+		push(sc[i]);
+	}
+}
+
+/* Next raw scancode; 0 once the script is used up */
+static int next_raw(UINT8 *sc) {
+	while (g_qTail == g_qHead) {
+		if (g_scriptPos < g_scriptLen) {
+			kbd_feed_ascii(g_script[g_scriptPos++]);
+		} else if (g_escState == 1) {
+			g_escState = 0;
+			push(0x01);
+		} else {
+			return 0;
+		}
+	}
+	*sc = g_queue[g_qTail++ & 15];
+	return 1;
+}
+
+int getkey_timeout(UINT32 ms, UINT8 *out) {
+	UINT8 sc;
+	for (;;) {
+		if (!next_raw(&sc)) {
+			if (ms != KBD_WAIT_FOREVER) {
+				return 0;
+			}
+			if (++g_endKeys > SCRIPT_END_KEYS) {
+				fprintf(stderr, "hosted: the app did not return after %d ESC keys\n", SCRIPT_END_KEYS);
+				print_screen();
+				exit(2);
+			}
+			*out = 0x01;
+			return 1;
+		}
+		if (sc == 0x2A || sc == 0x36) {
+			g_shift = 1;
+			continue;
+		}
+		if (sc == 0xAA || sc == 0xB6) {
+			g_shift = 0;
+			continue;
+		}
+		if (sc == 0xE0 || (sc & 0x80)) {
+			continue;
+		}
+		*out = sc;
+		return 1;
+	}
+}
+
+UINT8 getkey(void) {
+	UINT8 sc;
+	getkey_timeout(KBD_WAIT_FOREVER, &sc);
+	return sc;
+}
+
+int kbd_shift(void) {
+	return g_shift;
+}
+
+/* ======= Clock ======= */
+static UINT64 g_tscHz, g_tscBase;
+
+static UINT64 mono_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (UINT64)ts.tv_sec * 1000000000ULL + (UINT64)ts.tv_nsec;
+}
+
+/* The TSC against CLOCK_MONOTONIC, as clock_init() does against the PIT */
+static void clock_calibrate(void) {
+	UINT64 t0 = mono_ns(), c0 = rdtsc();
+	while (mono_ns() - t0 < 20000000ULL) {
+	}
+	UINT64 t1 = mono_ns(), c1 = rdtsc();
+	g_tscHz = (UINT64)((unsigned __int128)(c1 - c0) * 1000000000ULL / (t1 - t0));
+	g_tscBase = c0;
+}
+
+UINT64 tsc_hz(void) {
+	return g_tscHz;
+}
+
+UINT64 cycles_to_ns(UINT64 cycles) {
+	return g_tscHz ? (UINT64)((unsigned __int128)cycles * 1000000000ULL / g_tscHz) : 0;
+}
+
+UINT64 per_second(UINT64 count, UINT64 cycles) {
+	return cycles ? (UINT64)((unsigned __int128)count * g_tscHz / cycles) : 0;
+}
+
+UINT64 now_ns(void) {
+	return cycles_to_ns(rdtsc() - g_tscBase);
+}
+
+/* ======= Heap ======= */
+/* Straight to malloc, so valgrind and ASan see every block */
+void *kmalloc(UINT32 size) {
+	return malloc(size);
+}
+
+void *kzalloc(UINT32 size) {
+	return calloc(1, size);
+}
+
+void *krealloc(void *p, UINT32 size) {
+	return realloc(p, size);
+}
+
+void kfree(void *p) {
+	free(p);
+}
+
+UINT32 ksize(void *p) {
+	return p ? (UINT32)malloc_usable_size(p) : 0;
+}
+
+/* One malloc per allocation, chained through a header */
+struct ArenaChunk {
+	ArenaChunk *next;
+	UINT64 pad;
+};
+
+void arena_init(Arena *a) {
+	a->head = 0;
+	a->bytes = 0;
+	a->chunks = 0;
+}
+
+void *arena_alloc(Arena *a, UINT32 size) {
+	ArenaChunk *c = malloc(sizeof(ArenaChunk) + size);
+	if (!c) {
+		return 0;
+	}
+	c->next = a->head;
+	a->head = c;
+	a->bytes += size;
+	a->chunks++;
+	return c + 1;
+}
+
+void arena_release(Arena *a) {
+	while (a->head) {
+		ArenaChunk *next = a->head->next;
+		free(a->head);
+		a->head = next;
+	}
+	arena_init(a);
+}
+
+/* ======= Log, disk and QEMU ======= */
+static FILE *g_log;
+
+void serial_write(const char *s) {
+	fputs(s, g_log);
+}
+
+int diskfs_mounted(void) {
+	return 0;
+}
+
+void diskfs_lock(void) {
+}
+
+void diskfs_unlock(void) {
+}
+
+void diskfs_request_sync(void) {
+}
+
+void qemu_exit(UINT8 code) {
+	fflush(g_log);
+	exit(code == BENCH_EXIT_OK ? 0 : 1);
+}
+
+/* ======= Driver ======= */
+static char *read_all(FILE *in, size_t *len) {
+	size_t cap = 4096, n = 0, got;
+	char *buf = malloc(cap);
+	while (buf && (got = fread(buf + n, 1, cap - n, in)) > 0) {
+		n += got;
+		if (n == cap) {
+			char *bigger = realloc(buf, cap *= 2);
+			if (!bigger) {
+				free(buf);
+				return 0;
+			}
+			buf = bigger;
+		}
+	}
+	*len = n;
+	return buf;
+}
+
+static int usage(void) {
+	fprintf(stderr, "usage: hosted bench\n       hosted calc|editor|words|log [KEYS | -]\n");
+	return 2;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		return usage();
+	}
+	int bench = strcmp(argv[1], "bench") == 0;
+	g_log = bench ? stdout : stderr;
+	clock_calibrate();
+	kstring_init();
+	ui_init();
+	arena_init(&g_appArena);
+	bn_set_allocator(kmalloc, kfree);
+	memfs_init();
+	const char *initrd = getenv("INITRD");
+	if (initrd) {
+		FILE *in = fopen(initrd, "rb");
+		size_t len = 0;
+		char *image = in ? read_all(in, &len) : 0; /* kept until exit, like the module */
+		if (in) {
+			fclose(in);
+		}
+		if (!image) {
+			fprintf(stderr, "hosted: cannot read %s\n", initrd);
+			return 1;
+		}
+		initrd_mount(image, (UINT32)len);
+	}
+	kprintf("MiniOS hosted, TSC %llu MHz, memory routines: %s\n", tsc_hz() / 1000000, kstring_variant());
+
+	if (bench) {
+		kprintf_set_targets(KPRINTF_SERIAL);
+		kstring_benchmark();
+		memfs_benchmark();
+		tb_benchmark();
+		calc_benchmark();
+		bignum_benchmark();
+		gfx_surface(&g_frame, malloc(FRAME_W * FRAME_H * 4), FRAME_W, FRAME_H, FRAME_W * 4, 16, 8, 0);
+		if (g_frame.pixels) {
+			gfx_benchmark(&g_frame);
+		}
+		bench_add_builtin();
+		qemu_exit(bench_run_all() ? BENCH_EXIT_FAIL : BENCH_EXIT_OK);
+	}
+
+	void (*app)(void) = 0;
+	if (strcmp(argv[1], "calc") == 0) {
+		app = run_calculator;
+	} else if (strcmp(argv[1], "editor") == 0) {
+		app = run_editor;
+	} else if (strcmp(argv[1], "words") == 0) {
+		app = run_word_game;
+	} else if (strcmp(argv[1], "log") == 0) {
+		app = run_log_viewer;
+	} else {
+		return usage();
+	}
+	char *input = 0;
+	if (argc > 2 && strcmp(argv[2], "-") == 0) {
+		input = read_all(stdin, &g_scriptLen);
+		if (!input) {
+			fprintf(stderr, "hosted: out of memory reading the script\n");
+			return 1;
+		}
+		g_script = input;
+	} else if (argc > 2) {
+		g_script = argv[2];
+		g_scriptLen = strlen(g_script);
+	}
+	const char *frame = getenv("FRAME");
+	if (frame) {
+		gfx_surface(&g_frame, malloc(FRAME_W * FRAME_H * 4), FRAME_W, FRAME_H, FRAME_W * 4, 16, 8, 0);
+		if (!g_frame.pixels) {
+			fprintf(stderr, "hosted: out of memory for the frame\n");
+			return 1;
+		}
+		ui_set_surface(&g_frame);
+	}
+	app();
+	vga_flush();
+	releaseAppArena();
+	if (!frame) {
+		print_screen();
+	} else if (!write_frame(frame)) {
+		fprintf(stderr, "hosted: cannot write %s\n", frame);
+		return 1;
+	}
+	free(input);
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "initrd.h"
+#include "memfs.h"
+#include "kprintf.h"
+
+// ======= ustar reader =======
+// 512-byte header per member, data padded to the next block, two zero blocks
+// at the end. Only regular files are mounted; directories are implied by the
+// names (memfs is flat, so "dict/en.txt" is just a name).
+#define BLOCK 512
+
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char link[100];
+    char magic[6];         // "ustar"
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} TarHeader;
+
+static UINT32 octal(const char* s,int n){
+    UINT32 v = 0;
+    for(int i=0; i<n && s[i]>='0' && s[i]<='7'; i++) v = v*8 + (UINT32)(s[i]-'0');
+    return v;
+}
+
+// The header checksum treats its own field as spaces
+static int header_ok(const TarHeader* h){
+    const UINT8* p = (const UINT8*)h;
+    UINT32 sum = 0;
+    for(int i=0;i<BLOCK;i++)
+        sum += (i>=148 && i<156) ? ' ' : p[i];
+    return sum == octal(h->checksum,8);
+}
+
+// prefix "/" name, without a leading "./"; 0 if it does not fit
+static int full_name(const TarHeader* h,char* out){
+    int n = 0;
+    for(int i=0; i<155 && h->prefix[i]; i++){ if(n>=MEMFS_NAME_MAX-1) return 0; out[n++] = h->prefix[i]; }
+    if(n){ if(n>=MEMFS_NAME_MAX-1) return 0; out[n++] = '/'; }
+    for(int i=0; i<100 && h->name[i]; i++){ if(n>=MEMFS_NAME_MAX-1) return 0; out[n++] = h->name[i]; }
+    out[n] = '\0';
+    int skip = 0;
+    while(out[skip]=='.' && out[skip+1]=='/') skip += 2;
+    if(skip) for(int i=0; (out[i]=out[i+skip]); i++) {}
+    return out[0] != '\0';
+}
+
+int initrd_mount(const void* image,UINT32 size){
+    const UINT8* p = (const UINT8*)image;
+    UINT32 off = 0, files = 0, bytes = 0;
+    char name[MEMFS_NAME_MAX];
+    while(off+BLOCK <= size){
+        const TarHeader* h = (const TarHeader*)(p+off);
+        if(!h->name[0]) break;                       // end-of-archive block
+        if(!header_ok(h)){
+            kprintf("initrd: bad header at offset %u, stopping\n", off);
+            break;
+        }
+        UINT32 len = octal(h->size,12);
+        off += BLOCK;
+        if(len > size-off){
+            kprintf("initrd: member at offset %u is cut short, stopping\n", off-BLOCK);
+            break;
+        }
+        if(h->type=='0' || h->type=='\0'){
+            if(full_name(h,name) && memfs_attach(name,p+off,len)){ files++; bytes += len; }
+            else kprintf("initrd: skipped member at offset %u (long name or no memory)\n", off-BLOCK);
+        }
+        off += (len+BLOCK-1) & ~(BLOCK-1u);
+    }
+    kprintf("initrd: %u files, %u KiB mapped in place\n", files, bytes/1024);
+    return (int)files;
+}
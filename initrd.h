@@ -0,0 +1,13 @@
+#ifndef _INITRD_H_
+#define _INITRD_H_
+
+#include "kernel.h"
+
+// ======= Initial RAM disk =======
+// A ustar archive loaded by GRUB as a Multiboot module (grub.cfg: module
+// /boot/initrd.tar). Its regular files are attached to memfs in place, so the
+// module must stay reserved for as long as the kernel runs. Returns the number
+// of files mounted.
+int initrd_mount(const void* image,UINT32 size);
+
+#endif
@@ -0,0 +1,352 @@
+#include "interrupts.h"
+#include "io.h"
+#include "kprintf.h"
+#include "apic.h"
+
+#define ISR_STUB_COUNT 49         // exceptions, 16 PIC lines, SCHED_VECTOR
+
+#define PIC1_CMD  0x20
+#define PIC1_DATA 0x21
+#define PIC2_CMD  0xA0
+#define PIC2_DATA 0xA1
+#define PIC_EOI   0x20
+
+extern UINTPTR isr_stub_table[ISR_STUB_COUNT];
+extern char isr_spurious[];
+
+// ======= GDT (flat code/data segments) =======
+struct gdt_ptr {
+    UINT16 limit;
+    UINTPTR base;
+} __attribute__((packed));
+
+#ifdef __x86_64__
+static UINT64 g_gdt[5] = {
+    0x0000000000000000ULL,
+    0x00AF9A000000FFFFULL,   // 0x08: ring 0 64-bit code
+    0x00CF92000000FFFFULL,   // 0x10: ring 0 data
+    0, 0,                    // 0x18: the TSS (16-byte descriptor, tss_init)
+};
+
+// ======= Task state segment =======
+// Long mode has no hardware task switching; the TSS only holds the interrupt
+// stack table. The double fault gate uses IST1, so it gets a stack of its own
+// even when the faulting code's stack is gone (overflow into a guard page).
+#define TSS_SEL 0x18
+
+struct tss {
+    UINT32 reserved0;
+    UINT64 rsp[3];
+    UINT64 reserved1;
+    UINT64 ist[7];
+    UINT64 reserved2;
+    UINT16 reserved3, iomap;
+} __attribute__((packed));
+
+static struct tss g_tss;
+static UINT8 g_dfStack[4096] __attribute__((aligned(16)));
+
+static void tss_init(void){
+    UINT64 base = (UINTPTR)&g_tss, limit = sizeof(g_tss)-1;
+    g_tss.ist[0] = (UINTPTR)(g_dfStack + sizeof(g_dfStack));
+    g_tss.iomap = sizeof(g_tss);
+    g_gdt[TSS_SEL>>3] = (limit & 0xFFFF) | ((base & 0xFFFFFF)<<16) | (0x89ULL<<40)     // present, available TSS
+                      | (((limit>>16) & 0xF)<<48) | (((base>>24) & 0xFF)<<56);
+    g_gdt[(TSS_SEL>>3)+1] = base>>32;
+}
+
+void interrupts_set_page_directory(UINT32 dir){ (void)dir; }
+
+static void gdt_load(void){
+    struct gdt_ptr gp = { sizeof(g_gdt)-1, (UINTPTR)g_gdt };
+    __asm__ volatile(
+        "lgdt %0\n"
+        "pushq $0x08\n"
+        "lea 1f(%%rip),%%rax\n"
+        "pushq %%rax\n"
+        "lretq\n"
+        "1:\n"
+        "mov $0x10,%%ax\n"
+        "mov %%ax,%%ds\n"
+        "mov %%ax,%%es\n"
+        "mov %%ax,%%fs\n"
+        "mov %%ax,%%gs\n"
+        "mov %%ax,%%ss\n"
+        ::"m"(gp):"rax","memory");
+}
+#else
+static UINT64 g_gdt[5] = {
+    0x0000000000000000ULL,
+    0x00CF9A000000FFFFULL,   // 0x08: ring 0 code, base 0, limit 4 GiB
+    0x00CF92000000FFFFULL,   // 0x10: ring 0 data, base 0, limit 4 GiB
+    0,                       // 0x18: TSS of everything else (tss_init)
+    0,                       // 0x20: TSS of the double fault handler
+};
+
+// ======= Task state segments =======
+// Only the double fault uses hardware task switching. Its IDT entry is a task
+// gate, so the CPU moves to g_dfTss and a stack of its own even when the
+// faulting code's stack is gone (overflow into a guard page); g_tss receives
+// the interrupted state.
+#define TSS_SEL    0x18
+#define DF_TSS_SEL 0x20
+
+struct tss {
+    UINT32 link, esp0, ss0, esp1, ss1, esp2, ss2, cr3, eip, eflags;
+    UINT32 eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    UINT32 es, cs, ss, ds, fs, gs, ldt;
+    UINT16 trap, iomap;
+} __attribute__((packed));
+
+static struct tss g_tss, g_dfTss;
+static UINT8 g_dfStack[4096] __attribute__((aligned(16)));
+
+static void double_fault_task(void);
+
+static UINT64 tss_descriptor(struct tss* t){
+    UINT32 base = (UINTPTR)t, limit = sizeof(*t)-1;
+    return (UINT64)(limit & 0xFFFF) | ((UINT64)(base & 0xFFFFFF)<<16) | (0x89ULL<<40)   // present, 32-bit TSS
+         | ((UINT64)((limit>>16) & 0xF)<<48) | ((UINT64)(base>>24)<<56);
+}
+
+static void tss_init(void){
+    g_tss.iomap = sizeof(g_tss);
+    g_dfTss.iomap = sizeof(g_dfTss);
+    g_dfTss.eip = (UINTPTR)double_fault_task;
+    g_dfTss.esp = (UINTPTR)(g_dfStack + sizeof(g_dfStack));
+    g_dfTss.eflags = 0x2;                      // interrupts stay off
+    g_dfTss.cs = KERNEL_CS;
+    g_dfTss.ss = g_dfTss.ds = g_dfTss.es = g_dfTss.fs = g_dfTss.gs = KERNEL_DS;
+    g_gdt[TSS_SEL>>3] = tss_descriptor(&g_tss);
+    g_gdt[DF_TSS_SEL>>3] = tss_descriptor(&g_dfTss);
+}
+
+void interrupts_set_page_directory(UINT32 dir){ g_dfTss.cr3 = dir; }
+
+static void gdt_load(void){
+    struct gdt_ptr gp = { sizeof(g_gdt)-1, (UINTPTR)g_gdt };
+    __asm__ volatile(
+        "lgdt %0\n"
+        "ljmp $0x08,$1f\n"
+        "1:\n"
+        "mov $0x10,%%ax\n"
+        "mov %%ax,%%ds\n"
+        "mov %%ax,%%es\n"
+        "mov %%ax,%%fs\n"
+        "mov %%ax,%%gs\n"
+        "mov %%ax,%%ss\n"
+        ::"m"(gp):"eax","memory");
+}
+#endif
+
+// The TSS belongs to the boot CPU: only it loads the task register
+static void gdt_init(void){
+    tss_init();
+    gdt_load();
+    __asm__ volatile("ltr %0"::"r"((UINT16)TSS_SEL));
+}
+
+// ======= IDT =======
+#ifdef __x86_64__
+struct idt_entry {
+    UINT16 base_lo;
+    UINT16 sel;
+    UINT8  ist;
+    UINT8  flags;
+    UINT16 base_hi;
+    UINT32 base_top;
+    UINT32 reserved;
+} __attribute__((packed));
+#else
+struct idt_entry {
+    UINT16 base_lo;
+    UINT16 sel;
+    UINT8  zero;
+    UINT8  flags;
+    UINT16 base_hi;
+} __attribute__((packed));
+#endif
+
+struct idt_ptr {
+    UINT16 limit;
+    UINTPTR base;
+} __attribute__((packed));
+
+static struct idt_entry g_idt[256];
+static irq_handler_t g_handlers[256];
+static irq_exit_hook_t g_exitHook = 0;
+
+static void idt_set_gate(int n,UINTPTR base){
+    g_idt[n].base_lo = base & 0xFFFF;
+    g_idt[n].base_hi = (base>>16) & 0xFFFF;
+    g_idt[n].sel = KERNEL_CS;
+#ifdef __x86_64__
+    g_idt[n].ist = 0;
+    g_idt[n].base_top = (UINT64)base>>32;
+    g_idt[n].reserved = 0;
+#else
+    g_idt[n].zero = 0;
+#endif
+    g_idt[n].flags = 0x8E;   // present, ring 0, interrupt gate
+}
+
+// ======= 8259 PIC =======
+static void pic_remap(void){
+    outb(PIC1_CMD,0x11); io_wait();         // ICW1: init, expect ICW4
+    outb(PIC2_CMD,0x11); io_wait();
+    outb(PIC1_DATA,IRQ_BASE); io_wait();     // ICW2: vector offsets
+    outb(PIC2_DATA,IRQ_BASE+8); io_wait();
+    outb(PIC1_DATA,4); io_wait();            // ICW3: slave on IRQ2
+    outb(PIC2_DATA,2); io_wait();
+    outb(PIC1_DATA,0x01); io_wait();         // ICW4: 8086 mode
+    outb(PIC2_DATA,0x01); io_wait();
+    // Start fully masked except the cascade line; drivers unmask what they use
+    outb(PIC1_DATA,0xFB);
+    outb(PIC2_DATA,0xFF);
+}
+
+void irq_mask(int irq){
+    UINT16 port = irq<8 ? PIC1_DATA : PIC2_DATA;
+    if(irq>=8) irq-=8;
+    outb(port, inb(port) | (1<<irq));
+}
+
+void irq_unmask(int irq){
+    UINT16 port = irq<8 ? PIC1_DATA : PIC2_DATA;
+    if(irq>=8) irq-=8;
+    outb(port, inb(port) & ~(1<<irq));
+}
+
+static void pic_eoi(int irq){
+    if(irq>=8) outb(PIC2_CMD,PIC_EOI);
+    outb(PIC1_CMD,PIC_EOI);
+}
+
+void irq_register(int irq,irq_handler_t handler){
+    g_handlers[IRQ_BASE+irq] = handler;
+    irq_unmask(irq);
+}
+
+void irq_register_vector(int vec,irq_handler_t handler){ g_handlers[vec] = handler; }
+
+void irq_set_exit_hook(irq_exit_hook_t hook){ g_exitHook = hook; }
+
+// ======= Exceptions =======
+static const char* g_exc_names[32] = {
+    "Divide error","Debug","NMI","Breakpoint","Overflow","Bound range",
+    "Invalid opcode","Device not available","Double fault","Coprocessor overrun",
+    "Invalid TSS","Segment not present","Stack fault","General protection",
+    "Page fault","Reserved","x87 FPU error","Alignment check","Machine check",
+    "SIMD FP error","Virtualization","Control protection","Reserved","Reserved",
+    "Reserved","Reserved","Reserved","Reserved","Hypervisor injection",
+    "VMM communication","Security","Reserved"
+};
+
+// Writes straight to VGA memory so it works no matter what state the console is in
+static void panic_write(int row,const char* s){
+    UINT16* vga = (UINT16*)VGA_ADDRESS;
+    for(int i=0;s[i] && i<80;i++) vga[row*80+i] = (UINT16)(UINT8)s[i] | (0x4F<<8);
+}
+
+static void hex(UINT64 v,int digits,char* out){
+    for(int i=0;i<digits;i++){ int d=(v>>((digits-1-i)*4))&0xF; out[i]= d<10 ? '0'+d : 'A'+d-10; }
+    out[digits]='\0';
+}
+
+#ifdef __x86_64__
+#define IP_LABEL "  RIP="
+#define FRAME_IP(r) ((r)->rip)
+#else
+#define IP_LABEL "  EIP="
+#define FRAME_IP(r) ((r)->eip)
+#endif
+
+static void exception_halt(struct regs* r){ exception_panic(r,0); }
+
+void exception_panic(struct regs* r,const char* detail){
+    char line[80]; char digits[17];
+    const char* name = g_exc_names[r->int_no & 31];
+    int n=0;
+    const char* pre="EXCEPTION: ";
+    for(int i=0;pre[i];i++) line[n++]=pre[i];
+    for(int i=0;name[i] && n<40;i++) line[n++]=name[i];
+    const char* at=IP_LABEL;
+    for(int i=0;at[i];i++) line[n++]=at[i];
+    hex(FRAME_IP(r),2*sizeof(UINTPTR),digits); for(int i=0;digits[i];i++) line[n++]=digits[i];
+    const char* ec="  ERR=";
+    for(int i=0;ec[i];i++) line[n++]=ec[i];
+    hex(r->err_code,8,digits); for(int i=0;digits[i];i++) line[n++]=digits[i];
+    line[n]='\0';
+    panic_write(0,line);
+    if(detail) panic_write(1,detail);
+    // and on COM1 for headless runs
+    kprintf("%s\n%s%s",line,detail ? detail : "",detail ? "\n" : "");
+    for(;;) __asm__ volatile("cli; hlt");
+}
+
+#ifndef __x86_64__
+// Entered by the task switch; the error code (always 0) is on the new stack.
+// The registers of the code that faulted were saved in g_tss.
+static void double_fault_task(void){
+    struct regs r;
+    r.gs = g_tss.gs; r.fs = g_tss.fs; r.es = g_tss.es; r.ds = g_tss.ds;
+    r.edi = g_tss.edi; r.esi = g_tss.esi; r.ebp = g_tss.ebp; r.esp_dummy = g_tss.esp;
+    r.ebx = g_tss.ebx; r.edx = g_tss.edx; r.ecx = g_tss.ecx; r.eax = g_tss.eax;
+    r.int_no = 8; r.err_code = 0;
+    r.eip = g_tss.eip; r.cs = g_tss.cs; r.eflags = g_tss.eflags;
+    if(g_handlers[8]) g_handlers[8](&r);
+    exception_halt(&r);
+}
+#endif
+
+// ======= Dispatch (called from isr_common) =======
+volatile UINT32 g_irqDepth = 0;
+
+static struct regs* dispatch(struct regs* r){
+    UINT32 vec = r->int_no;
+    if(vec < IRQ_BASE){
+        if(g_handlers[vec]) g_handlers[vec](r);
+        else exception_halt(r);
+        return r;
+    }
+    if(vec < IRQ_BASE+16){
+        int irq = vec-IRQ_BASE;
+        // Spurious IRQ7/IRQ15: the PIC raised nothing, so no handler and no EOI (master only for 15)
+        if(irq==7){ outb(PIC1_CMD,0x0B); if(!(inb(PIC1_CMD)&0x80)) return r; }
+        if(irq==15){ outb(PIC2_CMD,0x0B); if(!(inb(PIC2_CMD)&0x80)){ outb(PIC1_CMD,PIC_EOI); return r; } }
+        pic_eoi(irq);
+        if(g_handlers[vec]) g_handlers[vec](r);
+        return g_exitHook ? g_exitHook(r) : r;
+    }
+    if(g_handlers[vec]) g_handlers[vec](r);
+    return g_exitHook ? g_exitHook(r) : r;
+}
+
+struct regs* isr_dispatch(struct regs* r){
+    g_irqDepth++;
+    struct regs* next = dispatch(r);
+    g_irqDepth--;
+    return next;
+}
+
+void interrupts_init(void){
+    gdt_init();
+    for(int i=0;i<ISR_STUB_COUNT;i++) idt_set_gate(i,isr_stub_table[i]);
+#ifdef __x86_64__
+    g_idt[8].ist = 1;                          // double fault on IST1
+#else
+    g_idt[8].base_lo = g_idt[8].base_hi = 0;   // task gate to the double fault TSS
+    g_idt[8].sel = DF_TSS_SEL;
+    g_idt[8].flags = 0x85;
+#endif
+    idt_set_gate(APIC_SPURIOUS_VECTOR,(UINTPTR)isr_spurious);
+    pic_remap();
+    struct idt_ptr ip = { sizeof(g_idt)-1, (UINTPTR)g_idt };
+    __asm__ volatile("lidt %0"::"m"(ip));
+}
+
+void interrupts_init_ap(void){
+    gdt_load();
+    struct idt_ptr ip = { sizeof(g_idt)-1, (UINTPTR)g_idt };
+    __asm__ volatile("lidt %0"::"m"(ip));
+}
@@ -0,0 +1,79 @@
+#ifndef _INTERRUPTS_H_
+#define _INTERRUPTS_H_
+
+#include "kernel.h"
+
+// Register frame built by isr_common in isr.S or isr64.S (lowest address first)
+#ifdef __x86_64__
+struct regs {
+    UINT8 fx[512] __attribute__((aligned(16)));     // fxsave image of the interrupted code
+    UINT64 r15, r14, r13, r12, r11, r10, r9, r8;
+    UINT64 rdi, rsi, rbp, rbx, rdx, rcx, rax;
+    UINT64 int_no, err_code;
+    UINT64 rip, cs, rflags, rsp, ss;
+};
+#else
+struct regs {
+    UINT32 gs, fs, es, ds;
+    UINT32 edi, esi, ebp, esp_dummy, ebx, edx, ecx, eax;
+    UINT32 int_no, err_code;
+    UINT32 eip, cs, eflags;
+};
+#endif
+
+#define KERNEL_CS 0x08
+#define KERNEL_DS 0x10
+
+#define IRQ_BASE 32       // PIC IRQ0..15 remapped to vectors 32..47
+
+typedef void (*irq_handler_t)(struct regs* r);
+
+void interrupts_init(void);
+
+// Other CPUs (smp.c): the same GDT and IDT, but no TSS, so a double fault
+// there is not survivable. They run with interrupts off.
+void interrupts_init_ap(void);
+void irq_register(int irq,irq_handler_t handler);
+
+// Handler for a software interrupt vector (int $n) above the PIC range
+void irq_register_vector(int vec,irq_handler_t handler);
+
+// Called on the way out of every IRQ and software interrupt; the frame it
+// returns is the one resumed, which is how the scheduler switches threads
+typedef struct regs* (*irq_exit_hook_t)(struct regs* r);
+void irq_set_exit_hook(irq_exit_hook_t hook);
+void irq_mask(int irq);
+void irq_unmask(int irq);
+
+// Handlers for exceptions (vectors 0-31, registered with irq_register_vector)
+// may end here: reports the exception and detail on screen and COM1, then halts.
+// Vector 8 handlers run on the double fault's own stack (on i386 with the
+// frame rebuilt from the saved task state).
+void exception_panic(struct regs* r,const char* detail) __attribute__((noreturn));
+
+// CR3 the double fault task switches to (paging_init)
+void interrupts_set_page_directory(UINT32 dir);
+
+// Save IF and disable interrupts; restore the saved state afterwards.
+// in_interrupt() is nonzero while an exception or IRQ handler runs.
+#ifdef HOSTED
+// Hosted build (host.c): one thread and no interrupts to mask
+static inline UINT32 irq_save(void){ return 0; }
+static inline void irq_restore(UINT32 flags){ (void)flags; }
+static inline int in_interrupt(void){ return 0; }
+#else
+extern volatile UINT32 g_irqDepth;
+static inline int in_interrupt(void){ return g_irqDepth!=0; }
+
+static inline UINT32 irq_save(void){
+    UINTPTR flags;
+    __asm__ volatile("pushf\n pop %0\n cli":"=r"(flags)::"memory");
+    return (UINT32)flags;
+}
+
+static inline void irq_restore(UINT32 flags){
+    if(flags & 0x200) __asm__ volatile("sti":::"memory");
+}
+#endif
+
+#endif
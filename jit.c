@@ -0,0 +1,287 @@
+#include <string.h>
+
+#include "jit.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+/*
+ * The VM stack maps onto registers: slot i lives in xmm i, and xmm14/xmm15 are
+ * scratch, so programs needing more than 14 slots are left to the interpreter.
+ * Register use (SysV): rdi = current row, rsi = n, rdx = stride, rcx = out,
+ * r8 = row index, r9 = constant table (stored after the code).
+ */
+#define JIT_MAX_SLOTS 14
+#define JIT_MAX_FIXUPS 64
+#define JIT_MAX_POW 64
+#define JIT_CODE_SIZE 16384
+
+typedef struct {
+	unsigned char *p;
+	size_t len, cap;
+	int fail;
+	size_t fixups[JIT_MAX_FIXUPS];  /* rel32 operands that jump to the exit */
+	int nfixups;
+} Code;
+
+static void emit(Code *c, unsigned char b) {
+	if (c->len < c->cap) {
+		c->p[c->len] = b;
+	} else {
+		c->fail = 1;
+	}
+	c->len++;
+}
+
+static void emit32(Code *c, int v) {
+	for (int i = 0; i < 4; i++) {
+		emit(c, (unsigned char)(v >> (8 * i)));
+	}
+}
+
+static void patch32(Code *c, size_t at, int v) {
+	if (at + 4 <= c->cap) {
+		memcpy(c->p + at, &v, 4);
+	}
+}
+
+/* prefix [REX] 0F op, register to register */
+static void sse_rr(Code *c, unsigned char prefix, unsigned char op, int dst, int src) {
+	unsigned char rex = 0x40 | (dst >= 8 ? 4 : 0) | (src >= 8 ? 1 : 0);
+	emit(c, prefix);
+	if (rex != 0x40) {
+		emit(c, rex);
+	}
+	emit(c, 0x0F);
+	emit(c, op);
+	emit(c, (unsigned char)(0xC0 | (dst & 7) << 3 | (src & 7)));
+}
+
+/* prefix [REX] 0F op, register from [base + disp32]; base is rdi (7) or r9 (9) */
+static void sse_load(Code *c, unsigned char prefix, unsigned char op, int dst, int base, int disp) {
+	unsigned char rex = 0x40 | (dst >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0);
+	emit(c, prefix);
+	if (rex != 0x40) {
+		emit(c, rex);
+	}
+	emit(c, 0x0F);
+	emit(c, op);
+	emit(c, (unsigned char)(0x80 | (dst & 7) << 3 | (base & 7)));
+	emit32(c, disp);
+}
+
+#define MOVSD 0x10
+#define ADDSD 0x58
+#define MULSD 0x59
+#define SUBSD 0x5C
+#define DIVSD 0x5E
+#define MOVAPD 0x28
+#define XORPD 0x57
+#define UCOMISD 0x2E
+
+/* Leave the row loop, returning the current row index, when xmm 'r' == 0 */
+static void exit_if_zero(Code *c, int r) {
+	sse_rr(c, 0x66, XORPD, 15, 15);
+	sse_rr(c, 0x66, UCOMISD, r, 15);
+	emit(c, 0x7A);                  /* jp +6: NaN is not zero */
+	emit(c, 0x06);
+	emit(c, 0x0F);                  /* je exit */
+	emit(c, 0x84);
+	if (c->nfixups == JIT_MAX_FIXUPS) {
+		c->fail = 1;
+	} else {
+		c->fixups[c->nfixups++] = c->len;
+	}
+	emit32(c, 0);
+}
+
+static int is_small_int(double x) {
+	return x >= -JIT_MAX_POW && x <= JIT_MAX_POW && x == (double)(long)x;
+}
+
+/* consts[], 1.0 and the sign mask sit at r9; returns 0 for anything left to the interpreter */
+static int gen_body(Code *c, const ExprProgram *prog, const int *colOf, int oneOff, int signOff) {
+	int known[JIT_MAX_SLOTS + 1];   /* slot holds a compile-time constant */
+	double kval[JIT_MAX_SLOTS + 1];
+	int sp = 0;
+	const unsigned char *ip = prog->code;
+
+	for (;;) {
+		unsigned char op = *ip++;
+		switch (op) {
+		case EXPR_OP_END:
+			return sp == 1;
+		case EXPR_OP_CONST:
+			if (sp == JIT_MAX_SLOTS) {
+				return 0;
+			}
+			known[sp] = 1;
+			kval[sp] = prog->consts[*ip];
+			sse_load(c, 0xF2, MOVSD, sp++, 9, 8 * *ip++);
+			break;
+		case EXPR_OP_LOAD:
+			if (sp == JIT_MAX_SLOTS || colOf[*ip] < 0) {
+				return 0;
+			}
+			known[sp] = 0;
+			sse_load(c, 0xF2, MOVSD, sp++, 7, 8 * colOf[*ip++]);
+			break;
+		case EXPR_OP_STORE:
+			ip++;                   /* row mode only wants the value */
+			break;
+		case EXPR_OP_ADD:
+		case EXPR_OP_SUB:
+		case EXPR_OP_MUL:
+			sp--;
+			sse_rr(c, 0xF2, op == EXPR_OP_ADD ? ADDSD : op == EXPR_OP_SUB ? SUBSD : MULSD, sp - 1, sp);
+			known[sp - 1] = 0;
+			break;
+		case EXPR_OP_DIV:
+			sp--;
+			exit_if_zero(c, sp);
+			sse_rr(c, 0xF2, DIVSD, sp - 1, sp);
+			known[sp - 1] = 0;
+			break;
+		case EXPR_OP_NEG:
+			/* flip the sign bit like the interpreter's -x: 0 - x would give +0.0 for 0 */
+			sse_load(c, 0x66, XORPD, sp - 1, 9, signOff);
+			known[sp - 1] = 0;
+			break;
+		case EXPR_OP_POW: {
+			/* same square-and-multiply sequence as the interpreter, unrolled */
+			sp--;
+			if (!known[sp] || !is_small_int(kval[sp])) {
+				return 0;
+			}
+			long n = (long)kval[sp];
+			int a = sp - 1;
+			if (n < 0) {
+				exit_if_zero(c, a);
+			}
+			sse_load(c, 0xF2, MOVSD, 14, 9, oneOff);
+			for (long m = n < 0 ? -n : n; m; m >>= 1) {
+				if (m & 1) {
+					sse_rr(c, 0xF2, MULSD, 14, a);
+				}
+				if (m > 1) {
+					sse_rr(c, 0xF2, MULSD, a, a);
+				}
+			}
+			if (n < 0) {
+				sse_load(c, 0xF2, MOVSD, a, 9, oneOff);
+				sse_rr(c, 0xF2, DIVSD, a, 14);
+			} else {
+				sse_rr(c, 0x66, MOVAPD, a, 14);
+			}
+			known[a] = 0;
+			break;
+		}
+		default:                        /* EXPR_OP_MOD and anything new */
+			return 0;
+		}
+	}
+}
+
+int jit_compile(const ExprProgram *prog, const int *colOf, Jit *jit) {
+	Code c;
+	void *mem = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	jit->mem = NULL;
+	jit->fn = NULL;
+	if (mem == MAP_FAILED) {
+		return 0;
+	}
+	/* constants first (8-byte aligned), then the 16-byte sign mask xorpd reads, code after them */
+	double *consts = mem;
+	int oneOff = 8 * prog->nconsts;
+	int signOff = (oneOff + 8 + 15) & ~15;
+	memcpy(consts, prog->consts, sizeof(double) * (size_t)prog->nconsts);
+	consts[prog->nconsts] = 1.0;
+	consts[signOff / 8] = -0.0;
+	consts[signOff / 8 + 1] = -0.0;
+	size_t start = (size_t)signOff + 16;
+	c.p = (unsigned char *)mem + start;
+	c.len = 0;
+	c.cap = JIT_CODE_SIZE - start;
+	c.fail = 0;
+	c.nfixups = 0;
+
+	unsigned long long table = (unsigned long long)(size_t)consts;
+	emit(&c, 0x49);                 /* mov r9, imm64 */
+	emit(&c, 0xB9);
+	for (int i = 0; i < 8; i++) {
+		emit(&c, (unsigned char)(table >> (8 * i)));
+	}
+	emit(&c, 0x4D);                 /* xor r8, r8 */
+	emit(&c, 0x31);
+	emit(&c, 0xC0);
+	size_t loop = c.len;
+	emit(&c, 0x49);                 /* cmp r8, rsi */
+	emit(&c, 0x39);
+	emit(&c, 0xF0);
+	emit(&c, 0x0F);                 /* jge exit */
+	emit(&c, 0x8D);
+	size_t toExit = c.len;
+	emit32(&c, 0);
+
+	int ok = gen_body(&c, prog, colOf, oneOff, signOff);
+
+	static const unsigned char tail[] = {
+		0xF2, 0x42, 0x0F, 0x11, 0x04, 0xC1,     /* movsd [rcx + r8*8], xmm0 */
+		0x48, 0x01, 0xD7,                       /* add rdi, rdx */
+		0x49, 0xFF, 0xC0,                       /* inc r8 */
+	};
+	for (size_t i = 0; i < sizeof(tail); i++) {
+		emit(&c, tail[i]);
+	}
+	emit(&c, 0xE9);                 /* jmp loop */
+	emit32(&c, (int)loop - (int)(c.len + 4));
+	size_t exitAt = c.len;
+	emit(&c, 0x4C);                 /* mov rax, r8 */
+	emit(&c, 0x89);
+	emit(&c, 0xC0);
+	emit(&c, 0xC3);                 /* ret */
+
+	if (!ok || c.fail) {
+		munmap(mem, JIT_CODE_SIZE);
+		return 0;
+	}
+	patch32(&c, toExit, (int)exitAt - (int)(toExit + 4));
+	for (int i = 0; i < c.nfixups; i++) {
+		patch32(&c, c.fixups[i], (int)exitAt - (int)(c.fixups[i] + 4));
+	}
+	/* W^X: never writable and executable at the same time */
+	if (mprotect(mem, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, JIT_CODE_SIZE);
+		return 0;
+	}
+	jit->mem = mem;
+	jit->size = JIT_CODE_SIZE;
+	jit->fn = (JitFn)(void *)c.p;
+	return 1;
+}
+
+void jit_free(Jit *jit) {
+	if (jit->mem) {
+		munmap(jit->mem, jit->size);
+	}
+	jit->mem = NULL;
+	jit->fn = NULL;
+}
+
+#else
+
+int jit_compile(const ExprProgram *prog, const int *colOf, Jit *jit) {
+	(void)prog;
+	(void)colOf;
+	jit->mem = NULL;
+	jit->fn = NULL;
+	return 0;
+}
+
+void jit_free(Jit *jit) {
+	jit->mem = NULL;
+	jit->fn = NULL;
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <stddef.h>
+
+#include "expr.h"
+
+/*
+ * Native code for calc's row mode (host only, x86-64 SSE2).
+ *
+ * A compiled program evaluates the expression for n rows of doubles laid out
+ * 'stride' bytes apart and writes one result per row. It stops at the first
+ * row the interpreter would reject (division by zero) and returns that row's
+ * index, or n when every row succeeded, so the caller can hand that row to
+ * expr_run for the error and resume after it.
+ */
+typedef long (*JitFn)(const double *rows, long n, long stride, double *out);
+
+typedef struct {
+	void *mem;
+	size_t size;
+	JitFn fn;
+} Jit;
+
+/*
+ * colOf[slot] is the row column holding variable 'slot'. Returns 0 when the
+ * JIT is unavailable on this host or the program uses something it does not
+ * compile (%, a non-constant or large power, deep stacks); use expr_run then.
+ */
+int jit_compile(const ExprProgram *prog, const int *colOf, Jit *jit);
+void jit_free(Jit *jit);
+
+#endif
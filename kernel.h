@@ -1,16 +1,30 @@
-#ifndef _KERNEL_H_
-#define _KERNEL_H_
-
-#define VGA_ADDRESS 0xB8000
-#define WHITE_COLOR 15
-
-typedef unsigned short UINT16;
-
-/* VGA state (defined once in kernel.c) */
-extern unsigned int VGA_INDEX;
-extern UINT16* TERMINAL_BUFFER;
-
-/* Optional: size constants */
-#define BUFSIZE 2200
-
-#endif
\ No newline at end of file
+#ifndef _KERNEL_H_
+#define _KERNEL_H_
+
+#define VGA_ADDRESS 0xB8000
+#define WHITE_COLOR 15
+
+typedef unsigned char UINT8;
+typedef unsigned short UINT16;
+typedef unsigned int UINT32;
+typedef unsigned long long UINT64;
+typedef unsigned long UINTPTR;    /* pointer-sized: 32 bits on i386, 64 on x86_64 */
+
+/* Back-buffered text console (ui.c): drawing helpers write off-screen, vga_flush()
+   copies only the changed span of each row to video memory */
+typedef struct {
+    unsigned int frames;      /* number of flushes */
+    unsigned int lastCells;   /* cells copied to MMIO by the last flush */
+    unsigned int totalCells;  /* cells copied since boot */
+} VgaStats;
+
+void vga_flush(void);
+const VgaStats* vga_stats(void);
+
+/* Append text to the kernel log console (used by kprintf) */
+void console_write(const char* s);
+
+/* Optional: size constants */
+#define BUFSIZE 2200
+
+#endif
@@ -0,0 +1,132 @@
+#include "keyboard.h"
+#include "keymap.h"
+#include "interrupts.h"
+#include "io.h"
+#include "clock.h"
+#include "sched.h"
+
+// ======= Scancode ring (single producer: IRQ1, single consumer: apps) =======
+// head is only written by the IRQ handler and tail only by the reader, so no lock
+// is needed; the free-running counters wrap naturally and are masked on access.
+static volatile UINT8 g_ring[KBD_RING_SIZE];
+static volatile UINT32 g_head = 0;
+static volatile UINT32 g_tail = 0;
+static volatile UINT32 g_dropped = 0;
+static int g_shift = 0;                 // consumer side only, updated in getkey
+static WaitQueue g_waiters;             // threads blocked in getkey
+
+// Producers are IRQ handlers (IRQ1, and IRQ4/IRQ0 for the serial console);
+// they never nest, so they never race each other
+static void ring_push(UINT8 sc){
+    if(g_head - g_tail >= KBD_RING_SIZE){ g_dropped++; return; }
+    g_ring[g_head & (KBD_RING_SIZE-1)] = sc;
+    __asm__ volatile("":::"memory");
+    g_head++;
+}
+
+static void keyboard_irq(struct regs* r){
+    (void)r;
+    // Drain everything the controller has buffered in one interrupt
+    while(inb(0x64)&1) ring_push(inb(0x60));
+    if(g_head != g_tail) sched_wake_all(&g_waiters);
+}
+
+void keyboard_init(void){
+    // Discard anything typed before the handler existed
+    while(inb(0x64)&1) (void)inb(0x60);
+    wait_init(&g_waiters);
+    irq_register(1,keyboard_irq);
+}
+
+int kbd_poll(UINT8* sc){
+    if(g_tail == g_head) return 0;
+    *sc = g_ring[g_tail & (KBD_RING_SIZE-1)];
+    __asm__ volatile("":::"memory");
+    g_tail++;
+    return 1;
+}
+
+int kbd_shift(void){ return g_shift; }
+
+int getkey_timeout(UINT32 ms,UINT8* out){
+    UINT64 due = now_ns() + (UINT64)ms*1000000ULL;
+    for(;;){
+        UINT8 sc;
+        if(!kbd_poll(&sc)){
+            UINT64 now = now_ns();
+            if(ms!=KBD_WAIT_FOREVER && now>=due) return 0;
+            // Check and block with interrupts off, so a key arriving in between
+            // still wakes us; other threads run while we wait
+            UINT32 flags = irq_save();
+            if(g_tail == g_head){
+                if(ms==KBD_WAIT_FOREVER) sched_wait(&g_waiters);
+                else sched_wait_timeout(&g_waiters,(UINT32)((due-now+999999)/1000000));
+            }
+            irq_restore(flags);
+            continue;
+        }
+        if(sc==0x2A || sc==0x36){ g_shift=1; continue; }    // left/right Shift
+        if(sc==0xAA || sc==0xB6){ g_shift=0; continue; }
+        if(sc==0xE0 || (sc&0x80)) continue;   // extended prefix, key release
+        *out = sc;
+        return 1;
+    }
+}
+
+UINT8 getkey(void){
+    UINT8 sc;
+    getkey_timeout(KBD_WAIT_FOREVER,&sc);
+    return sc;
+}
+
+UINT32 kbd_dropped(void){ return g_dropped; }
+
+// ======= Serial console input =======
+// Characters from a terminal become the scancodes a PC keyboard would send,
+// so apps can't tell the difference (keymap.c has the US layout).
+#define ESC_TIMEOUT_MS 30     // a lone ESC is the Esc key, not the start of a sequence
+
+static int g_escState = 0;    // 0 plain, 1 after ESC, 2 in "ESC [", 3 after "ESC O"
+static int g_escParam = 0;
+static Timer g_escTimer;
+
+void kbd_inject(UINT8 sc){
+    UINT32 flags = irq_save();
+    ring_push(sc);
+    sched_wake_all(&g_waiters);
+    irq_restore(flags);
+}
+
+static void inject_char(char c){
+    UINT8 sc[3];
+    int n = keymap_from_ascii(c,sc);
+    for(int i=0;i<n;i++) kbd_inject(sc[i]);
+}
+
+static void esc_expired(void* arg){
+    (void)arg;
+    if(g_escState==1){ g_escState=0; kbd_inject(0x01); }
+}
+
+void kbd_feed_ascii(char c){
+    if(g_escState==1){
+        timer_cancel(&g_escTimer);
+        if(c=='['){ g_escState=2; g_escParam=0; return; }
+        if(c=='O'){ g_escState=3; return; }
+        g_escState=0;
+        kbd_inject(0x01);
+    }else if(g_escState>=2){
+        if(g_escState==2 && c>='0' && c<='9'){ g_escParam = g_escParam*10 + (c-'0'); return; }
+        if(g_escState==2 && c==';') return;           // modifiers are ignored
+        UINT8 sc = keymap_from_vt100(c,g_escParam);
+        g_escState=0;
+        if(sc) kbd_inject(sc);
+        return;
+    }
+    if(c==0x1B){
+        g_escState=1;
+        timer_start(&g_escTimer,ESC_TIMEOUT_MS,esc_expired,0);
+        return;
+    }
+    inject_char(c);
+}
@@ -0,0 +1,37 @@
+#ifndef _KEYBOARD_H_
+#define _KEYBOARD_H_
+
+#include "kernel.h"
+
+#define KBD_RING_SIZE 256   // power of two
+
+void keyboard_init(void);
+
+// Non-blocking: pop the next raw scancode (make, release or prefix) if any
+int kbd_poll(UINT8* sc);
+
+// getkey, getkey_timeout, kbd_shift and kbd_feed_ascii are all the apps use
+// (hal.h); the hosted build replaces them with a scripted keyboard.
+
+// Blocking: next make code, halting the CPU while the ring is empty
+UINT8 getkey(void);
+
+// As getkey, but gives up after ms milliseconds (returns 0; 1 with *sc set)
+#define KBD_WAIT_FOREVER 0xFFFFFFFFu
+int getkey_timeout(UINT32 ms,UINT8* sc);
+
+// Whether a Shift key is held (tracked by getkey, which consumes Shift itself)
+int kbd_shift(void);
+
+// Scancodes lost because the ring was full
+UINT32 kbd_dropped(void);
+
+// Queue a scancode as if the keyboard had sent it
+void kbd_inject(UINT8 sc);
+
+// Serial console: translate terminal input (ASCII and VT100 escape sequences
+// for arrows, Home/End, PgUp/PgDn, Delete and F1-F5) into scancodes.
+// Called from IRQ context (serial_set_rx_handler).
+void kbd_feed_ascii(char c);
+
+#endif
@@ -0,0 +1,71 @@
+#include "keymap.h"
+#include "keyboard.h"
+
+char scancode_to_ascii(unsigned char sc){
+    if(kbd_shift()){
+        switch(sc){
+            case 0x07: return '^'; case 0x09: return '*';
+            case 0x0A: return '('; case 0x0B: return ')';
+            case 0x0D: return '+';
+            default: break;
+        }
+    }
+    switch(sc){
+        case 0x0C: return '-'; // main row '-'
+        case 0x0D: return '=';
+        case 0x34: return '.';
+        case 0x02: return '1'; case 0x03: return '2'; case 0x04: return '3';
+        case 0x05: return '4'; case 0x06: return '5'; case 0x07: return '6';
+        case 0x08: return '7'; case 0x09: return '8'; case 0x0A: return '9';
+        case 0x0B: return '0'; case 0x10: return 'q'; case 0x11: return 'w';
+        case 0x12: return 'e'; case 0x13: return 'r'; case 0x14: return 't';
+        case 0x15: return 'y'; case 0x16: return 'u'; case 0x17: return 'i';
+        case 0x18: return 'o'; case 0x19: return 'p'; case 0x1E: return 'a';
+        case 0x1F: return 's'; case 0x20: return 'd'; case 0x21: return 'f';
+        case 0x22: return 'g'; case 0x23: return 'h'; case 0x24: return 'j';
+        case 0x25: return 'k'; case 0x26: return 'l'; case 0x2C: return 'z';
+        case 0x2D: return 'x'; case 0x2E: return 'c'; case 0x2F: return 'v';
+        case 0x30: return 'b'; case 0x31: return 'n'; case 0x32: return 'm';
+        case 0x39: return ' ';
+        case 0x35: return '/'; case 0x4A: return '-'; case 0x4C: return '+'; // keypad variants
+        case 0x37: return '*';
+        default: return 0;
+    }
+}
+
+// Indexed by scancode
+static const char g_plain[]   = "\0\x1b" "1234567890-=\b\tqwertyuiop[]\n\0asdfghjkl;'`\0\\zxcvbnm,./";
+static const char g_shifted[] = "\0\x1b" "!@#$%^&*()_+\b\tQWERTYUIOP{}\n\0ASDFGHJKL:\"~\0|ZXCVBNM<>?";
+
+int keymap_from_ascii(char c,UINT8* out){
+    if(!c) return 0;
+    if(c=='\r') c='\n';
+    if(c==0x7F) c='\b';
+    if(c==' '){ out[0]=0x39; return 1; }
+    if(c=='*'){ out[0]=0x37; return 1; }           // keypad '*', which needs no Shift
+    for(UINT8 i=1;i<sizeof(g_plain)-1;i++){
+        if(g_plain[i]==c){ out[0]=i; return 1; }
+        if(g_shifted[i]==c){ out[0]=0x2A; out[1]=i; out[2]=0xAA; return 3; }
+    }
+    return 0;
+}
+
+UINT8 keymap_from_vt100(char final,int param){
+    switch(final){
+    case 'A': return 0x48; case 'B': return 0x50;     // arrows
+    case 'C': return 0x4D; case 'D': return 0x4B;
+    case 'H': return 0x47; case 'F': return 0x4F;     // Home, End
+    case 'P': return 0x3B; case 'Q': return 0x3C;     // F1..F4 (ESC O P..S)
+    case 'R': return 0x3D; case 'S': return 0x3E;
+    case '~':
+        switch(param){
+        case 1: case 7: return 0x47;
+        case 4: case 8: return 0x4F;
+        case 3: return 0x53;                          // Delete
+        case 5: return 0x49; case 6: return 0x51;     // PgUp, PgDn
+        case 11: case 12: case 13: case 14: case 15: return (UINT8)(0x3B+param-11);   // F1..F5
+        default: return 0;
+        }
+    default: return 0;
+    }
+}
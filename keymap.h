@@ -0,0 +1,20 @@
+#ifndef _KEYMAP_H_
+#define _KEYMAP_H_
+
+#include "kernel.h"
+
+// ======= US keymap =======
+// Set 1 scancodes to and from ASCII, for the apps and for the serial console.
+// Depends on nothing but kbd_shift(), so it also builds hosted.
+
+// Character for a make code as the apps see it (0 for keys they ignore)
+char scancode_to_ascii(unsigned char sc);
+
+// Scancodes a PC keyboard sends for an ASCII character, with Shift pressed and
+// released around shifted ones; returns how many were written to out[3]
+int keymap_from_ascii(char c,UINT8* out);
+
+// Key for the final byte of "ESC [ param final" or "ESC O final"; 0 if unknown
+UINT8 keymap_from_vt100(char final,int param);
+
+#endif
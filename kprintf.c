@@ -0,0 +1,97 @@
+#include "kernel.h"
+#include "kprintf.h"
+#include "serial.h"
+#include "interrupts.h"
+
+// ======= Formatting =======
+typedef struct {
+    char* buf;
+    int size;
+    int len;
+} Out;
+
+static void outc(Out* o,char c){
+    if(o->len < o->size-1) o->buf[o->len]=c;
+    o->len++;
+}
+
+static void outnum(Out* o,UINT64 v,int base,int upper,int neg,int width,int zero,int left){
+    char tmp[24]; int n=0;
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    if(v==0) tmp[n++]='0';
+    while(v){ tmp[n++]=digits[v%base]; v/=base; }
+    int total = n+neg;
+    if(!left && !zero) for(int i=total;i<width;i++) outc(o,' ');
+    if(neg) outc(o,'-');
+    if(!left && zero) for(int i=total;i<width;i++) outc(o,'0');
+    while(n--) outc(o,tmp[n]);
+    if(left) for(int i=total;i<width;i++) outc(o,' ');
+}
+
+int kvsnprintf(char* buf,int size,const char* fmt,va_list ap){
+    Out o = { buf, size, 0 };
+    for(int i=0;fmt[i];i++){
+        if(fmt[i]!='%'){ outc(&o,fmt[i]); continue; }
+        i++;
+        int zero=0, left=0, width=0, lng=0;
+        for(;;){
+            if(fmt[i]=='0'){ zero=1; i++; }
+            else if(fmt[i]=='-'){ left=1; i++; }
+            else break;
+        }
+        while(fmt[i]>='0' && fmt[i]<='9'){ width=width*10+(fmt[i]-'0'); i++; }
+        while(fmt[i]=='l'){ lng++; i++; }
+        char f=fmt[i];
+        if(f=='\0') break;
+        if(f=='d' || f=='i'){
+            long long v = lng>=2 ? va_arg(ap,long long) : lng==1 ? va_arg(ap,long) : va_arg(ap,int);
+            int neg = v<0;
+            outnum(&o, neg ? (UINT64)(-v) : (UINT64)v, 10, 0, neg, width, zero, left);
+        }else if(f=='u' || f=='x' || f=='X'){
+            UINT64 v = lng>=2 ? va_arg(ap,unsigned long long) : lng==1 ? va_arg(ap,unsigned long) : va_arg(ap,unsigned int);
+            outnum(&o, v, f=='u' ? 10 : 16, f=='X', 0, width, zero, left);
+        }else if(f=='p'){
+            outc(&o,'0'); outc(&o,'x');
+            outnum(&o, (UINT64)(unsigned long)va_arg(ap,void*), 16, 0, 0, 8, 1, 0);
+        }else if(f=='c'){
+            outc(&o,(char)va_arg(ap,int));
+        }else if(f=='s'){
+            const char* s = va_arg(ap,const char*);
+            if(!s) s="(null)";
+            int n=0; while(s[n]) n++;
+            if(!left) for(int k=n;k<width;k++) outc(&o,' ');
+            for(int k=0;k<n;k++) outc(&o,s[k]);
+            if(left) for(int k=n;k<width;k++) outc(&o,' ');
+        }else{
+            outc(&o,f);
+        }
+    }
+    if(o.size>0) o.buf[o.len < o.size ? o.len : o.size-1]='\0';
+    return o.len;
+}
+
+int ksnprintf(char* buf,int size,const char* fmt,...){
+    va_list ap;
+    va_start(ap,fmt);
+    int n = kvsnprintf(buf,size,fmt,ap);
+    va_end(ap);
+    return n;
+}
+
+static int g_targets = KPRINTF_VGA|KPRINTF_SERIAL;
+
+void kprintf_set_targets(int targets){ g_targets = targets; }
+int kprintf_targets(void){ return g_targets; }
+
+void kprintf(const char* fmt,...){
+    char line[256];
+    va_list ap;
+    va_start(ap,fmt);
+    kvsnprintf(line,sizeof(line),fmt,ap);
+    va_end(ap);
+    // One line at a time, even when several threads log at once
+    UINT32 flags = irq_save();
+    if(g_targets & KPRINTF_VGA) console_write(line);
+    if(g_targets & KPRINTF_SERIAL) serial_write(line);
+    irq_restore(flags);
+}
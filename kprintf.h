@@ -0,0 +1,19 @@
+#ifndef _KPRINTF_H_
+#define _KPRINTF_H_
+
+#include <stdarg.h>
+
+// Minimal printf: %d %i %u %x %X %c %s %p %% with optional '0'/'-' flags and width,
+// 'l' and 'll' length modifiers for integers
+int kvsnprintf(char* buf,int size,const char* fmt,va_list ap);
+int ksnprintf(char* buf,int size,const char* fmt,...) __attribute__((format(printf,3,4)));
+
+// Formats into the kernel log (console scrollback, the VGA [L] viewer) and/or
+// COM1, as selected with kprintf_set_targets (both by default)
+#define KPRINTF_VGA 1
+#define KPRINTF_SERIAL 2
+void kprintf(const char* fmt,...) __attribute__((format(printf,1,2)));
+void kprintf_set_targets(int targets);
+int kprintf_targets(void);
+
+#endif
@@ -0,0 +1,312 @@
+#include "kstring.h"
+#include "interrupts.h"
+#include "clock.h"
+#include "heap.h"
+#include "kprintf.h"
+
+// The byte loops below must stay loops: GCC would otherwise turn them back
+// into calls to memcpy and memset, which are these very functions.
+#pragma GCC optimize("no-tree-loop-distribute-patterns")
+
+#define SSE __attribute__((target("sse2")))
+#define ERMS_MIN 2048           // from here on REP MOVSB/STOSB beats the SSE2 loops
+
+// Bulk routines, called for n >= KSTRING_SMALL (cmp and chr for any n)
+typedef struct {
+    const char* name;
+    void (*copy)(UINT8* d,const UINT8* s,UINT32 n);
+    void (*copy_back)(UINT8* d,const UINT8* s,UINT32 n);    // overlapping, d above s
+    void (*fill)(UINT8* d,UINT8 c,UINT32 n);
+    void (*fill16)(UINT16* d,UINT16 v,UINT32 count);
+    void (*fill32)(UINT32* d,UINT32 v,UINT32 count);
+    int (*cmp)(const UINT8* a,const UINT8* b,UINT32 n);
+    const UINT8* (*chr)(const UINT8* p,UINT8 c,UINT32 n);
+} StringOps;
+
+// ======= Scalar and REP variants =======
+static int byte_cmp(const UINT8* a,const UINT8* b,UINT32 n){
+    for(UINT32 i=0;i<n;i++) if(a[i]!=b[i]) return a[i]-b[i];
+    return 0;
+}
+
+static const UINT8* byte_chr(const UINT8* p,UINT8 c,UINT32 n){
+    for(UINT32 i=0;i<n;i++) if(p[i]==c) return p+i;
+    return 0;
+}
+
+static void movsd_copy(UINT8* d,const UINT8* s,UINT32 n){
+    UINT32 words = n>>2;
+    __asm__ volatile("rep movsl; mov %3,%%ecx; rep movsb"
+                     :"+D"(d),"+S"(s),"+c"(words):"r"(n&3):"memory");
+}
+
+static void movsd_fill(UINT8* d,UINT8 c,UINT32 n){
+    UINT32 words = n>>2;
+    __asm__ volatile("rep stosl; mov %3,%%ecx; rep stosb"
+                     :"+D"(d),"+c"(words):"a"(c*0x01010101u),"r"(n&3):"memory");
+}
+
+static void erms_copy(UINT8* d,const UINT8* s,UINT32 n){
+    __asm__ volatile("rep movsb":"+D"(d),"+S"(s),"+c"(n)::"memory");
+}
+
+static void erms_fill(UINT8* d,UINT8 c,UINT32 n){
+    __asm__ volatile("rep stosb":"+D"(d),"+c"(n):"a"(c):"memory");
+}
+
+// Descending copy; isr_common clears DF again for handlers that interrupt it
+static void rep_copy_back(UINT8* d,const UINT8* s,UINT32 n){
+    d += n-1;
+    s += n-1;
+    __asm__ volatile("std; rep movsb; cld":"+D"(d),"+S"(s),"+c"(n)::"memory");
+}
+
+static void rep_fill16(UINT16* d,UINT16 v,UINT32 count){
+    __asm__ volatile("rep stosw":"+D"(d),"+c"(count):"a"(v):"memory");
+}
+
+static void rep_fill32(UINT32* d,UINT32 v,UINT32 count){
+    __asm__ volatile("rep stosl":"+D"(d),"+c"(count):"a"(v):"memory");
+}
+
+// ======= SSE2 variants =======
+// Scalar up to dst's next 16-byte boundary, then 64 bytes per iteration.
+// Each iteration loads all four vectors before storing any, so the forward
+// loop is also correct for overlapping ranges with d below s, and the
+// backward one for d above s.
+static SSE void sse_copy(UINT8* d,const UINT8* s,UINT32 n){
+    while(((unsigned long)d & 15) && n){ *d++ = *s++; n--; }
+    UINT32 blocks = n>>6;
+    if(blocks) __asm__ volatile(
+        "1: movdqu (%1),%%xmm0\n movdqu 16(%1),%%xmm1\n movdqu 32(%1),%%xmm2\n movdqu 48(%1),%%xmm3\n"
+        "   movdqa %%xmm0,(%0)\n movdqa %%xmm1,16(%0)\n movdqa %%xmm2,32(%0)\n movdqa %%xmm3,48(%0)\n"
+        "   add $64,%0\n add $64,%1\n dec %2\n jnz 1b"
+        :"+r"(d),"+r"(s),"+r"(blocks)::"xmm0","xmm1","xmm2","xmm3","memory");
+    n &= 63;
+    while(n--) *d++ = *s++;
+}
+
+static SSE void sse_copy_back(UINT8* d,const UINT8* s,UINT32 n){
+    d += n;
+    s += n;
+    while(((unsigned long)d & 15) && n){ *--d = *--s; n--; }
+    UINT32 blocks = n>>6;
+    if(blocks) __asm__ volatile(
+        "1: sub $64,%0\n sub $64,%1\n"
+        "   movdqu (%1),%%xmm0\n movdqu 16(%1),%%xmm1\n movdqu 32(%1),%%xmm2\n movdqu 48(%1),%%xmm3\n"
+        "   movdqa %%xmm0,(%0)\n movdqa %%xmm1,16(%0)\n movdqa %%xmm2,32(%0)\n movdqa %%xmm3,48(%0)\n"
+        "   dec %2\n jnz 1b"
+        :"+r"(d),"+r"(s),"+r"(blocks)::"xmm0","xmm1","xmm2","xmm3","memory");
+    n &= 63;
+    while(n--) *--d = *--s;
+}
+
+// 64-byte aligned stores of a 32-bit pattern broadcast to all four lanes
+static SSE void sse_store64(UINT8* d,UINT32 pattern,UINT32 blocks){
+    __asm__ volatile(
+        "movd %2,%%xmm0\n pshufd $0,%%xmm0,%%xmm0\n"
+        "1: movdqa %%xmm0,(%0)\n movdqa %%xmm0,16(%0)\n movdqa %%xmm0,32(%0)\n movdqa %%xmm0,48(%0)\n"
+        "   add $64,%0\n dec %1\n jnz 1b"
+        :"+r"(d),"+r"(blocks):"r"(pattern):"xmm0","memory");
+}
+
+static SSE void sse_fill(UINT8* d,UINT8 c,UINT32 n){
+    while(((unsigned long)d & 15) && n){ *d++ = c; n--; }
+    if(n>>6) sse_store64(d,c*0x01010101u,n>>6);
+    d += n & ~63u;
+    n &= 63;
+    while(n--) *d++ = c;
+}
+
+// Cells are 2-byte aligned, so the head loop always reaches a 16-byte boundary
+static SSE void sse_fill16(UINT16* d,UINT16 v,UINT32 count){
+    while(((unsigned long)d & 15) && count){ *d++ = v; count--; }
+    if(count>>5) sse_store64((UINT8*)d,v*0x00010001u,count>>5);
+    d += count & ~31u;
+    count &= 31;
+    while(count--) *d++ = v;
+}
+
+// Pixels are 4-byte aligned, likewise
+static SSE void sse_fill32(UINT32* d,UINT32 v,UINT32 count){
+    while(((unsigned long)d & 15) && count){ *d++ = v; count--; }
+    if(count>>4) sse_store64((UINT8*)d,v,count>>4);
+    d += count & ~15u;
+    count &= 15;
+    while(count--) *d++ = v;
+}
+
+// 16 bytes at a time: PCMPEQB, then PMOVMSKB gives one bit per equal byte
+static SSE int sse_cmp(const UINT8* a,const UINT8* b,UINT32 n){
+    UINT32 i = 0;
+    for(;i+16<=n;i+=16){
+        UINT32 eq;
+        __asm__("movdqu (%1),%%xmm0\n movdqu (%2),%%xmm1\n pcmpeqb %%xmm1,%%xmm0\n pmovmskb %%xmm0,%0"
+                :"=r"(eq):"r"(a+i),"r"(b+i),"m"(*(const UINT8(*)[16])(a+i)),"m"(*(const UINT8(*)[16])(b+i))
+                :"xmm0","xmm1");
+        if(eq!=0xFFFF){
+            i += __builtin_ctz(~eq);
+            return a[i]-b[i];
+        }
+    }
+    return byte_cmp(a+i,b+i,n-i);
+}
+
+static SSE const UINT8* sse_chr(const UINT8* p,UINT8 c,UINT32 n){
+    UINT32 i = 0;
+    for(;i+16<=n;i+=16){
+        UINT32 hit;
+        __asm__("movd %2,%%xmm1\n pshufd $0,%%xmm1,%%xmm1\n movdqu (%1),%%xmm0\n"
+                "pcmpeqb %%xmm1,%%xmm0\n pmovmskb %%xmm0,%0"
+                :"=r"(hit):"r"(p+i),"r"(c*0x01010101u),"m"(*(const UINT8(*)[16])(p+i))
+                :"xmm0","xmm1");
+        if(hit) return p+i+__builtin_ctz(hit);
+    }
+    return byte_chr(p+i,c,n-i);
+}
+
+// Vector loops for short runs, ERMS for long ones
+static SSE void sse_erms_copy(UINT8* d,const UINT8* s,UINT32 n){
+    if(n>=ERMS_MIN) erms_copy(d,s,n);
+    else sse_copy(d,s,n);
+}
+
+static SSE void sse_erms_fill(UINT8* d,UINT8 c,UINT32 n){
+    if(n>=ERMS_MIN) erms_fill(d,c,n);
+    else sse_fill(d,c,n);
+}
+
+// ======= Selection =======
+static const StringOps g_movsd = { "rep movsd", movsd_copy, rep_copy_back, movsd_fill, rep_fill16, rep_fill32, byte_cmp, byte_chr };
+static const StringOps g_erms = { "erms", erms_copy, rep_copy_back, erms_fill, rep_fill16, rep_fill32, byte_cmp, byte_chr };
+static const StringOps g_sse2 = { "sse2", sse_copy, sse_copy_back, sse_fill, sse_fill16, sse_fill32, sse_cmp, sse_chr };
+static const StringOps g_sse2Erms = { "sse2+erms", sse_erms_copy, sse_copy_back, sse_erms_fill, sse_fill16, sse_fill32, sse_cmp, sse_chr };
+
+static const StringOps* g_ops = &g_movsd;       // until kstring_init
+static const StringOps* g_irqOps = &g_movsd;    // never touches XMM registers
+static int g_hasSse2 = 0, g_hasErms = 0;
+
+static inline const StringOps* ops(void){
+    return in_interrupt() ? g_irqOps : g_ops;
+}
+
+void kstring_init(void){
+    UINT32 eax=0, ebx, ecx=0, edx;
+    __asm__ volatile("cpuid":"+a"(eax),"=b"(ebx),"+c"(ecx),"=d"(edx));
+    UINT32 maxLeaf = eax;
+    eax = 1;
+    __asm__ volatile("cpuid":"+a"(eax),"=b"(ebx),"+c"(ecx),"=d"(edx));
+    g_hasSse2 = (edx>>26)&1;
+    if(maxLeaf>=7){
+        eax = 7; ecx = 0;
+        __asm__ volatile("cpuid":"+a"(eax),"=b"(ebx),"+c"(ecx),"=d"(edx));
+        g_hasErms = (ebx>>9)&1;
+    }
+#ifndef HOSTED
+    // boot.S only turns SSE on when the CPU also has FXSAVE
+    UINTPTR cr4;
+    __asm__ volatile("mov %%cr4,%0":"=r"(cr4));
+    if(!(cr4 & 0x200)) g_hasSse2 = 0;
+#endif
+    g_irqOps = g_hasErms ? &g_erms : &g_movsd;
+    g_ops = !g_hasSse2 ? g_irqOps : g_hasErms ? &g_sse2Erms : &g_sse2;
+}
+
+const char* kstring_variant(void){
+    return g_ops->name;
+}
+
+// ======= Entry points =======
+void* kmemcpy(void* dst,const void* src,UINT32 n){
+    UINT8* d = (UINT8*)dst;
+    const UINT8* s = (const UINT8*)src;
+    if(n>=KSTRING_SMALL) ops()->copy(d,s,n);
+    else while(n--) *d++ = *s++;
+    return dst;
+}
+
+void* kmemmove(void* dst,const void* src,UINT32 n){
+    UINT8* d = (UINT8*)dst;
+    const UINT8* s = (const UINT8*)src;
+    if(d<=s || d>=s+n) return kmemcpy(dst,src,n);
+    if(n>=KSTRING_SMALL) ops()->copy_back(d,s,n);
+    else while(n--) d[n] = s[n];
+    return dst;
+}
+
+void* kmemset(void* dst,int c,UINT32 n){
+    UINT8* d = (UINT8*)dst;
+    if(n>=KSTRING_SMALL) ops()->fill(d,(UINT8)c,n);
+    else while(n--) *d++ = (UINT8)c;
+    return dst;
+}
+
+void kmemset16(UINT16* dst,UINT16 v,UINT32 count){
+    if(count>=KSTRING_SMALL/2) ops()->fill16(dst,v,count);
+    else while(count--) *dst++ = v;
+}
+
+void kmemset32(UINT32* dst,UINT32 v,UINT32 count){
+    if(count>=KSTRING_SMALL/4) ops()->fill32(dst,v,count);
+    else while(count--) *dst++ = v;
+}
+
+int kmemcmp(const void* a,const void* b,UINT32 n){
+    return ops()->cmp((const UINT8*)a,(const UINT8*)b,n);
+}
+
+void* kmemchr(const void* p,int c,UINT32 n){
+    return (void*)ops()->chr((const UINT8*)p,(UINT8)c,n);
+}
+
+#ifndef HOSTED
+// GCC emits calls to these for struct copies and large initializers
+void* memcpy(void* dst,const void* src,UINT32 n) __attribute__((alias("kmemcpy")));
+void* memmove(void* dst,const void* src,UINT32 n) __attribute__((alias("kmemmove")));
+void* memset(void* dst,int c,UINT32 n) __attribute__((alias("kmemset")));
+int memcmp(const void* a,const void* b,UINT32 n) __attribute__((alias("kmemcmp")));
+void* memchr(const void* p,int c,UINT32 n) __attribute__((alias("kmemchr")));
+#endif
+
+// ======= Benchmark =======
+#define BENCH_BYTES (4u<<20)    // per size and variant
+#define BENCH_MAX 65536
+
+void kstring_benchmark(void){
+    static const UINT32 sizes[] = { 64, 512, 4096, BENCH_MAX };
+    const StringOps* list[4];
+    int count = 0;
+    list[count++] = &g_movsd;
+    if(g_hasErms) list[count++] = &g_erms;
+    if(g_hasSse2) list[count++] = &g_sse2;
+    if(g_hasSse2 && g_hasErms) list[count++] = &g_sse2Erms;
+
+    UINT8* a = (UINT8*)kmalloc(BENCH_MAX);
+    UINT8* b = (UINT8*)kmalloc(BENCH_MAX);
+    if(!a || !b){
+        kprintf("kstring: out of memory for the benchmark\n");
+        kfree(a);
+        kfree(b);
+        return;
+    }
+    for(UINT32 i=0;i<BENCH_MAX;i++) a[i] = (UINT8)i;
+
+    kprintf("kstring: using %s; MB/s copy / fill\n", g_ops->name);
+    for(UINT32 k=0;k<sizeof(sizes)/sizeof(sizes[0]);k++){
+        UINT32 size = sizes[k], reps = BENCH_BYTES/size;
+        char line[160];
+        int pos = ksnprintf(line,sizeof(line),"kstring: %6u B:",size);
+        for(int v=0;v<count;v++){
+            UINT64 t0 = rdtsc();
+            for(UINT32 r=0;r<reps;r++) list[v]->copy(b,a,size);
+            UINT64 t1 = rdtsc();
+            for(UINT32 r=0;r<reps;r++) list[v]->fill(b,(UINT8)r,size);
+            UINT64 t2 = rdtsc();
+            pos += ksnprintf(line+pos,sizeof(line)-pos,"  %s %llu / %llu",list[v]->name,
+                             per_second(BENCH_BYTES,t1-t0)/1000000,per_second(BENCH_BYTES,t2-t1)/1000000);
+        }
+        kprintf("%s\n", line);
+    }
+    kfree(a);
+    kfree(b);
+}
@@ -0,0 +1,31 @@
+#ifndef _KSTRING_H_
+#define _KSTRING_H_
+
+#include "kernel.h"
+
+// ======= Memory primitives =======
+// Copies and fills of KSTRING_SMALL bytes or more go to the fastest variant
+// the CPU offers, picked by kstring_init() from CPUID: SSE2 (16-byte vector
+// loops), ERMS (REP MOVSB/STOSB) or REP MOVSD. Only threads have their XMM
+// registers saved on a switch, so code running in an interrupt handler always
+// gets a REP variant. The kernel build also exports the standard names
+// (memcpy, memset, memmove, memcmp, memchr) for code GCC emits itself.
+#define KSTRING_SMALL 64
+
+void kstring_init(void);
+const char* kstring_variant(void);
+
+void* kmemcpy(void* dst,const void* src,UINT32 n);
+void* kmemmove(void* dst,const void* src,UINT32 n);
+void* kmemset(void* dst,int c,UINT32 n);
+int kmemcmp(const void* a,const void* b,UINT32 n);
+void* kmemchr(const void* p,int c,UINT32 n);
+
+// Fill count 16-bit cells (VGA text, console lines) or 32-bit pixels
+void kmemset16(UINT16* dst,UINT16 v,UINT32 count);
+void kmemset32(UINT32* dst,UINT32 v,UINT32 count);
+
+// Copy and fill throughput of every variant for a range of sizes, via kprintf
+void kstring_benchmark(void);
+
+#endif
@@ -0,0 +1,291 @@
+#include "memfs.h"
+#include "heap.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "kstring.h"
+
+#define MIN_EXTENT 64
+#define MAX_EXTENT (256*1024)
+#define INITIAL_BUCKETS 64
+
+typedef struct Extent Extent;
+struct Extent {
+    Extent* next;
+    UINT8* data;
+    UINT32 len;          // bytes of file data held here
+    UINT32 cap;
+};
+
+struct MemFile {
+    MemFile* hnext;      // hash chain
+    MemFile* next;       // all-files list, for iteration
+    MemFile* prev;
+    UINT32 hash;
+    UINT32 size;
+    Extent* head;
+    Extent* tail;
+    UINT32 capacity;     // sum of extent capacities
+    Extent* hint;        // last extent touched and the file offset it starts at,
+    UINT32 hintOff;      // so sequential access does not rewalk the chain
+    int borrowed;        // head is a read-only view of memfs_attach() data
+    char name[];
+};
+
+static MemFile** g_buckets = 0;
+static UINT32 g_nbuckets = 0;
+static UINT32 g_count = 0;
+static MemFile* g_all = 0;
+
+// ======= Helpers =======
+static UINT32 name_hash(const char* s){
+    UINT32 h = 2166136261u;                  // FNV-1a
+    for(int i=0;s[i];i++){ h ^= (UINT8)s[i]; h *= 16777619u; }
+    return h;
+}
+
+static int name_eq(const char* a,const char* b){
+    int i=0;
+    for(; a[i] && a[i]==b[i]; i++) {}
+    return a[i]==b[i];
+}
+
+static int rehash(UINT32 nbuckets){
+    MemFile** nb = (MemFile**)kzalloc(nbuckets*sizeof(MemFile*));
+    if(!nb) return 0;
+    for(MemFile* f=g_all; f; f=f->next){
+        UINT32 b = f->hash & (nbuckets-1);
+        f->hnext = nb[b];
+        nb[b] = f;
+    }
+    kfree(g_buckets);
+    g_buckets = nb;
+    g_nbuckets = nbuckets;
+    return 1;
+}
+
+void memfs_init(void){
+    g_count = 0;
+    g_all = 0;
+    rehash(INITIAL_BUCKETS);
+}
+
+// ======= Directory =======
+MemFile* memfs_open(const char* name,int create){
+    if(!name || !name[0] || !g_buckets) return 0;
+    UINT32 h = name_hash(name);
+    for(MemFile* f=g_buckets[h & (g_nbuckets-1)]; f; f=f->hnext){
+        if(f->hash==h && name_eq(f->name,name)) return f;
+    }
+    if(!create) return 0;
+
+    int nlen=0; while(name[nlen]) nlen++;
+    if(nlen>=MEMFS_NAME_MAX) return 0;
+    MemFile* f = (MemFile*)kmalloc(sizeof(MemFile)+nlen+1);
+    if(!f) return 0;
+    kmemcpy(f->name,name,nlen);
+    f->name[nlen] = '\0';
+    f->hash = name_hash(f->name);
+    f->size = 0;
+    f->head = f->tail = f->hint = 0;
+    f->capacity = 0;
+    f->hintOff = 0;
+    f->borrowed = 0;
+    // all-files list
+    f->prev = 0; f->next = g_all;
+    if(g_all) g_all->prev = f;
+    g_all = f;
+    // hash chain; keep chains short by doubling once the load factor passes 2
+    UINT32 b = f->hash & (g_nbuckets-1);
+    f->hnext = g_buckets[b];
+    g_buckets[b] = f;
+    g_count++;
+    if(g_count > g_nbuckets*2) rehash(g_nbuckets*2);
+    return f;
+}
+
+int memfs_delete(const char* name){
+    MemFile* f = memfs_open(name,0);
+    if(!f) return 0;
+    MemFile** pp = &g_buckets[f->hash & (g_nbuckets-1)];
+    while(*pp!=f) pp = &(*pp)->hnext;
+    *pp = f->hnext;
+    if(f->prev) f->prev->next = f->next; else g_all = f->next;
+    if(f->next) f->next->prev = f->prev;
+    memfs_truncate(f,0);
+    kfree(f);
+    g_count--;
+    return 1;
+}
+
+MemFile* memfs_attach(const char* name,const void* data,UINT32 size){
+    MemFile* f = memfs_open(name,1);
+    if(!f || !memfs_truncate(f,0)) return 0;
+    if(!size) return f;
+    // a bare extent header; the data stays where it is and is never freed
+    Extent* e = (Extent*)kmalloc(sizeof(Extent));
+    if(!e) return 0;
+    e->next = 0;
+    e->data = (UINT8*)data;
+    e->len = e->cap = size;
+    f->head = f->tail = e;
+    f->capacity = size;
+    f->size = size;
+    f->borrowed = 1;
+    return f;
+}
+
+int memfs_borrowed(MemFile* f){ return f ? f->borrowed : 0; }
+UINT32 memfs_size(MemFile* f){ return f ? f->size : 0; }
+const char* memfs_name(MemFile* f){ return f ? f->name : 0; }
+UINT32 memfs_count(void){ return g_count; }
+MemFile* memfs_next(MemFile* prev){ return prev ? prev->next : g_all; }
+
+// ======= Extents =======
+static int grow(MemFile* f,UINT32 need){
+    while(f->capacity < need){
+        // next extent: at least the shortfall, otherwise double the file so far
+        UINT32 cap = f->capacity < MIN_EXTENT ? MIN_EXTENT : f->capacity;
+        if(cap > MAX_EXTENT) cap = MAX_EXTENT;
+        if(need-f->capacity > cap) cap = need-f->capacity;
+        if(cap > MAX_EXTENT) cap = MAX_EXTENT;
+        // round so the heap's size class or page run is used completely
+        Extent* e = (Extent*)kmalloc(sizeof(Extent)+cap);
+        if(!e) return 0;
+        e->cap = ksize(e)-sizeof(Extent);
+        e->data = (UINT8*)(e+1);
+        e->len = 0;
+        e->next = 0;
+        if(f->tail) f->tail->next = e; else f->head = e;
+        f->tail = e;
+        f->capacity += e->cap;
+    }
+    return 1;
+}
+
+// Find the extent holding file offset 'off' and the file offset where it starts
+static Extent* locate(MemFile* f,UINT32 off,UINT32* base){
+    Extent* e = f->head; UINT32 b = 0;
+    if(f->hint && off >= f->hintOff){ e = f->hint; b = f->hintOff; }
+    while(e && off >= b+e->cap){ b += e->cap; e = e->next; }
+    if(e){ f->hint = e; f->hintOff = b; }
+    *base = b;
+    return e;
+}
+
+// Walk extents from 'off', copying n bytes in (dir=1) or out (dir=0)
+static void transfer(MemFile* f,UINT32 off,UINT8* buf,UINT32 n,int dir){
+    UINT32 base;
+    Extent* e = locate(f,off,&base);
+    while(n && e){
+        UINT32 in = off-base;
+        UINT32 chunk = e->cap-in; if(chunk>n) chunk=n;
+        if(dir){
+            if(buf) kmemcpy(e->data+in,buf,chunk); else kmemset(e->data+in,0,chunk);
+            if(in+chunk > e->len) e->len = in+chunk;
+        }else{
+            kmemcpy(buf,e->data+in,chunk);
+        }
+        if(buf) buf += chunk;
+        off += chunk; n -= chunk;
+        base += e->cap; e = e->next;
+    }
+}
+
+// First write to an attached file: copy what it still holds onto the heap
+static int unshare(MemFile* f){
+    Extent* view = f->head;
+    UINT32 size = f->size;
+    f->head = f->tail = f->hint = 0;
+    f->capacity = 0; f->hintOff = 0;
+    if(!grow(f,size)){
+        for(Extent* e=f->head; e; ){ Extent* next = e->next; kfree(e); e = next; }
+        f->head = f->tail = view;
+        f->capacity = view->cap;
+        return 0;
+    }
+    f->borrowed = 0;
+    transfer(f,0,view->data,size,1);
+    kfree(view);
+    return 1;
+}
+
+int memfs_read(MemFile* f,UINT32 off,void* buf,UINT32 n){
+    if(!f || off>=f->size) return 0;
+    if(n > f->size-off) n = f->size-off;
+    transfer(f,off,(UINT8*)buf,n,0);
+    return (int)n;
+}
+
+int memfs_write(MemFile* f,UINT32 off,const void* buf,UINT32 n){
+    if(!f) return -1;
+    UINT32 end = off+n;
+    if(end < off || (f->borrowed && !unshare(f)) || !grow(f,end)) return -1;
+    if(off > f->size) transfer(f,f->size,0,off-f->size,1);   // zero the hole
+    transfer(f,off,(UINT8*)buf,n,1);
+    if(end > f->size) f->size = end;
+    return (int)n;
+}
+
+int memfs_append(MemFile* f,const void* buf,UINT32 n){
+    return f ? memfs_write(f,f->size,buf,n) : -1;
+}
+
+int memfs_truncate(MemFile* f,UINT32 size){
+    if(!f) return 0;
+    if(size > f->size) return memfs_write(f,size,"",0)>=0;
+    // keep extents that still hold data, free the rest
+    Extent* e = f->head; Extent* last = 0; UINT32 base = 0;
+    while(e && base < size){ last = e; base += e->cap; e = e->next; }
+    if(last){ last->next = 0; f->tail = last; } else { f->head = f->tail = 0; }
+    while(e){ Extent* next = e->next; f->capacity -= e->cap; kfree(e); e = next; }
+    if(last) last->len = size-(base-last->cap);
+    if(!last) f->borrowed = 0;
+    f->size = size;
+    f->hint = 0; f->hintOff = 0;
+    return 1;
+}
+
+// ======= Whole-file helpers =======
+int memfs_save(const char* name,const char* buf,int len){
+    if(len<0) len=0;
+    MemFile* f = memfs_open(name,1);
+    if(!f) return 0;
+    memfs_truncate(f,0);
+    return memfs_write(f,0,buf,(UINT32)len)==len;
+}
+
+int memfs_load(const char* name,char* out,int maxLen,int* outLen){
+    MemFile* f = memfs_open(name,0);
+    if(!f) return 0;
+    int n = memfs_read(f,0,out,(UINT32)maxLen);
+    if(outLen) *outLen=n;
+    return 1;
+}
+
+// ======= Boot benchmark =======
+#define BENCH_FILES 4096
+
+void memfs_benchmark(void){
+    char name[16];
+    UINT64 t0 = rdtsc();
+    for(int i=0;i<BENCH_FILES;i++){
+        ksnprintf(name,sizeof(name),"bench%d",i);
+        MemFile* f = memfs_open(name,1);
+        memfs_append(f,name,8);
+    }
+    UINT64 t1 = rdtsc();
+    int found=0;
+    for(int i=0;i<BENCH_FILES;i++){
+        ksnprintf(name,sizeof(name),"bench%d",(i*7919)%BENCH_FILES);
+        if(memfs_open(name,0)) found++;
+    }
+    UINT64 t2 = rdtsc();
+    for(int i=0;i<BENCH_FILES;i++){
+        ksnprintf(name,sizeof(name),"bench%d",i);
+        memfs_delete(name);
+    }
+    UINT64 t3 = rdtsc();
+    kprintf("memfs bench (%d files, %u buckets): create %llu/s, lookup %llu/s (%d hits), delete %llu/s\n",
+            BENCH_FILES, g_nbuckets, per_second(BENCH_FILES,t1-t0), per_second(BENCH_FILES,t2-t1),
+            found, per_second(BENCH_FILES,t3-t2));
+}
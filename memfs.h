@@ -0,0 +1,47 @@
+#ifndef _MEMFS_H_
+#define _MEMFS_H_
+
+#include "kernel.h"
+
+// ======= In-memory file store =======
+// Names are looked up through a hash index that grows with the number of files.
+// File data lives in a chain of heap-allocated extents whose sizes grow
+// geometrically, so small files stay small and large ones need few extents.
+#define MEMFS_NAME_MAX 64
+
+typedef struct MemFile MemFile;
+
+void memfs_init(void);
+
+// Look up a file; with create set, make an empty one if it does not exist
+MemFile* memfs_open(const char* name,int create);
+int memfs_delete(const char* name);
+
+// Byte-granular I/O. Writes past the end grow the file (zero-filling any hole).
+// Return the number of bytes transferred, or -1 when memory runs out.
+int memfs_read(MemFile* f,UINT32 off,void* buf,UINT32 n);
+int memfs_write(MemFile* f,UINT32 off,const void* buf,UINT32 n);
+int memfs_append(MemFile* f,const void* buf,UINT32 n);
+int memfs_truncate(MemFile* f,UINT32 size);
+
+// Create (or replace) a file whose contents stay at data, e.g. inside a boot
+// module, which must outlive it. Reads go straight to that memory; the first
+// write copies the file to heap extents.
+MemFile* memfs_attach(const char* name,const void* data,UINT32 size);
+int memfs_borrowed(MemFile* f);      // still a view of attached data
+
+UINT32 memfs_size(MemFile* f);
+const char* memfs_name(MemFile* f);
+UINT32 memfs_count(void);
+
+// Walk all files: pass 0 to get the first, then the previous result
+MemFile* memfs_next(MemFile* prev);
+
+// Whole-file helpers used by the editor
+int memfs_save(const char* name,const char* buf,int len);
+int memfs_load(const char* name,char* out,int maxLen,int* outLen);
+
+// Lookup/create throughput with a few thousand files, logged at boot
+void memfs_benchmark(void);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _MULTIBOOT_H_
+#define _MULTIBOOT_H_
+
+#include "kernel.h"
+
+// Multiboot 1 boot information (see the Multiboot Specification 0.6.96)
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+#define MULTIBOOT_INFO_MEMORY   0x001   // mem_lower/mem_upper valid
+#define MULTIBOOT_INFO_CMDLINE  0x004   // cmdline valid
+#define MULTIBOOT_INFO_MODS     0x008   // mods_count/mods_addr valid
+#define MULTIBOOT_INFO_MEM_MAP  0x040   // mmap_length/mmap_addr valid
+#define MULTIBOOT_INFO_FRAMEBUFFER 0x1000   // framebuffer_* valid
+
+#define MULTIBOOT_FRAMEBUFFER_RGB  1
+#define MULTIBOOT_FRAMEBUFFER_TEXT 2    // EGA text: what gfxpayload=text gives
+
+#define MULTIBOOT_MEMORY_AVAILABLE 1
+
+typedef struct {
+    UINT32 flags;
+    UINT32 mem_lower;        // KiB below 1 MiB
+    UINT32 mem_upper;        // KiB above 1 MiB
+    UINT32 boot_device;
+    UINT32 cmdline;
+    UINT32 mods_count;
+    UINT32 mods_addr;
+    UINT32 syms[4];
+    UINT32 mmap_length;
+    UINT32 mmap_addr;
+    UINT32 drives_length;
+    UINT32 drives_addr;
+    UINT32 config_table;
+    UINT32 boot_loader_name;
+    UINT32 apm_table;
+    UINT32 vbe_control_info;
+    UINT32 vbe_mode_info;
+    UINT16 vbe_mode;
+    UINT16 vbe_interface_seg;
+    UINT16 vbe_interface_off;
+    UINT16 vbe_interface_len;
+    UINT64 framebuffer_addr;
+    UINT32 framebuffer_pitch;
+    UINT32 framebuffer_width;
+    UINT32 framebuffer_height;
+    UINT8  framebuffer_bpp;
+    UINT8  framebuffer_type;
+    // framebuffer_type RGB: bit position and width of each channel
+    UINT8  red_field_position;
+    UINT8  red_mask_size;
+    UINT8  green_field_position;
+    UINT8  green_mask_size;
+    UINT8  blue_field_position;
+    UINT8  blue_mask_size;
+} __attribute__((packed)) multiboot_info_t;
+
+// One entry of the BIOS memory map; 'size' excludes the size field itself
+typedef struct {
+    UINT32 size;
+    UINT64 addr;
+    UINT64 len;
+    UINT32 type;
+} __attribute__((packed)) multiboot_mmap_entry_t;
+
+typedef struct {
+    UINT32 mod_start;
+    UINT32 mod_end;
+    UINT32 cmdline;
+    UINT32 pad;
+} __attribute__((packed)) multiboot_module_t;
+
+#endif
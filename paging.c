@@ -0,0 +1,264 @@
+#include "paging.h"
+#include "pmm.h"
+#include "interrupts.h"
+#include "sched.h"
+#include "kprintf.h"
+
+#define PTE_PRESENT 0x001
+#define PTE_WRITE   0x002
+#define PTE_PWT     0x008
+#define PTE_PCD     0x010
+#define PTE_LARGE   0x080       // in a directory entry: maps a large page directly
+#define PTE_PAT     0x080       // in a PTE: third PAT index bit
+#define PTE_PAT_LARGE 0x1000    // the same bit in a large page
+#define PTE_ADDR    0xFFFFF000u
+
+// Both builds map the low 4 GiB through one directory level over page tables.
+// i386: the page directory, 1024 entries of 4 MiB. x86_64: the four page
+// directories under PDPT[0], back to back so they index like one directory of
+// 2048 entries of 2 MiB.
+#ifdef __x86_64__
+typedef UINT64 PTE;
+#define DIR_SHIFT   21
+#define DIR_ENTRIES 2048
+#define PT_ENTRIES  512
+#else
+typedef UINT32 PTE;
+#define DIR_SHIFT   22
+#define DIR_ENTRIES 1024
+#define PT_ENTRIES  1024
+#endif
+#define LARGE_PAGE  (1u<<DIR_SHIFT)
+#define PT_INDEX(va) (((va)>>12)&(PT_ENTRIES-1))
+
+#define MSR_PAT 0x277
+#define VGA_PAGE (VGA_ADDRESS>>12)
+
+static PTE g_dir[DIR_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+static PTE g_low[PT_ENTRIES] __attribute__((aligned(PAGE_SIZE)));      // first large page
+#ifdef __x86_64__
+static UINT64 g_pml4[512] __attribute__((aligned(PAGE_SIZE)));
+static UINT64 g_pdpt[512] __attribute__((aligned(PAGE_SIZE)));
+#endif
+static int g_pse = 0, g_pat = 0;
+static UINT32 g_slotUsed[STACK_SLOTS/32];
+static UINT32 g_slotSize[STACK_SLOTS];
+
+static inline void invlpg(UINT32 va){ __asm__ volatile("invlpg (%0)"::"r"((UINTPTR)va):"memory"); }
+
+static inline void reload_cr3(void){
+    UINTPTR cr3;
+    __asm__ volatile("mov %%cr3,%0; mov %0,%%cr3":"=r"(cr3)::"memory");
+}
+
+// PCD/PWT/PAT bits for a cache type. The PAT's entry 4 is reprogrammed to
+// write-combining in paging_init, so PAT=1, PCD=PWT=0 selects it.
+static UINT32 cache_bits(UINT32 flags){
+    if(flags & PAGE_WC) return g_pat ? PTE_PAT : PTE_PCD|PTE_PWT;
+    if(flags & PAGE_UNCACHED) return PTE_PCD|PTE_PWT;
+    return 0;
+}
+
+// Page table covering virt. With create, a missing one is allocated and a
+// large page is split into small pages with the same attributes.
+static PTE* table_for(UINT32 virt,int create){
+    PTE* pde = &g_dir[virt>>DIR_SHIFT];
+    if((*pde & PTE_PRESENT) && !(*pde & PTE_LARGE)) return (PTE*)(UINTPTR)(*pde & PTE_ADDR);
+    if(!create) return 0;
+    PTE* t = (PTE*)(UINTPTR)pmm_alloc_page();
+    if(!t) return 0;
+    if(*pde & PTE_PRESENT){
+        UINT32 base = *pde & ~(LARGE_PAGE-1);
+        UINT32 attr = (*pde & (PTE_WRITE|PTE_PWT|PTE_PCD)) | ((*pde & PTE_PAT_LARGE) ? PTE_PAT : 0);
+        for(UINT32 i=0;i<PT_ENTRIES;i++) t[i] = (base + i*PAGE_SIZE) | attr | PTE_PRESENT;
+        *pde = (UINTPTR)t | PTE_PRESENT | PTE_WRITE;
+        reload_cr3();
+    }else{
+        for(UINT32 i=0;i<PT_ENTRIES;i++) t[i] = 0;
+        *pde = (UINTPTR)t | PTE_PRESENT | PTE_WRITE;
+    }
+    return t;
+}
+
+int paging_map(UINT32 virt,UINT32 phys,UINT32 flags){
+    UINT32 irq = irq_save();
+    PTE* t = table_for(virt,1);
+    if(t){
+        t[PT_INDEX(virt)] = (phys & PTE_ADDR) | PTE_PRESENT | (flags & PAGE_WRITE) | cache_bits(flags);
+        invlpg(virt);
+    }
+    irq_restore(irq);
+    return t!=0;
+}
+
+void paging_unmap(UINT32 virt){
+    UINT32 irq = irq_save();
+    PTE* t = table_for(virt,(g_dir[virt>>DIR_SHIFT] & PTE_PRESENT)!=0);
+    if(t){
+        t[PT_INDEX(virt)] = 0;
+        invlpg(virt);
+    }
+    irq_restore(irq);
+}
+
+int paging_translate(UINT32 virt,UINT32* phys){
+    PTE pde = g_dir[virt>>DIR_SHIFT];
+    if(!(pde & PTE_PRESENT)) return 0;
+    if(pde & PTE_LARGE){
+        *phys = (pde & ~(LARGE_PAGE-1)) | (virt & (LARGE_PAGE-1));
+        return 1;
+    }
+    PTE pte = ((PTE*)(UINTPTR)(pde & PTE_ADDR))[PT_INDEX(virt)];
+    if(!(pte & PTE_PRESENT)) return 0;
+    *phys = (pte & PTE_ADDR) | (virt & (PAGE_SIZE-1));
+    return 1;
+}
+
+void* paging_map_mmio(UINT32 phys,UINT32 size,UINT32 flags){
+    UINT32 first = phys & PTE_ADDR;
+    UINT32 last = (phys+size-1) & PTE_ADDR;
+    for(UINT32 a=first;;a+=PAGE_SIZE){
+        if(!paging_map(a,a,flags|PAGE_WRITE)) return 0;
+        if(a==last) break;
+    }
+    return (void*)(UINTPTR)phys;
+}
+
+// ======= Guarded stacks =======
+// Slot n spans STACK_WINDOW + n*STACK_SLOT_SIZE; its stack is mapped at the
+// top and everything below stays unmapped, so running off the end faults.
+static void slot_release(UINT32 slot){
+    UINT32 top = STACK_WINDOW + (slot+1)*STACK_SLOT_SIZE;
+    for(UINT32 a=top-g_slotSize[slot];a<top;a+=PAGE_SIZE){
+        UINT32 p;
+        if(paging_translate(a,&p)) pmm_free_page(p);
+        paging_unmap(a);
+    }
+    g_slotSize[slot] = 0;
+    UINT32 irq = irq_save();
+    g_slotUsed[slot>>5] &= ~(1u<<(slot&31));
+    irq_restore(irq);
+}
+
+void* stack_alloc(UINT32 size){
+    size = (size+PAGE_SIZE-1) & ~(PAGE_SIZE-1);
+    if(!size || size>STACK_SLOT_SIZE-PAGE_SIZE) return 0;
+    UINT32 irq = irq_save();
+    int slot = -1;
+    for(int i=0;i<STACK_SLOTS;i++){
+        if(g_slotUsed[i>>5] & (1u<<(i&31))) continue;
+        g_slotUsed[i>>5] |= 1u<<(i&31);
+        slot = i;
+        break;
+    }
+    irq_restore(irq);
+    if(slot<0) return 0;
+
+    UINT32 top = STACK_WINDOW + (slot+1)*STACK_SLOT_SIZE;
+    g_slotSize[slot] = 0;
+    for(UINT32 a=top-PAGE_SIZE;a>=top-size;a-=PAGE_SIZE){
+        UINT32 p = pmm_alloc_page();
+        if(!p || !paging_map(a,p,PAGE_WRITE)){
+            if(p) pmm_free_page(p);
+            slot_release(slot);
+            return 0;
+        }
+        g_slotSize[slot] = top-a;
+    }
+    return (void*)(UINTPTR)(top-size);
+}
+
+void stack_free(void* base){
+    UINT32 slot = ((UINTPTR)base-STACK_WINDOW)/STACK_SLOT_SIZE;
+    if(base && slot<STACK_SLOTS) slot_release(slot);
+}
+
+void stack_switch(UINT32 size,void (*fn)(void)){
+    UINT8* base = (UINT8*)stack_alloc(size);
+#ifdef __x86_64__
+    if(base) __asm__ volatile("mov %0,%%rsp; call *%1"::"r"(base+size),"r"(fn):"memory");
+#else
+    if(base) __asm__ volatile("mov %0,%%esp; call *%1"::"r"(base+size),"r"(fn):"memory");
+#endif
+    else fn();
+    for(;;) __asm__ volatile("cli; hlt");
+}
+
+// ======= Faults =======
+// Page faults are always fatal. A stack overflow ends as a double fault
+// instead (the CPU can't push the #PF frame), which interrupts.c delivers on
+// a stack of its own; CR2 still holds the address.
+static void fault_report(struct regs* r){
+    UINTPTR cr2;
+    UINT32 phys;
+    __asm__ volatile("mov %%cr2,%0":"=r"(cr2));
+    const char* why = "";
+    if(cr2<PAGE_SIZE) why = " (NULL pointer)";
+    else if(cr2>=STACK_WINDOW && cr2-STACK_WINDOW<STACK_SLOTS*STACK_SLOT_SIZE && !paging_translate(cr2,&phys))
+        why = " (stack overflow into a guard page)";
+    Thread* t = thread_current();
+    char line[80];
+    if(r->int_no==8)
+        ksnprintf(line,sizeof(line),"Double fault, last page fault at %08x%s, thread '%s'",
+                  (UINT32)cr2, why, t ? t->name : "boot");
+    else
+        ksnprintf(line,sizeof(line),"Page fault: %s of %s page %08x%s, thread '%s'",
+                  (r->err_code & 2) ? "write" : "read", (r->err_code & 1) ? "protected" : "unmapped",
+                  (UINT32)cr2, why, t ? t->name : "boot");
+    exception_panic(r,line);
+}
+
+// ======= Setup =======
+void paging_init(void){
+    UINT32 eax=1, ebx, ecx, edx;
+    __asm__ volatile("cpuid":"+a"(eax),"=b"(ebx),"=c"(ecx),"=d"(edx));
+    g_pse = (edx>>3)&1;
+    g_pat = (edx>>16)&1;
+    if(g_pat){
+        // Power-on PAT with entry 4 changed from write-back to write-combining
+        __asm__ volatile("wrmsr"::"c"(MSR_PAT),"a"(0x00070406),"d"(0x00070401));
+    }
+
+    UINT32 limit = pmm_limit();
+    if(limit>STACK_WINDOW){
+        pmm_reserve(STACK_WINDOW,limit-STACK_WINDOW);
+        kprintf("Paging: RAM above %u MiB is not used\n", STACK_WINDOW>>20);
+        limit = STACK_WINDOW;
+    }
+
+    // The first large page in small pages: page 0 stays out, the VGA text page is write-combining
+    for(UINT32 i=1;i<PT_ENTRIES;i++) g_low[i] = (i*PAGE_SIZE) | PTE_PRESENT | PTE_WRITE;
+    g_low[0] = 0;
+    g_low[VGA_PAGE] |= cache_bits(PAGE_WC);
+    g_dir[0] = (UINTPTR)g_low | PTE_PRESENT | PTE_WRITE;
+
+    // The rest of RAM, the kernel image included, in large pages
+    for(UINT32 a=LARGE_PAGE;a<limit;a+=LARGE_PAGE){
+        if(g_pse){ g_dir[a>>DIR_SHIFT] = a | PTE_PRESENT | PTE_WRITE | PTE_LARGE; continue; }
+        PTE* t = table_for(a,1);
+        if(!t){ kprintf("Paging: out of memory for page tables at %u MiB\n", a>>20); break; }
+        for(UINT32 i=0;i<PT_ENTRIES;i++) t[i] = (a + i*PAGE_SIZE) | PTE_PRESENT | PTE_WRITE;
+    }
+
+    irq_register_vector(14,fault_report);
+    irq_register_vector(8,fault_report);
+#ifdef __x86_64__
+    // Long mode is already paging on boot64.S's tables; switch to these
+    for(UINT32 i=0;i<4;i++) g_pdpt[i] = ((UINTPTR)g_dir + i*PAGE_SIZE) | PTE_PRESENT | PTE_WRITE;
+    g_pml4[0] = (UINTPTR)g_pdpt | PTE_PRESENT | PTE_WRITE;
+    __asm__ volatile("mov %0,%%cr3"::"r"((UINTPTR)g_pml4):"memory");
+#else
+    interrupts_set_page_directory((UINTPTR)g_dir);
+    UINT32 cr0, cr4;
+    __asm__ volatile("mov %%cr4,%0":"=r"(cr4));
+    if(g_pse) cr4 |= 0x10;                              // CR4.PSE
+    __asm__ volatile("mov %0,%%cr4"::"r"(cr4));
+    __asm__ volatile("mov %0,%%cr3"::"r"(g_dir):"memory");
+    __asm__ volatile("mov %%cr0,%0":"=r"(cr0));
+    cr0 |= 0x80000000;                                  // CR0.PG
+    __asm__ volatile("mov %0,%%cr0; jmp 1f; 1:"::"r"(cr0):"memory");
+#endif
+
+    kprintf("Paging: %u MiB identity-mapped in %u KiB pages, VGA %s, guard pages at NULL and below stacks\n",
+            limit>>20, g_pse ? LARGE_PAGE>>10 : PAGE_SIZE>>10, g_pat ? "write-combining" : "uncached");
+}
@@ -0,0 +1,42 @@
+#ifndef _PAGING_H_
+#define _PAGING_H_
+
+#include "kernel.h"
+
+// ======= 32-bit paging =======
+// One address space, identity-mapped: virtual == physical for all RAM, so
+// pointers from the PMM and the heap keep working. The first large page (4 MiB
+// on i386, 2 MiB on x86_64) is split into 4 KiB pages (page 0 is left out to
+// catch NULL, and the VGA text page gets its own cache type); everything above
+// uses large pages when the CPU has them. Kernel stacks live in a separate
+// window with an unmapped guard page below each.
+#define PAGE_WRITE      0x002
+#define PAGE_UNCACHED   0x010       // device registers
+#define PAGE_WC         0x1000      // write-combining with PAT, else uncached
+
+#define STACK_WINDOW    0xC0000000u
+#define STACK_SLOTS     256
+#define STACK_SLOT_SIZE 0x10000     // per stack: guard page(s) plus the stack
+
+// Needs pmm_init; turns paging on
+void paging_init(void);
+
+// Map one 4 KiB page (splitting a large page if needed); 1 on success
+int paging_map(UINT32 virt,UINT32 phys,UINT32 flags);
+void paging_unmap(UINT32 virt);
+
+// Physical address behind virt; 0 if not mapped
+int paging_translate(UINT32 virt,UINT32* phys);
+
+// Identity-map a device range (frame buffers, MMIO BARs) page by page
+void* paging_map_mmio(UINT32 phys,UINT32 size,UINT32 flags);
+
+// Kernel stacks of up to STACK_SLOT_SIZE-PAGE_SIZE bytes; returns the lowest
+// usable address (the stack grows down from base+size), 0 when out of slots
+void* stack_alloc(UINT32 size);
+void stack_free(void* base);
+
+// Run fn on a fresh guarded stack of the given size; never returns
+void stack_switch(UINT32 size,void (*fn)(void)) __attribute__((noreturn));
+
+#endif
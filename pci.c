@@ -0,0 +1,46 @@
+#include "pci.h"
+#include "io.h"
+
+static UINT32 pci_addr(int bus,int dev,int fn,int off){
+    return 0x80000000u | ((UINT32)bus<<16) | ((UINT32)dev<<11) | ((UINT32)fn<<8) | (off & 0xFC);
+}
+
+UINT32 pci_read32(int bus,int dev,int fn,int off){
+    outl(0xCF8,pci_addr(bus,dev,fn,off));
+    return inl(0xCFC);
+}
+
+void pci_write32(int bus,int dev,int fn,int off,UINT32 val){
+    outl(0xCF8,pci_addr(bus,dev,fn,off));
+    outl(0xCFC,val);
+}
+
+UINT16 pci_read16(int bus,int dev,int fn,int off){
+    return (UINT16)(pci_read32(bus,dev,fn,off) >> ((off&2)*8));
+}
+
+void pci_write16(int bus,int dev,int fn,int off,UINT16 val){
+    UINT32 v = pci_read32(bus,dev,fn,off);
+    int shift = (off&2)*8;
+    v = (v & ~(0xFFFFu<<shift)) | ((UINT32)val<<shift);
+    pci_write32(bus,dev,fn,off,v);
+}
+
+int pci_find_class(int cls,int subcls,int* bus,int* dev,int* fn){
+    for(int b=0;b<256;b++){
+        for(int d=0;d<32;d++){
+            int fns = 1;
+            for(int f=0;f<fns;f++){
+                UINT32 id = pci_read32(b,d,f,0x00);
+                if((id & 0xFFFF)==0xFFFF) continue;
+                if(f==0 && (pci_read32(b,d,0,0x0C)>>16 & 0x80)) fns = 8;   // multi-function
+                UINT32 cc = pci_read32(b,d,f,0x08);
+                if((int)(cc>>24)==cls && (int)((cc>>16)&0xFF)==subcls){
+                    *bus=b; *dev=d; *fn=f;
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef _PCI_H_
+#define _PCI_H_
+
+#include "kernel.h"
+
+// Legacy configuration mechanism #1 (ports 0xCF8/0xCFC)
+UINT32 pci_read32(int bus,int dev,int fn,int off);
+void pci_write32(int bus,int dev,int fn,int off,UINT32 val);
+UINT16 pci_read16(int bus,int dev,int fn,int off);
+void pci_write16(int bus,int dev,int fn,int off,UINT16 val);
+
+// Find the first function with the given class/subclass; returns 1 if found
+int pci_find_class(int cls,int subcls,int* bus,int* dev,int* fn);
+
+#endif
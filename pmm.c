@@ -0,0 +1,176 @@
+#include "pmm.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "interrupts.h"
+
+// ======= Bitmap page frame allocator =======
+// One bit per 4 KiB frame over the 32-bit physical space, 1 = used. Free runs are
+// found a 32-bit word at a time, starting from a rotating hint so repeated
+// alloc/free pairs do not rescan the low, mostly-reserved part of memory.
+#define MAX_PAGES (1u<<20)
+#define WORDS (MAX_PAGES/32)
+
+extern char _kernel_start[];
+extern char _kernel_end[];
+
+static UINT32 g_bitmap[WORDS];
+static UINT32 g_maxPage = 0;       // one past the highest usable frame
+static UINT32 g_total = 0;
+static UINT32 g_free = 0;
+static UINT32 g_hint = 0;          // word index to start searching from
+
+static int test_bit(UINT32 p){ return (g_bitmap[p>>5]>>(p&31))&1; }
+
+static void set_used(UINT32 p){
+    if(!test_bit(p)){ g_bitmap[p>>5] |= 1u<<(p&31); g_free--; }
+}
+
+static void set_free(UINT32 p){
+    if(test_bit(p)){ g_bitmap[p>>5] &= ~(1u<<(p&31)); g_free++; }
+}
+
+static void free_range(UINT64 addr,UINT64 len){
+    UINT64 first = (addr+PAGE_SIZE-1)/PAGE_SIZE;
+    UINT64 last = (addr+len)/PAGE_SIZE;       // exclusive
+    if(last>MAX_PAGES) last=MAX_PAGES;
+    for(UINT64 p=first;p<last;p++){
+        if(test_bit((UINT32)p)){ set_free((UINT32)p); g_total++; }
+    }
+    if(last>g_maxPage) g_maxPage=(UINT32)last;
+}
+
+void pmm_reserve(UINT32 addr,UINT32 len){
+    if(!len) return;
+    UINT64 first = addr/PAGE_SIZE;
+    UINT64 last = ((UINT64)addr+len+PAGE_SIZE-1)/PAGE_SIZE;
+    if(last>MAX_PAGES) last=MAX_PAGES;
+    for(UINT64 p=first;p<last;p++) set_used((UINT32)p);
+}
+
+void pmm_init(multiboot_info_t* mbi){
+    for(UINT32 i=0;i<WORDS;i++) g_bitmap[i]=0xFFFFFFFF;
+    g_free = 0; g_total = 0; g_maxPage = 0;
+
+    if(mbi && (mbi->flags & MULTIBOOT_INFO_MEM_MAP)){
+        UINT32 p = mbi->mmap_addr, end = mbi->mmap_addr + mbi->mmap_length;
+        while(p < end){
+            multiboot_mmap_entry_t* e = (multiboot_mmap_entry_t*)(UINTPTR)p;
+            if(e->type==MULTIBOOT_MEMORY_AVAILABLE && e->addr < ((UINT64)1<<32)){
+                free_range(e->addr,e->len);
+            }
+            p += e->size + sizeof(e->size);
+        }
+    }else if(mbi && (mbi->flags & MULTIBOOT_INFO_MEMORY)){
+        free_range(0x100000,(UINT64)mbi->mem_upper*1024);
+    }else{
+        free_range(0x100000,15*1024*1024);     // no info: assume the classic 16 MiB
+    }
+
+    // Real-mode area, BIOS data and legacy video/ROM space
+    pmm_reserve(0,0x100000);
+    pmm_reserve((UINTPTR)_kernel_start,(UINT32)(_kernel_end-_kernel_start));
+    if(mbi){
+        pmm_reserve((UINTPTR)mbi,sizeof(*mbi));
+        if(mbi->flags & MULTIBOOT_INFO_MEM_MAP) pmm_reserve(mbi->mmap_addr,mbi->mmap_length);
+        // boot modules (the initrd) are used in place, so they stay reserved
+        if(mbi->flags & MULTIBOOT_INFO_MODS){
+            multiboot_module_t* m = (multiboot_module_t*)(UINTPTR)mbi->mods_addr;
+            pmm_reserve(mbi->mods_addr,mbi->mods_count*sizeof(*m));
+            for(UINT32 i=0;i<mbi->mods_count;i++){
+                pmm_reserve(m[i].mod_start,m[i].mod_end-m[i].mod_start);
+                if(m[i].cmdline) pmm_reserve(m[i].cmdline,1);
+            }
+        }
+    }
+    g_hint = 0;
+}
+
+static UINT32 alloc_one(void){
+    UINT32 words = (g_maxPage+31)/32;
+    for(UINT32 n=0;n<words;n++){
+        UINT32 w = g_hint+n; if(w>=words) w-=words;
+        UINT32 v = g_bitmap[w];
+        if(v==0xFFFFFFFF) continue;
+        UINT32 bit = __builtin_ctz(~v);
+        UINT32 p = w*32+bit;
+        if(p>=g_maxPage) continue;
+        g_bitmap[w] = v | (1u<<bit);
+        g_free--;
+        g_hint = w;
+        return p*PAGE_SIZE;
+    }
+    return 0;
+}
+
+// The public entry points run with interrupts off, since any thread may be
+// preempted halfway through a bitmap update
+UINT32 pmm_alloc_page(void){
+    UINT32 flags = irq_save();
+    UINT32 addr = alloc_one();
+    irq_restore(flags);
+    return addr;
+}
+
+void pmm_free_page(UINT32 addr){
+    UINT32 p = addr/PAGE_SIZE;
+    UINT32 flags = irq_save();
+    if(p<g_maxPage && test_bit(p)){
+        set_free(p);
+        if((p>>5) < g_hint) g_hint = p>>5;
+    }
+    irq_restore(flags);
+}
+
+static UINT32 alloc_run(UINT32 count){
+    UINT32 run=0, start=0;
+    for(UINT32 p=0;p<g_maxPage;p++){
+        // skip fully used words quickly
+        if((p&31)==0 && g_bitmap[p>>5]==0xFFFFFFFF){ run=0; p+=31; continue; }
+        if(test_bit(p)){ run=0; continue; }
+        if(run==0) start=p;
+        if(++run==count){
+            for(UINT32 q=start;q<start+count;q++) set_used(q);
+            return start*PAGE_SIZE;
+        }
+    }
+    return 0;
+}
+
+UINT32 pmm_alloc_pages(UINT32 count){
+    if(count==0) return 0;
+    if(count==1) return pmm_alloc_page();
+    UINT32 flags = irq_save();
+    UINT32 addr = alloc_run(count);
+    irq_restore(flags);
+    return addr;
+}
+
+void pmm_free_pages(UINT32 addr,UINT32 count){
+    for(UINT32 i=0;i<count;i++) pmm_free_page(addr+i*PAGE_SIZE);
+}
+
+UINT32 pmm_total_pages(void){ return g_total; }
+UINT32 pmm_free_count(void){ return g_free; }
+UINT32 pmm_limit(void){ return g_maxPage>=MAX_PAGES ? 0xFFFFF000u : g_maxPage*PAGE_SIZE; }
+
+// ======= Boot benchmark =======
+#define BENCH_PAGES 4096
+
+void pmm_benchmark(void){
+    static UINT32 pages[BENCH_PAGES];
+    UINT32 n = pmm_free_count() < BENCH_PAGES ? pmm_free_count() : BENCH_PAGES;
+    if(n==0) return;
+
+    UINT64 t0 = rdtsc();
+    for(UINT32 i=0;i<n;i++) pages[i]=pmm_alloc_page();
+    UINT64 t1 = rdtsc();
+    for(UINT32 i=0;i<n;i++) pmm_free_page(pages[i]);
+    UINT64 t2 = rdtsc();
+    // interleaved pairs: the common case of short-lived single pages
+    for(UINT32 i=0;i<n;i++) pmm_free_page(pmm_alloc_page());
+    UINT64 t3 = rdtsc();
+
+    kprintf("PMM bench (%u pages): alloc %llu pages/s, free %llu pages/s, pair %llu pairs/s\n",
+            n, per_second(n,t1-t0), per_second(n,t2-t1), per_second(n,t3-t2));
+    kprintf("PMM bench cycles/page: alloc %llu, free %llu\n", (t1-t0)/n, (t2-t1)/n);
+}
@@ -0,0 +1,33 @@
+#ifndef _PMM_H_
+#define _PMM_H_
+
+#include "kernel.h"
+#include "multiboot.h"
+
+#define PAGE_SIZE 4096
+
+// Build the free-page bitmap from the Multiboot memory map (or mem_upper as a
+// fallback) and reserve low memory, the kernel image and the boot info
+void pmm_init(multiboot_info_t* mbi);
+
+// Mark a physical range as in use (e.g. boot modules) before anyone allocates it
+void pmm_reserve(UINT32 addr,UINT32 len);
+
+// Single pages; return the physical address, or 0 when out of memory
+UINT32 pmm_alloc_page(void);
+void pmm_free_page(UINT32 addr);
+
+// Physically contiguous runs (DMA buffers, large heap blocks)
+UINT32 pmm_alloc_pages(UINT32 count);
+void pmm_free_pages(UINT32 addr,UINT32 count);
+
+UINT32 pmm_total_pages(void);
+UINT32 pmm_free_count(void);
+
+// One past the highest usable physical address (what paging has to map)
+UINT32 pmm_limit(void);
+
+// Allocation throughput measured at boot, logged to the console
+void pmm_benchmark(void);
+
+#endif
@@ -1,23 +1,112 @@
 #!/bin/bash
 set -euo pipefail
 
-# Calculator mode: build and run CLI calculator when invoked as: ./run.sh calc
+# Calculator mode: build and run CLI calculator when invoked as:
+#   ./run.sh calc [--bench | --batch [file] [-j threads] | --map EXPR [file] | --jit-bench [EXPR [rows]] | --bignum-bench]
 if [[ "${1:-}" == "calc" ]]; then
-gcc -O2 -Wall -Wextra -o calc calc.c
+gcc -O2 -Wall -Wextra -pthread -o calc calc.c expr.c bignum.c jit.c
 echo "Calculator built: ./calc"
-./calc
+./calc "${@:2}"
 exit 0
 fi
 
-# Assemble and compile (32-bit, freestanding)
-gcc -m32 -c boot.S -o boot.o
-gcc -m32 -c kernel.c -o kernel.o -std=gnu99 -ffreestanding -O2 -Wall -Wextra -fno-pie -fno-stack-protector
+# Hosted mode: the kernel's UI, apps and engines built as a Linux program
+# (host.c supplies the hal.h side) for perf, valgrind and gdb:
+#   ./run.sh host bench | ./run.sh host calc|editor|words|log [KEYS | -]
+# INITRD=initrd.tar mounts an archive the way the kernel mounts its module.
+HOST_SRCS="host.c kstring.c ui.c keymap.c editor.c calculator.c wordgame.c memfs.c initrd.c gfx.c font.c textbuf.c expr.c bignum.c kprintf.c bench.c"
+if [[ "${1:-}" == "host" ]]; then
+gcc -O2 -g -Wall -Wextra -std=gnu99 -DHOSTED -o hosted $HOST_SRCS
+echo "Hosted build: ./hosted"
+./hosted "${@:2}"
+exit $?
+fi
+
+# x86_64 build: ./run.sh x86_64 [headless | bench [save]] builds the long-mode
+# kernel instead (boot64.S, isr64.S, linker64.ld) and runs it under
+# qemu-system-x86_64. It keeps its own benchmark baseline; to compare it with
+# the i386 kernel, point BENCH_BASELINE at that build's file:
+#   ./run.sh bench save && BENCH_BASELINE=bench_baseline.txt ./run.sh x86_64 bench
+ARCH=i386
+if [[ "${1:-}" == "x86_64" ]]; then
+  ARCH=x86_64
+  shift
+fi
 
-# Link with ld to avoid extra sections before the header
-ld -m elf_i386 -T linker.ld -o RunDemo.bin boot.o kernel.o
+# Headless mode: ./run.sh headless boots the serial-console GRUB entry with no
+# display; the kernel log and benchmarks arrive on stdout and stdin acts as the keyboard
+HEADLESS=0
+if [[ "${1:-}" == "headless" ]]; then
+  HEADLESS=1
+fi
+
+# Graphics mode: ./run.sh gfx boots the GRUB entry that keeps the 1024x768
+# frame buffer, so the UI is drawn with the font instead of VGA text
+GFX=0
+if [[ "${1:-}" == "gfx" ]]; then
+  GFX=1
+fi
+
+# Benchmark mode: ./run.sh bench [save] builds the kernel with -DBENCH_BUILD,
+# runs its microbenchmark suite headless until it exits QEMU through
+# isa-debug-exit, and compares cycles/op with bench_baseline.txt ('save', or
+# a missing baseline, records a new one). Slowdowns beyond BENCH_TOLERANCE
+# percent (default 15) make the run fail.
+BENCH=0
+if [[ "${1:-}" == "bench" ]]; then
+  BENCH=1
+  HEADLESS=1
+fi
+
+# Kernel sources (boot.S must stay first so the Multiboot header leads .text)
+ASM_SRCS="boot.S isr.S ap_boot.S"
+C_SRCS="kernel.c kstring.c ui.c keymap.c editor.c calculator.c wordgame.c interrupts.c keyboard.c kprintf.c clock.c pmm.c paging.c div64.c serial.c heap.c memfs.c pci.c blockdev.c ata.c diskfs.c initrd.c gfx.c font.c fb.c bcache.c textbuf.c expr.c bignum.c sched.c acpi.c apic.c smp.c bench.c"
+CFLAGS="-std=gnu99 -ffreestanding -O2 -Wall -Wextra -fno-pie -fno-stack-protector"
+if [[ $BENCH == 1 ]]; then
+  CFLAGS="$CFLAGS -DBENCH_BUILD"
+fi
+KERNEL=RunDemo.bin
+ISO=RunDemo.iso
+QEMU=qemu-system-i386
+BASELINE=${BENCH_BASELINE:-bench_baseline.txt}
+BENCH_LOG=bench_output.txt
+MFLAG=-m32
+OBJ=.o
+if [[ $ARCH == x86_64 ]]; then
+  ASM_SRCS="boot64.S isr64.S ap_boot.S"
+  C_SRCS="${C_SRCS/ div64.c/}"          # 64-bit division is native
+  CFLAGS="$CFLAGS -mno-red-zone"        # interrupts push onto the interrupted stack
+  KERNEL=RunDemo64.bin
+  ISO=RunDemo64.iso
+  QEMU=qemu-system-x86_64
+  BASELINE=${BENCH_BASELINE:-bench_baseline_x86_64.txt}
+  BENCH_LOG=bench_output_x86_64.txt
+  MFLAG=-m64
+  OBJ=.64.o
+fi
+
+# Assemble and compile (freestanding)
+OBJS=""
+for src in $ASM_SRCS; do
+  gcc $MFLAG -c "$src" -o "${src%.S}$OBJ"
+  OBJS="$OBJS ${src%.S}$OBJ"
+done
+for src in $C_SRCS; do
+  gcc $MFLAG -c "$src" -o "${src%.c}$OBJ" $CFLAGS
+  OBJS="$OBJS ${src%.c}$OBJ"
+done
+
+# Link with ld to avoid extra sections before the header. Multiboot loaders
+# take ELF32 only, so the 64-bit image is relabelled (the code is unchanged).
+if [[ $ARCH == x86_64 ]]; then
+  ld -m elf_x86_64 -T linker64.ld -o RunDemo64.elf $OBJS
+  objcopy -O elf32-i386 RunDemo64.elf $KERNEL
+else
+  ld -m elf_i386 -T linker.ld -o $KERNEL $OBJS
+fi
 
 # Verify Multiboot
-if grub-file --is-x86-multiboot RunDemo.bin; then
+if grub-file --is-x86-multiboot $KERNEL; then
   echo "Multiboot: OK"
 else
   echo "Multiboot: FAIL"
@@ -27,10 +116,61 @@ fi
 # Build ISO
 rm -rf isodir
 mkdir -p isodir/boot/grub
-cp RunDemo.bin isodir/boot/RunDemo.bin
+cp $KERNEL     isodir/boot/RunDemo.bin
 cp grub.cfg    isodir/boot/grub/grub.cfg
-grub-mkrescue -o RunDemo.iso isodir
-echo "ISO created: RunDemo.iso"
+# Everything under initrd/ is packed as the boot module and shows up in memfs
+tar --format=ustar --owner=0 --group=0 -cf isodir/boot/initrd.tar -C initrd .
+if [[ $HEADLESS == 1 ]]; then
+  sed -i 's/^set default=0/set default=1/' isodir/boot/grub/grub.cfg
+elif [[ $GFX == 1 ]]; then
+  sed -i 's/^set default=0/set default=2/' isodir/boot/grub/grub.cfg
+fi
+grub-mkrescue -o $ISO isodir
+echo "ISO created: $ISO"
+
+# Persistent disk for memfs (the last 8 MiB are scratch space for the ATA benchmark)
+if [[ ! -f disk.img ]]; then
+  dd if=/dev/zero of=disk.img bs=1M count=64 status=none
+  echo "Disk image created: disk.img"
+fi
+
+# Benchmark suite: results come back on COM1, the exit status from the guest
+if [[ $BENCH == 1 ]]; then
+  set +e
+  timeout 900 $QEMU -cdrom $ISO -boot d -m 64M -smp 4 -monitor none -display none \
+    -serial file:$BENCH_LOG -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+    -drive file=disk.img,format=raw,index=0,media=disk
+  status=$?
+  set -e
+  if [[ $status != 33 ]]; then
+    echo "Benchmark run failed (QEMU exit status $status), log in $BENCH_LOG"
+    exit 1
+  fi
+  RESULTS=$(tr -d '\r' < $BENCH_LOG | awk '$1=="BENCH" {print $2, $4}')
+  if [[ "${2:-}" == "save" || ! -f $BASELINE ]]; then
+    echo "$RESULTS" > $BASELINE
+    echo "Baseline saved: $BASELINE"
+    echo "$RESULTS" | awk '{printf "%-20s %12s cycles/op\n", $1, $2}'
+    exit 0
+  fi
+  echo "$RESULTS" | awk -v tol="${BENCH_TOLERANCE:-15}" '
+    BEGIN { printf "%-20s %12s %12s  (cycles/op)\n", "case", "baseline", "now" }
+    NR==FNR { base[$1]=$2; next }
+    {
+      if(!($1 in base) || base[$1]<=0){ printf "%-20s %12s %12s   (new)\n", $1, "-", $2; next }
+      d = ($2-base[$1])*100/base[$1]
+      flag = d>tol ? "SLOWER" : (d< -tol ? "faster" : "")
+      if(d>tol) bad++
+      printf "%-20s %12s %12s %+7.1f%% %s\n", $1, base[$1], $2, d, flag
+    }
+    END { exit bad>0 }' $BASELINE -
+  exit $?
+fi
 
 # Run in QEMU (BIOS)
-qemu-system-i386 -cdrom RunDemo.iso -boot d -m 64M -monitor none -serial stdio
\ No newline at end of file
+DISPLAY_ARGS=""
+if [[ $HEADLESS == 1 ]]; then
+  DISPLAY_ARGS="-display none"
+fi
+$QEMU -cdrom $ISO -boot d -m 64M -smp 4 -monitor none -serial stdio $DISPLAY_ARGS \
+  -drive file=disk.img,format=raw,index=0,media=disk
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "sched.h"
+#include "clock.h"
+#include "heap.h"
+#include "paging.h"
+#include "kprintf.h"
+
+// ======= State =======
+// Everything below is touched with interrupts disabled: either from an IRQ
+// handler or under irq_save().
+static Thread* g_current = 0;
+static Thread* g_idle = 0;
+static Thread* g_runHead[SCHED_PRIORITIES];
+static Thread* g_runTail[SCHED_PRIORITIES];
+static Thread* g_zombies = 0;           // exited threads whose stacks can go
+static Thread g_bootThread;
+static int g_nextId = 0;
+static int g_needSwitch = 0;
+static UINT64 g_sliceEnd = 0;           // clock tick at which the running thread is preempted
+static int g_fxsr = 0;                  // boot.S turned on CR4.OSFXSR: save XMM registers too
+
+static void rq_push(Thread* t){
+    t->state = THREAD_READY;
+    t->next = 0;
+    if(g_runTail[t->priority]) g_runTail[t->priority]->next = t;
+    else g_runHead[t->priority] = t;
+    g_runTail[t->priority] = t;
+}
+
+static Thread* rq_pop(void){
+    for(int p=0;p<SCHED_PRIORITIES;p++){
+        Thread* t = g_runHead[p];
+        if(!t) continue;
+        g_runHead[p] = t->next;
+        if(!g_runHead[p]) g_runTail[p] = 0;
+        return t;
+    }
+    return 0;
+}
+
+// A fresh x87/SSE state as left by fninit: all exceptions masked, stack empty
+static void fpu_init_image(UINT8* img){
+    for(int i=0;i<512;i++) img[i]=0;
+    img[0]=0x7F; img[1]=0x03;           // control word 0x037F
+    if(g_fxsr){
+        img[24]=0x80; img[25]=0x1F;     // MXCSR 0x1F80; the abridged tag word 0 means empty
+    }else{
+        img[8]=0xFF; img[9]=0xFF;       // tag word: all empty
+    }
+}
+
+// ======= Switching =======
+// Runs at the end of every IRQ and SCHED_VECTOR, on the interrupted thread's
+// stack; the frame it returns is the one isr_common resumes.
+static struct regs* sched_switch(struct regs* r){
+    if(!g_current) return r;
+    if(clock_ticks()>=g_sliceEnd) g_needSwitch = 1;
+    if(!g_needSwitch) return r;
+    g_needSwitch = 0;
+
+    Thread* prev = g_current;
+    if(prev->state==THREAD_RUNNING && prev!=g_idle) rq_push(prev);
+    Thread* next = rq_pop();
+    if(!next) next = g_idle;
+    g_sliceEnd = clock_ticks() + SCHED_SLICE_MS*TICK_HZ/1000;
+    if(next==prev){
+        prev->state = THREAD_RUNNING;
+        return r;
+    }
+
+    prev->frame = r;
+#ifndef __x86_64__
+    // (isr64.S keeps x87/SSE state in the frame itself)
+    if(g_fxsr){
+        __asm__ volatile("fxsave %0":"=m"(prev->fpu));
+        __asm__ volatile("fxrstor %0"::"m"(next->fpu));
+    }else{
+        __asm__ volatile("fnsave %0":"=m"(prev->fpu));
+        __asm__ volatile("frstor %0"::"m"(next->fpu));
+    }
+#endif
+    next->state = THREAD_RUNNING;
+    next->switchesIn++;
+    g_current = next;
+    return next->frame;
+}
+
+static void switch_handler(struct regs* r){
+    (void)r;
+    g_needSwitch = 1;
+}
+
+// Give up the CPU now; the caller has already set its state
+static void switch_now(void){
+    g_needSwitch = 1;
+    __asm__ volatile("int %0"::"i"(SCHED_VECTOR):"memory");
+}
+
+// ======= Threads =======
+static void reap(void){
+    UINT32 flags = irq_save();
+    Thread* z = g_zombies;
+    g_zombies = 0;
+    irq_restore(flags);
+    while(z){
+        Thread* next = z->next;
+        stack_free(z->stack);
+        kfree(z);
+        z = next;
+    }
+}
+
+static void thread_start(void){
+    g_current->entry(g_current->arg);
+    thread_exit();
+}
+
+static void idle_main(void* arg){
+    (void)arg;
+    for(;;){
+        reap();
+        __asm__ volatile("sti; hlt");
+    }
+}
+
+Thread* thread_create(const char* name,void (*entry)(void*),void* arg,int priority){
+    reap();
+    Thread* t = (Thread*)kzalloc(sizeof(Thread));
+    UINT8* stack = t ? (UINT8*)stack_alloc(THREAD_STACK_SIZE) : 0;
+    if(!stack){ kfree(t); return 0; }
+    t->stack = stack;
+    t->name = name;
+    t->entry = entry;
+    t->arg = arg;
+    t->priority = priority<0 ? 0 : priority>=SCHED_PRIORITIES ? SCHED_PRIORITIES-1 : priority;
+
+    // The first switch "returns" from an interrupt into thread_start; the
+    // 16 spare bytes above the frame stand in for its return address
+    struct regs* f = (struct regs*)(stack + THREAD_STACK_SIZE - 16 - sizeof(struct regs));
+    UINT8* raw = (UINT8*)f;
+    for(UINT32 i=0;i<sizeof(struct regs);i++) raw[i]=0;
+    f->cs = KERNEL_CS;
+#ifdef __x86_64__
+    f->rip = (UINTPTR)thread_start;
+    f->rflags = 0x202;                  // IF set
+    f->rsp = (UINTPTR)(stack + THREAD_STACK_SIZE - 8);     // as if thread_start had been called
+    f->ss = KERNEL_DS;
+    fpu_init_image(f->fx);
+#else
+    f->gs = f->fs = f->es = f->ds = KERNEL_DS;
+    f->eip = (UINTPTR)thread_start;
+    f->eflags = 0x202;                  // IF set
+    fpu_init_image(t->fpu);
+#endif
+    t->frame = f;
+
+    UINT32 flags = irq_save();
+    t->id = g_nextId++;
+    if(t->priority!=SCHED_PRIO_IDLE) rq_push(t);    // idle only runs when nothing else can
+    if(g_current && t->priority<g_current->priority) g_needSwitch = 1;
+    irq_restore(flags);
+    return t;
+}
+
+void thread_exit(void){
+    __asm__ volatile("cli");
+    g_current->state = THREAD_DEAD;
+    g_current->next = g_zombies;
+    g_zombies = g_current;
+    switch_now();
+    for(;;) __asm__ volatile("hlt");      // not reached
+}
+
+Thread* thread_current(void){ return g_current; }
+
+void sched_yield(void){
+    if(!g_current) return;
+    UINT32 flags = irq_save();
+    switch_now();
+    irq_restore(flags);
+}
+
+void sched_init(void){
+    UINTPTR cr4;
+    __asm__ volatile("mov %%cr4,%0":"=r"(cr4));
+    g_fxsr = (cr4>>9)&1;
+    Thread* t = &g_bootThread;
+    t->name = "main";
+    t->priority = SCHED_PRIO_UI;
+    t->state = THREAD_RUNNING;
+    t->id = g_nextId++;
+    irq_register_vector(SCHED_VECTOR,switch_handler);
+    irq_set_exit_hook(sched_switch);
+
+    g_idle = thread_create("idle",idle_main,0,SCHED_PRIO_IDLE);
+    UINT32 flags = irq_save();
+    g_sliceEnd = clock_ticks() + SCHED_SLICE_MS*TICK_HZ/1000;
+    g_current = t;
+    irq_restore(flags);
+    kprintf("Scheduler: %u priorities, %u ms slices, %u KiB thread stacks\n",
+            SCHED_PRIORITIES, SCHED_SLICE_MS, THREAD_STACK_SIZE/1024);
+}
+
+// ======= Wait queues =======
+void wait_init(WaitQueue* q){ q->head = q->tail = 0; }
+
+static void wq_remove(WaitQueue* q,Thread* t){
+    Thread* prev = 0;
+    for(Thread* it=q->head; it; prev=it, it=it->next){
+        if(it!=t) continue;
+        if(prev) prev->next = t->next; else q->head = t->next;
+        if(q->tail==t) q->tail = prev;
+        return;
+    }
+}
+
+static void make_ready(Thread* t){
+    t->waitingOn = 0;
+    rq_push(t);
+    if(g_current && t->priority<g_current->priority) g_needSwitch = 1;
+}
+
+// Blocks on q (or on nothing, for q==0) until woken; interrupts are off
+static void block_on(WaitQueue* q){
+    Thread* t = g_current;
+    t->state = THREAD_BLOCKED;
+    t->waitingOn = q;
+    t->next = 0;
+    if(q){
+        if(q->tail) q->tail->next = t; else q->head = t;
+        q->tail = t;
+    }
+    switch_now();
+}
+
+void sched_wait(WaitQueue* q){
+    UINT32 flags = irq_save();
+    if(g_current) block_on(q);
+    else __asm__ volatile("sti; hlt; cli");
+    irq_restore(flags);
+}
+
+static void wait_expired(void* arg){
+    Thread* t = (Thread*)arg;
+    if(t->state!=THREAD_BLOCKED) return;
+    if(t->waitingOn) wq_remove(t->waitingOn,t);
+    t->timedOut = 1;
+    make_ready(t);
+}
+
+int sched_wait_timeout(WaitQueue* q,UINT32 ms){
+    UINT32 flags = irq_save();
+    int ok = 1;
+    if(g_current){
+        Timer timer; timer.armed = 0;
+        g_current->timedOut = 0;
+        timer_start(&timer,ms,wait_expired,g_current);
+        block_on(q);
+        timer_cancel(&timer);
+        ok = !g_current->timedOut;
+    }else{
+        __asm__ volatile("sti; hlt; cli");
+    }
+    irq_restore(flags);
+    return ok;
+}
+
+void sched_wake_one(WaitQueue* q){
+    UINT32 flags = irq_save();
+    Thread* t = q->head;
+    if(t){
+        q->head = t->next;
+        if(!q->head) q->tail = 0;
+        make_ready(t);
+    }
+    irq_restore(flags);
+}
+
+void sched_wake_all(WaitQueue* q){
+    UINT32 flags = irq_save();
+    while(q->head){
+        Thread* t = q->head;
+        q->head = t->next;
+        make_ready(t);
+    }
+    q->tail = 0;
+    irq_restore(flags);
+}
+
+void sched_sleep_ms(UINT32 ms){
+    if(!g_current){ sleep_ms(ms); return; }
+    sched_wait_timeout(0,ms);
+}
+
+// ======= Mutex =======
+void mutex_init(Mutex* m){ m->owner = 0; wait_init(&m->waiters); }
+
+void mutex_lock(Mutex* m){
+    UINT32 flags = irq_save();
+    while(m->owner) sched_wait(&m->waiters);
+    m->owner = g_current;
+    irq_restore(flags);
+}
+
+void mutex_unlock(Mutex* m){
+    UINT32 flags = irq_save();
+    m->owner = 0;
+    sched_wake_one(&m->waiters);
+    irq_restore(flags);
+}
+
+// ======= Benchmark =======
+// Two threads at the same priority hand the CPU back and forth, first by
+// yielding and then through a pair of wait queues; each hand-off is one switch.
+#define BENCH_ROUNDS 2000
+
+typedef struct {
+    WaitQueue q[2];
+    WaitQueue done;
+    volatile int turn, finished, useQueues;
+    UINT64 start, end;
+} SwitchBench;
+
+static void bench_side(SwitchBench* b,int me){
+    if(me==0) b->start = rdtsc();
+    for(int i=0;i<BENCH_ROUNDS;i++){
+        if(!b->useQueues){ sched_yield(); continue; }
+        UINT32 flags = irq_save();
+        while(b->turn!=me) sched_wait(&b->q[me]);
+        b->turn = !me;
+        sched_wake_one(&b->q[!me]);
+        irq_restore(flags);
+    }
+    UINT32 flags = irq_save();
+    if(++b->finished==2){
+        b->end = rdtsc();
+        sched_wake_all(&b->done);
+    }
+    irq_restore(flags);
+}
+
+static void bench_a(void* arg){ bench_side((SwitchBench*)arg,0); }
+static void bench_b(void* arg){ bench_side((SwitchBench*)arg,1); }
+
+static UINT64 bench_run(SwitchBench* b,int useQueues){
+    wait_init(&b->q[0]); wait_init(&b->q[1]); wait_init(&b->done);
+    b->turn = 0; b->finished = 0; b->useQueues = useQueues;
+    // Below main, so neither starts until main blocks on 'done'
+    if(!thread_create("bench-a",bench_a,b,SCHED_PRIO_NORMAL) ||
+       !thread_create("bench-b",bench_b,b,SCHED_PRIO_NORMAL)) return 0;
+    UINT32 flags = irq_save();
+    while(b->finished<2) sched_wait(&b->done);
+    irq_restore(flags);
+    return (b->end-b->start)/(2*BENCH_ROUNDS);
+}
+
+void sched_benchmark(void){
+    SwitchBench b;
+    UINT64 yield = bench_run(&b,0);
+    UINT64 wake = bench_run(&b,1);
+    kprintf("Sched bench: %llu cycles per yield switch, %llu cycles per wait/wake hand-off (%llu ns)\n",
+            yield, wake, cycles_to_ns(wake));
+}
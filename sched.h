@@ -0,0 +1,80 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include "kernel.h"
+#include "interrupts.h"
+
+// ======= Kernel threads =======
+// Preemptive round robin within strict priority levels. A switch is nothing
+// more than returning a different saved struct regs from isr_dispatch: IRQ0
+// ends a time slice, and a thread that yields or blocks raises SCHED_VECTOR
+// to get the same treatment. The boot code becomes thread 0 ("main") and keeps
+// its stack; every other thread gets a guarded one from stack_alloc (paging.h).
+#define SCHED_VECTOR 48             // int $48: switch now
+#define SCHED_PRIORITIES 4
+#define SCHED_PRIO_UI 0             // highest: the thread reading the keyboard
+#define SCHED_PRIO_NORMAL 1
+#define SCHED_PRIO_BACKGROUND 2
+#define SCHED_PRIO_IDLE 3           // only the idle thread
+#define SCHED_SLICE_MS 10
+#define THREAD_STACK_SIZE 16384
+
+typedef enum { THREAD_READY, THREAD_RUNNING, THREAD_BLOCKED, THREAD_DEAD } ThreadState;
+
+struct WaitQueue;
+
+typedef struct Thread {
+    struct regs* frame;             // saved context while switched out
+    UINT8* stack;                   // 0 for the boot thread
+    const char* name;
+    int id, priority;
+    ThreadState state;
+    void (*entry)(void* arg);
+    void* arg;
+    struct Thread* next;            // run queue, wait queue or zombie list
+    struct WaitQueue* waitingOn;
+    int timedOut;
+    UINT32 switchesIn;
+#ifndef __x86_64__
+    UINT8 fpu[512] __attribute__((aligned(16)));   // x87/SSE state (fxsave or fnsave image)
+#endif
+} Thread;
+
+typedef struct WaitQueue {
+    Thread* head;
+    Thread* tail;
+} WaitQueue;
+
+// Needs the heap and paging. Turns the caller into thread 0 at SCHED_PRIO_UI.
+void sched_init(void);
+
+Thread* thread_create(const char* name,void (*entry)(void*),void* arg,int priority);
+void thread_exit(void);
+Thread* thread_current(void);
+void sched_yield(void);
+
+// Blocking. Check the condition and call sched_wait with interrupts disabled
+// (irq_save), so a wake-up from an IRQ can't slip in between:
+//     UINT32 f=irq_save(); while(!ready) sched_wait(&q); irq_restore(f);
+// Before sched_init these just halt until the next interrupt.
+void wait_init(WaitQueue* q);
+void sched_wait(WaitQueue* q);
+int sched_wait_timeout(WaitQueue* q,UINT32 ms);   // 0 if the time ran out
+void sched_wake_one(WaitQueue* q);                // safe from IRQ handlers
+void sched_wake_all(WaitQueue* q);
+void sched_sleep_ms(UINT32 ms);
+
+// Sleeping lock for thread context only
+typedef struct {
+    Thread* owner;
+    WaitQueue waiters;
+} Mutex;
+
+void mutex_init(Mutex* m);
+void mutex_lock(Mutex* m);
+void mutex_unlock(Mutex* m);
+
+// Context-switch latency in cycles, written with kprintf
+void sched_benchmark(void);
+
+#endif
@@ -0,0 +1,148 @@
+#include "serial.h"
+#include "interrupts.h"
+#include "io.h"
+
+#define COM1 0x3F8
+#define UART_FIFO 16
+
+// Registers (offsets from COM1)
+#define REG_DATA 0
+#define REG_IER  1
+#define REG_IIR  2
+#define REG_FCR  2
+#define REG_LCR  3
+#define REG_MCR  4
+#define REG_LSR  5
+#define REG_MSR  6
+
+#define LSR_DATA  0x01
+#define LSR_OVERRUN 0x02
+#define LSR_THRE  0x20
+#define IER_RX    0x01
+#define IER_THRE  0x02
+
+static int g_serialOk = 0;
+static int g_irqMode = 0;
+static volatile int g_txBusy = 0;      // bytes in the FIFO, and a THRE interrupt will follow
+
+// Free-running counters masked on access, like the keyboard ring. All
+// updates happen with interrupts off, from writers or from IRQ4.
+static char g_tx[SERIAL_TX_RING];
+static volatile UINT32 g_txHead = 0, g_txTail = 0;
+static volatile char g_rx[SERIAL_RX_RING];
+static volatile UINT32 g_rxHead = 0, g_rxTail = 0;
+static void (*g_rxHandler)(char c) = 0;
+static SerialStats g_stats;
+
+void serial_init(void){
+    outb(COM1+REG_IER,0x00);    // no interrupts yet
+    outb(COM1+REG_LCR,0x80);    // DLAB on
+    outb(COM1+REG_DATA,0x01);   // divisor 1 = 115200 baud
+    outb(COM1+REG_IER,0x00);
+    outb(COM1+REG_LCR,0x03);    // 8N1, DLAB off
+    outb(COM1+REG_FCR,0xC7);    // enable and clear FIFOs, 14-byte threshold
+    outb(COM1+REG_MCR,0x0B);    // DTR, RTS, OUT2 (routes the IRQ to the PIC)
+    // A floating bus reads 0xFF: no UART, stay silent instead of spinning
+    g_serialOk = inb(COM1+REG_LSR)!=0xFF;
+}
+
+// Refill the hardware FIFO once the transmitter has emptied it
+static void tx_kick(void){
+    if(!(inb(COM1+REG_LSR)&LSR_THRE)) return;
+    int n=0;
+    for(;n<UART_FIFO && g_txTail!=g_txHead;n++){
+        outb(COM1+REG_DATA,(UINT8)g_tx[g_txTail & (SERIAL_TX_RING-1)]);
+        g_txTail++;
+    }
+    g_txBusy = n && g_irqMode;
+}
+
+static void rx_drain(void){
+    UINT8 lsr;
+    while((lsr=inb(COM1+REG_LSR)) & LSR_DATA){
+        char c = (char)inb(COM1+REG_DATA);
+        if(lsr & LSR_OVERRUN) g_stats.rxDropped++;
+        g_stats.rxBytes++;
+        if(g_rxHandler){ g_rxHandler(c); continue; }
+        if(g_rxHead - g_rxTail >= SERIAL_RX_RING){ g_stats.rxDropped++; continue; }
+        g_rx[g_rxHead & (SERIAL_RX_RING-1)] = c;
+        g_rxHead++;
+    }
+}
+
+static void serial_irq(struct regs* r){
+    (void)r;
+    // IIR bit 0 clear means an interrupt is pending; reading the source clears it
+    for(int guard=0;guard<16;guard++){
+        UINT8 iir = inb(COM1+REG_IIR);
+        if(iir & 1) break;
+        switch((iir>>1)&7){
+        case 1: tx_kick(); break;               // THR empty
+        case 2: case 6: rx_drain(); break;      // data ready, FIFO timeout
+        case 3: (void)inb(COM1+REG_LSR); break; // line status
+        default: (void)inb(COM1+REG_MSR); break;
+        }
+    }
+}
+
+void serial_start_irq(void){
+    if(!g_serialOk) return;
+    irq_register(4,serial_irq);
+    outb(COM1+REG_IER,IER_RX|IER_THRE);
+    g_irqMode = 1;
+    UINT32 flags = irq_save();
+    tx_kick();
+    irq_restore(flags);
+}
+
+void serial_putc(char c){
+    if(!g_serialOk) return;
+    UINT32 flags = irq_save();
+    // Full ring (or no IRQ yet to drain it): push bytes out by polling
+    while(g_txHead - g_txTail >= SERIAL_TX_RING){
+        g_stats.txStalls++;
+        while(!(inb(COM1+REG_LSR)&LSR_THRE)) {}
+        tx_kick();
+    }
+    g_tx[g_txHead & (SERIAL_TX_RING-1)] = c;
+    g_txHead++;
+    g_stats.txBytes++;
+    if(!g_txBusy) tx_kick();    // otherwise the next THRE interrupt picks it up
+    irq_restore(flags);
+}
+
+void serial_write(const char* s){
+    for(int i=0;s[i];i++){
+        if(s[i]=='\n') serial_putc('\r');
+        serial_putc(s[i]);
+    }
+}
+
+void serial_flush(void){
+    if(!g_serialOk) return;
+    for(;;){
+        UINT32 flags = irq_save();
+        tx_kick();
+        int empty = g_txHead==g_txTail && (inb(COM1+REG_LSR)&0x40);   // transmitter idle
+        irq_restore(flags);
+        if(empty) return;
+        __asm__ volatile("pause");
+    }
+}
+
+void serial_set_rx_handler(void (*handler)(char c)){ g_rxHandler = handler; }
+
+int serial_read(char* c){
+    if(!g_irqMode){
+        UINT32 flags = irq_save();
+        if(g_serialOk) rx_drain();
+        irq_restore(flags);
+    }
+    if(g_rxTail == g_rxHead) return 0;
+    *c = g_rx[g_rxTail & (SERIAL_RX_RING-1)];
+    __asm__ volatile("":::"memory");
+    g_rxTail++;
+    return 1;
+}
+
+const SerialStats* serial_stats(void){ return &g_stats; }
@@ -0,0 +1,39 @@
+#ifndef _SERIAL_H_
+#define _SERIAL_H_
+
+#include "kernel.h"
+
+// ======= COM1 16550 UART =======
+// 115200 8N1; QEMU's -serial stdio shows it on the host terminal. Output goes
+// through a TX ring that the UART drains 16 bytes per THR-empty interrupt, so
+// writers only copy bytes; received bytes go to a handler or an RX ring.
+#define SERIAL_TX_RING 8192      // powers of two
+#define SERIAL_RX_RING 256
+
+// Polled setup; usable right away (output is pushed out by later writes)
+void serial_init(void);
+
+// Switch to interrupt-driven TX/RX on IRQ4; needs interrupts_init() first
+void serial_start_irq(void);
+
+void serial_putc(char c);
+void serial_write(const char* s);   // translates '\n' to "\r\n"
+
+// Wait until everything queued has left the UART
+void serial_flush(void);
+
+// Received bytes: passed to the handler (from IRQ4, interrupts off) if one is
+// set, otherwise queued for serial_read
+void serial_set_rx_handler(void (*handler)(char c));
+int serial_read(char* c);           // non-blocking; 1 if a byte was read
+
+typedef struct {
+    UINT32 txBytes;
+    UINT32 txStalls;      // writes that found the TX ring full and had to poll
+    UINT32 rxBytes;
+    UINT32 rxDropped;     // RX ring full or UART overrun
+} SerialStats;
+
+const SerialStats* serial_stats(void);
+
+#endif
@@ -0,0 +1,314 @@
+#include "smp.h"
+#include "acpi.h"
+#include "apic.h"
+#include "interrupts.h"
+#include "paging.h"
+#include "kstring.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "expr.h"
+
+#define AP_TRAMPOLINE 0x8000        // ap_boot.S's AT() uses the same address
+#define AP_STACK_SIZE 16384
+#define DEQUE_SIZE 256              // jobs queued per CPU
+#define MSR_PAT 0x277
+#define AP_ARRIVED 0x100            // g_expect once the awaited CPU checked in
+#define AP_NONE 0x200               // ...when no CPU is awaited
+
+// ap_boot.S's ap_boot_data, in the copy at AP_TRAMPOLINE
+typedef struct {
+    UINT32 cr0, cr3, cr4, pad;
+    UINT64 stack;
+    UINT64 entry;
+} ApBootData;
+
+extern const UINT8 ap_trampoline[], ap_trampoline_end[], ap_boot_data[];
+
+// One CPU's jobs. The owner works at the bottom, thieves take the oldest job
+// from the top; each deque has a cache line to itself.
+typedef struct {
+    volatile UINT32 lock;
+    UINT32 top, bottom;             // free-running; top==bottom when empty
+    UINT32 ran, stolen;
+    Job* slot[DEQUE_SIZE];
+} __attribute__((aligned(64))) Deque;
+
+static Deque g_deque[ACPI_MAX_CPUS];
+static UINT8 g_apicId[ACPI_MAX_CPUS];
+static int g_cpus = 1;
+static volatile int g_workers = 1;              // CPUs below this index take jobs
+static volatile UINT32 g_work __attribute__((aligned(64))) = 0;   // bumped on every push; idle CPUs MWAIT on it
+static volatile UINT32 g_expect = AP_NONE;      // APIC ID of the CPU being started
+static int g_mwait = 0;
+static UINT32 g_patLo = 0, g_patHi = 0;         // 0 if the CPU has no PAT
+
+static inline void cpu_relax(void){ __asm__ volatile("pause":::"memory"); }
+
+static inline UINT32 xchg32(volatile UINT32* p,UINT32 v){
+    __asm__ volatile("xchgl %0,%1":"+r"(v),"+m"(*p)::"memory");
+    return v;
+}
+
+static inline UINT32 fetch_add32(volatile UINT32* p,UINT32 v){
+    __asm__ volatile("lock xaddl %0,%1":"+r"(v),"+m"(*p)::"memory");
+    return v;
+}
+
+// Returns the previous value; *p became v if that was old
+static inline UINT32 cmpxchg32(volatile UINT32* p,UINT32 old,UINT32 v){
+    __asm__ volatile("lock cmpxchgl %2,%1":"+a"(old),"+m"(*p):"r"(v):"memory");
+    return old;
+}
+
+int smp_cpu_count(void){ return g_cpus; }
+
+int smp_cpu_index(void){
+    if(g_cpus<2) return 0;
+    UINT8 id = lapic_id();
+    for(int i=0;i<g_cpus;i++) if(g_apicId[i]==id) return i;
+    return 0;
+}
+
+// ======= Deques =======
+// Interrupts stay off while a lock is held, so the boot CPU can't be switched
+// to another thread that spins on the same lock
+static UINT32 deque_lock(Deque* d){
+    UINT32 f = irq_save();
+    while(xchg32(&d->lock,1))
+        while(d->lock) cpu_relax();
+    return f;
+}
+
+static void deque_unlock(Deque* d,UINT32 f){
+    xchg32(&d->lock,0);
+    irq_restore(f);
+}
+
+static int deque_push(Deque* d,Job* j){
+    UINT32 f = deque_lock(d);
+    int ok = d->bottom-d->top < DEQUE_SIZE;
+    if(ok) d->slot[d->bottom++ % DEQUE_SIZE] = j;
+    deque_unlock(d,f);
+    return ok;
+}
+
+static Job* deque_pop(Deque* d){
+    Job* j = 0;
+    UINT32 f = deque_lock(d);
+    if(d->bottom!=d->top) j = d->slot[--d->bottom % DEQUE_SIZE];
+    deque_unlock(d,f);
+    return j;
+}
+
+static Job* deque_steal(Deque* d){
+    Job* j = 0;
+    if(d->top==d->bottom) return 0;     // unlocked peek: skip empty victims cheaply
+    UINT32 f = deque_lock(d);
+    if(d->bottom!=d->top) j = d->slot[d->top++ % DEQUE_SIZE];
+    deque_unlock(d,f);
+    return j;
+}
+
+// Our own newest job, else the oldest one of the next busy CPU
+static Job* take(int me){
+    Job* j = deque_pop(&g_deque[me]);
+    if(j) return j;
+    int n = g_workers;
+    for(int i=1;i<n;i++){
+        int v = (me+i) % n;
+        j = deque_steal(&g_deque[v]);
+        if(j){ g_deque[me].stolen++; return j; }
+    }
+    return 0;
+}
+
+// The Job may be gone as soon as pending drops, so the group is read first
+static void run(int me,Job* j){
+    JobGroup* g = j->group;
+    j->fn(j->arg);
+    g_deque[me].ran++;
+    fetch_add32(&g->pending,(UINT32)-1);
+}
+
+// ======= Jobs =======
+void job_group_init(JobGroup* g){ g->pending = 0; }
+
+void job_submit(JobGroup* g,Job* j,void (*fn)(void*),void* arg){
+    j->fn = fn;
+    j->arg = arg;
+    j->group = g;
+    fetch_add32(&g->pending,1);
+    int me = smp_cpu_index();
+    if(!deque_push(&g_deque[me],j)){ run(me,j); return; }
+    fetch_add32(&g_work,1);
+}
+
+void job_wait(JobGroup* g){
+    while(g->pending){
+        int me = smp_cpu_index();
+        Job* j = take(me);
+        if(j) run(me,j);
+        else cpu_relax();
+    }
+}
+
+// ======= The other CPUs =======
+static void idle(UINT32 seen){
+    if(g_mwait){
+        __asm__ volatile("monitor"::"a"((UINTPTR)&g_work),"c"(0),"d"(0));
+        if(g_work==seen) __asm__ volatile("mwait"::"a"(0),"c"(0));
+    }else{
+        cpu_relax();
+    }
+}
+
+// Called by ap_boot.S on the stack smp_init gave this CPU, interrupts off.
+// A CPU that answers after smp_init gave up on it finds g_expect changed and
+// parks for good without touching anything shared.
+static void ap_main(void){
+    UINT32 id = lapic_id();
+    if(cmpxchg32(&g_expect,id,AP_ARRIVED)!=id)
+        for(;;) __asm__ volatile("cli; hlt");
+    interrupts_init_ap();
+    if(g_patLo|g_patHi) __asm__ volatile("wrmsr"::"c"(MSR_PAT),"a"(g_patLo),"d"(g_patHi));
+    __asm__ volatile("fninit");
+    lapic_enable();
+    int me = smp_cpu_index();
+    for(;;){
+        UINT32 seen = g_work;
+        Job* j = me<g_workers ? take(me) : 0;
+        if(j) run(me,j);
+        else idle(seen);
+    }
+}
+
+static void delay_ns(UINT64 ns){
+    UINT64 end = now_ns()+ns;
+    while(now_ns()<end) cpu_relax();
+}
+
+static int wait_arrived(UINT64 ns){
+    UINT64 end = now_ns()+ns;
+    while(g_expect!=AP_ARRIVED)
+        if(now_ns()>end) return 0;
+    return 1;
+}
+
+// INIT, then STARTUP twice if the first one isn't answered, as Intel's MP
+// specification has it. On a timeout the stack stays allocated: the CPU may
+// still come up late and park on it.
+static int start_cpu(ApBootData* boot,UINT8 apicId){
+    void* stack = stack_alloc(AP_STACK_SIZE);
+    if(!stack) return 0;
+    boot->stack = (UINTPTR)stack + AP_STACK_SIZE;
+    g_expect = apicId;
+    lapic_send_init(apicId);
+    delay_ns(10000000ull);                  // 10 ms
+    for(int tries=0;tries<2;tries++){
+        lapic_send_startup(apicId,AP_TRAMPOLINE);
+        if(wait_arrived(tries ? 100000000ull : 1000000ull)) return 1;
+    }
+    // withdraw the slot, unless the CPU took it in the meantime
+    return cmpxchg32(&g_expect,apicId,AP_NONE)==AP_ARRIVED;
+}
+
+int smp_init(void){
+    if(!acpi_init()) return 1;
+    const AcpiMadt* m = acpi_madt();
+    if(m->cpus<2) return 1;
+    if(!apic_init(m)) return 1;
+
+    UINT32 eax=1, ebx, ecx=0, edx;
+    __asm__ volatile("cpuid":"+a"(eax),"=b"(ebx),"+c"(ecx),"=d"(edx));
+    g_mwait = (ecx>>3)&1;
+    if((edx>>16)&1) __asm__ volatile("rdmsr":"=a"(g_patLo),"=d"(g_patHi):"c"(MSR_PAT));
+
+    UINT32 size = (UINT32)(ap_trampoline_end-ap_trampoline);
+    kmemcpy((void*)(UINTPTR)AP_TRAMPOLINE,ap_trampoline,size);
+    ApBootData* boot = (ApBootData*)(UINTPTR)(AP_TRAMPOLINE + (ap_boot_data-ap_trampoline));
+    UINTPTR cr;
+    __asm__ volatile("mov %%cr0,%0":"=r"(cr)); boot->cr0 = (UINT32)cr;
+    __asm__ volatile("mov %%cr3,%0":"=r"(cr)); boot->cr3 = (UINT32)cr;
+    __asm__ volatile("mov %%cr4,%0":"=r"(cr)); boot->cr4 = (UINT32)cr;
+    boot->entry = (UINTPTR)ap_main;
+
+    UINT8 self = lapic_id();
+    g_apicId[0] = self;
+    int cpus = 1;
+    for(int i=0;i<m->cpus;i++){
+        if(m->apicId[i]==self) continue;
+        // smp_cpu_index must know this CPU before it asks
+        g_apicId[cpus] = m->apicId[i];
+        g_cpus = cpus+1;
+        if(!start_cpu(boot,m->apicId[i])){
+            // it may still be in the trampoline, reading ap_boot_data: starting
+            // another CPU would hand both the same stack
+            g_cpus = cpus;
+            kprintf("SMP: CPU with local APIC %u did not start, not starting the rest\n", m->apicId[i]);
+            break;
+        }
+        cpus++;
+    }
+    g_workers = g_cpus;
+    kprintf("SMP: %d CPU(s) running, idle ones %s\n", g_cpus, g_mwait ? "MWAIT" : "spin");
+    return g_cpus;
+}
+
+// ======= Benchmark =======
+#define BENCH_JOBS 64
+#define BENCH_EVALS 2000
+
+typedef struct {
+    const ExprProgram* prog;
+    const ExprEnv* env;
+    int first;
+    double sum;
+} __attribute__((aligned(64))) CalcJob;     // one cache line each: sum is written from any CPU
+
+static void calc_job(void* arg){
+    CalcJob* c = (CalcJob*)arg;
+    ExprEnv env = *c->env;
+    double sum = 0, v;
+    for(int i=0;i<BENCH_EVALS;i++){
+        expr_set(&env,"x",c->first+i);
+        if(expr_run(c->prog,&env,&v)==EXPR_OK) sum += v;
+    }
+    c->sum = sum;
+}
+
+void smp_benchmark(void){
+    static ExprProgram prog;
+    static ExprEnv env;
+    static CalcJob calc[BENCH_JOBS];
+    static Job jobs[BENCH_JOBS];
+    expr_env_init(&env);
+    expr_set(&env,"x",0);
+    if(expr_compile("(x*x+3*x-7)/(x%13+1)-x^2/(x+1)",&prog,&env)!=EXPR_OK) return;
+
+    UINT64 one = 0;
+    double expect = 0;
+    for(int w=1;w<=g_cpus;w++){
+        g_workers = w;
+        for(int i=0;i<g_cpus;i++) g_deque[i].ran = g_deque[i].stolen = 0;
+        JobGroup g;
+        job_group_init(&g);
+        UINT64 t0 = rdtsc();
+        for(int i=0;i<BENCH_JOBS;i++){
+            calc[i].prog = &prog;
+            calc[i].env = &env;
+            calc[i].first = i*BENCH_EVALS;
+            job_submit(&g,&jobs[i],calc_job,&calc[i]);
+        }
+        job_wait(&g);
+        UINT64 t = rdtsc()-t0;
+        double sum = 0;
+        for(int i=0;i<BENCH_JOBS;i++) sum += calc[i].sum;
+        if(w==1){ one = t; expect = sum; }
+        UINT64 x100 = t ? one*100/t : 0;
+        kprintf("smp bench: %d CPU(s) %llu us, speedup %llu.%02llu%s\n", w, cycles_to_ns(t)/1000,
+                x100/100, x100%100, sum==expect ? "" : " (results differ!)");
+    }
+    for(int i=0;i<g_cpus;i++)
+        kprintf("  cpu %d (APIC %u): %u jobs run, %u stolen\n", i, g_apicId[i], g_deque[i].ran, g_deque[i].stolen);
+    g_workers = g_cpus;
+}
@@ -0,0 +1,39 @@
+#ifndef _SMP_H_
+#define _SMP_H_
+
+#include "kernel.h"
+
+// ======= Other CPUs and the job pool =======
+// smp_init finds the processors in the ACPI MADT and starts each one through
+// the local APIC. Threads (sched.c) and interrupts stay on the boot CPU; the
+// others only run jobs. Every CPU has a deque of jobs: it pushes and pops at
+// the bottom, and an idle CPU steals from the top of another's. A job runs
+// with interrupts off on those CPUs, so it must not block, sleep or allocate
+// (the heap and the PMM only mask interrupts on the boot CPU); it may submit
+// and wait for jobs of its own.
+typedef struct {
+    volatile UINT32 pending;
+} JobGroup;
+
+typedef struct Job {
+    void (*fn)(void* arg);
+    void* arg;
+    JobGroup* group;
+} Job;
+
+// Needs the heap, paging and sched_init. Returns the number of CPUs running
+int smp_init(void);
+int smp_cpu_count(void);
+int smp_cpu_index(void);           // 0 is the boot CPU
+
+// The Job stays the caller's until job_wait on its group returns. When the
+// deque is full the job runs right away instead.
+void job_group_init(JobGroup* g);
+void job_submit(JobGroup* g,Job* j,void (*fn)(void*),void* arg);
+// Runs and steals jobs until every job of the group has finished
+void job_wait(JobGroup* g);
+
+// A batch of calculator jobs on 1..N CPUs, with the speedup, via kprintf
+void smp_benchmark(void);
+
+#endif
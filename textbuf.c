@@ -0,0 +1,338 @@
+#include "textbuf.h"
+#include "heap.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "kstring.h"
+
+#define INITIAL_CAP 256
+#define INITIAL_LINES 64
+
+int tb_init(TextBuf* tb){
+    tb->buf = (char*)kmalloc(INITIAL_CAP);
+    tb->cap = tb->buf ? ksize(tb->buf) : 0;
+    tb->gapStart = 0;
+    tb->gapEnd = tb->cap;
+    tb->lines = (UINT32*)kmalloc(INITIAL_LINES*sizeof(UINT32));
+    tb->lineCap = tb->lines ? ksize(tb->lines)/sizeof(UINT32) : 0;
+    tb->lineGapStart = 0;
+    tb->lineGapEnd = tb->lineCap;
+    tb->lineStart = tb->lineLen = 0;
+    tb->ops = 0; tb->nops = tb->capOps = tb->done = 0;
+    tb->pool = 0; tb->poolLen = tb->poolCap = 0;
+    if(!tb->buf || !tb->lines){ tb_free(tb); return 0; }
+    return 1;
+}
+
+void tb_free(TextBuf* tb){
+    kfree(tb->buf);
+    kfree(tb->lines);
+    kfree(tb->ops);
+    kfree(tb->pool);
+    tb->buf = 0; tb->lines = 0; tb->ops = 0; tb->pool = 0;
+    tb->cap = tb->gapStart = tb->gapEnd = 0;
+    tb->lineCap = tb->lineGapStart = tb->lineGapEnd = 0;
+    tb->lineStart = tb->lineLen = 0;
+    tb->nops = tb->capOps = tb->done = 0;
+    tb->poolLen = tb->poolCap = 0;
+}
+
+void tb_clear(TextBuf* tb){
+    tb->gapStart = 0;
+    tb->gapEnd = tb->cap;
+    tb->lineGapStart = 0;
+    tb->lineGapEnd = tb->lineCap;
+    tb->lineStart = tb->lineLen = 0;
+    tb->nops = tb->done = 0;
+    tb->poolLen = 0;
+}
+
+UINT32 tb_length(const TextBuf* tb){ return tb->cap-(tb->gapEnd-tb->gapStart); }
+UINT32 tb_cursor(const TextBuf* tb){ return tb->gapStart; }
+
+char tb_char_at(const TextBuf* tb,UINT32 pos){
+    if(pos<tb->gapStart) return tb->buf[pos];
+    pos += tb->gapEnd-tb->gapStart;
+    return pos<tb->cap ? tb->buf[pos] : 0;
+}
+
+UINT32 tb_read(const TextBuf* tb,UINT32 pos,char* out,UINT32 n){
+    UINT32 len = tb_length(tb);
+    if(pos>=len) return 0;
+    if(n>len-pos) n=len-pos;
+    UINT32 before = pos<tb->gapStart ? tb->gapStart-pos : 0;
+    if(before>n) before=n;
+    // the part before the gap, then the part after it
+    kmemcpy(out,tb->buf+pos,before);
+    if(n>before) kmemcpy(out+before,tb->buf+tb->gapEnd+(pos+before-tb->gapStart),n-before);
+    return n;
+}
+
+void tb_set_cursor(TextBuf* tb,UINT32 pos){
+    UINT32 len = tb_length(tb);
+    if(pos>len) pos=len;
+    if(pos<tb->gapStart){
+        UINT32 n = tb->gapStart-pos;
+        // stepping back over a newline makes the previous line current
+        for(UINT32 i=pos;i<tb->gapStart;i++){
+            if(tb->buf[i]!='\n') continue;
+            UINT32 prev = tb->lines[--tb->lineGapStart];    // take before giving: the gap may be empty
+            tb->lines[--tb->lineGapEnd] = tb->lineLen;
+            tb->lineLen = prev;
+            tb->lineStart -= prev;
+        }
+        kmemmove(tb->buf+tb->gapEnd-n, tb->buf+pos, n);
+        tb->gapStart -= n; tb->gapEnd -= n;
+    }else if(pos>tb->gapStart){
+        UINT32 n = pos-tb->gapStart;
+        for(UINT32 i=0;i<n;i++){
+            if(tb->buf[tb->gapEnd+i]!='\n') continue;
+            UINT32 next = tb->lines[tb->lineGapEnd++];
+            tb->lines[tb->lineGapStart++] = tb->lineLen;
+            tb->lineStart += tb->lineLen;
+            tb->lineLen = next;
+        }
+        kmemmove(tb->buf+tb->gapStart, tb->buf+tb->gapEnd, n);
+        tb->gapStart += n; tb->gapEnd += n;
+    }
+}
+
+// ======= Line index =======
+UINT32 tb_line_count(const TextBuf* tb){ return tb->lineGapStart+1+(tb->lineCap-tb->lineGapEnd); }
+UINT32 tb_cursor_line(const TextBuf* tb){ return tb->lineGapStart; }
+UINT32 tb_cursor_col(const TextBuf* tb){ return tb->gapStart-tb->lineStart; }
+
+// Length of a line other than the cursor's, including its '\n'
+static UINT32 stored_len(const TextBuf* tb,UINT32 line){
+    if(line<tb->lineGapStart) return tb->lines[line];
+    return tb->lines[tb->lineGapEnd+(line-tb->lineGapStart-1)];
+}
+
+UINT32 tb_line_start(const TextBuf* tb,UINT32 line){
+    UINT32 cur = tb->lineGapStart;
+    UINT32 count = tb_line_count(tb);
+    if(line>=count) return tb_length(tb);
+    UINT32 pos = tb->lineStart;
+    if(line<cur){
+        for(UINT32 l=line;l<cur;l++) pos -= stored_len(tb,l);
+    }else if(line>cur){
+        pos += tb->lineLen;
+        for(UINT32 l=cur+1;l<line;l++) pos += stored_len(tb,l);
+    }
+    return pos;
+}
+
+UINT32 tb_line_length(const TextBuf* tb,UINT32 line){
+    UINT32 count = tb_line_count(tb);
+    if(line>=count) return 0;
+    UINT32 n = line==tb->lineGapStart ? tb->lineLen : stored_len(tb,line);
+    return line+1<count ? n-1 : n;      // only the last line has no '\n'
+}
+
+static int reserve_lines(TextBuf* tb,UINT32 n){
+    if(tb->lineGapEnd-tb->lineGapStart >= n) return 1;
+    UINT32 used = tb->lineCap-(tb->lineGapEnd-tb->lineGapStart);
+    UINT32 cap = tb->lineCap ? tb->lineCap*2 : INITIAL_LINES;
+    while(cap-used < n) cap*=2;
+    UINT32* nl = (UINT32*)kmalloc(cap*sizeof(UINT32));
+    if(!nl) return 0;
+    cap = ksize(nl)/sizeof(UINT32);
+    UINT32 tail = tb->lineCap-tb->lineGapEnd;
+    kmemcpy(nl,tb->lines,tb->lineGapStart*sizeof(UINT32));
+    kmemcpy(nl+cap-tail,tb->lines+tb->lineGapEnd,tail*sizeof(UINT32));
+    kfree(tb->lines);
+    tb->lines = nl;
+    tb->lineGapEnd = cap-tail;
+    tb->lineCap = cap;
+    return 1;
+}
+
+// Make room for at least n more bytes by doubling; the gap stays at the cursor
+static int reserve(TextBuf* tb,UINT32 n){
+    if(tb->gapEnd-tb->gapStart >= n) return 1;
+    UINT32 len = tb_length(tb);
+    UINT32 cap = tb->cap ? tb->cap*2 : INITIAL_CAP;
+    while(cap-len < n) cap*=2;
+    char* nb = (char*)kmalloc(cap);
+    if(!nb) return 0;
+    cap = ksize(nb);
+    UINT32 tail = tb->cap-tb->gapEnd;
+    kmemcpy(nb, tb->buf, tb->gapStart);
+    kmemcpy(nb+cap-tail, tb->buf+tb->gapEnd, tail);
+    kfree(tb->buf);
+    tb->buf = nb;
+    tb->gapEnd = cap-tail;
+    tb->cap = cap;
+    return 1;
+}
+
+// ======= Raw edits (no history) =======
+static int raw_insert(TextBuf* tb,const char* s,UINT32 n){
+    UINT32 newlines=0;
+    for(UINT32 i=0;i<n;i++) if(s[i]=='\n') newlines++;
+    if(!reserve(tb,n) || !reserve_lines(tb,newlines)) return 0;
+    for(UINT32 i=0;i<n;i++){
+        if(s[i]=='\n'){
+            // split the cursor's line: the part up to the newline moves behind the cursor
+            UINT32 col = tb->gapStart-tb->lineStart;
+            tb->lines[tb->lineGapStart++] = col+1;
+            tb->lineStart += col+1;
+            tb->lineLen -= col;
+        }else{
+            tb->lineLen++;
+        }
+        tb->buf[tb->gapStart++]=s[i];
+    }
+    return 1;
+}
+
+static void raw_delete(TextBuf* tb,UINT32 pos,UINT32 n,char* saved){
+    tb_set_cursor(tb,pos);
+    for(UINT32 i=0;i<n;i++){
+        char c = tb->buf[tb->gapEnd+i];
+        if(saved) saved[i]=c;
+        // removing a newline joins the next line onto the cursor's line
+        if(c=='\n') tb->lineLen += tb->lines[tb->lineGapEnd++]-1;
+        else tb->lineLen--;
+    }
+    tb->gapEnd += n;
+}
+
+// ======= History =======
+// An edit that could not be recorded leaves the text out of step with the
+// log, so older ops would be undone at the wrong places: drop them all
+static int forget(TextBuf* tb){
+    tb->nops = tb->done = 0;
+    tb->poolLen = 0;
+    return 0;
+}
+
+static int record(TextBuf* tb,UINT8 kind,UINT32 pos,const char* text,UINT32 n){
+    // a new edit discards anything that could have been redone
+    tb->nops = tb->done;
+    tb->poolLen = tb->done ? tb->ops[tb->done-1].text+tb->ops[tb->done-1].len : 0;
+    if(tb->poolLen+n > tb->poolCap){
+        UINT32 c = tb->poolCap ? tb->poolCap*2 : 256;
+        while(c < tb->poolLen+n) c*=2;
+        char* np = (char*)krealloc(tb->pool,c);
+        if(!np) return forget(tb);
+        tb->pool = np; tb->poolCap = c;
+    }
+
+    // typing continues the previous insert until a newline, so undo removes a word-sized run
+    if(kind==EDIT_INSERT && tb->done){
+        EditOp* last = &tb->ops[tb->done-1];
+        if(last->kind==EDIT_INSERT && last->pos+last->len==pos &&
+           tb->pool[tb->poolLen-1]!='\n' && text[0]!='\n'){
+            kmemcpy(tb->pool+tb->poolLen,text,n);
+            tb->poolLen += n;
+            last->len += n;
+            return 1;
+        }
+    }
+    if(tb->nops==tb->capOps){
+        UINT32 c = tb->capOps ? tb->capOps*2 : 64;
+        EditOp* no = (EditOp*)krealloc(tb->ops,c*sizeof(EditOp));
+        if(!no) return forget(tb);
+        tb->ops = no; tb->capOps = c;
+    }
+    EditOp* op = &tb->ops[tb->nops++];
+    op->kind = kind; op->pos = pos; op->len = n; op->text = tb->poolLen;
+    kmemcpy(tb->pool+tb->poolLen,text,n);
+    tb->poolLen += n;
+    tb->done = tb->nops;
+    return 1;
+}
+
+int tb_insert(TextBuf* tb,const char* s,UINT32 n){
+    if(n==0) return 1;
+    UINT32 pos = tb->gapStart;
+    if(!raw_insert(tb,s,n)) return 0;
+    record(tb,EDIT_INSERT,pos,s,n);     // history is best effort (cleared if out of memory); the edit stands
+    return 1;
+}
+
+int tb_load(TextBuf* tb,const char* s,UINT32 n){
+    return raw_insert(tb,s,n);
+}
+
+int tb_delete_back(TextBuf* tb){
+    if(tb->gapStart==0) return 0;
+    char c;
+    raw_delete(tb,tb->gapStart-1,1,&c);
+    record(tb,EDIT_DELETE,tb->gapStart,&c,1);
+    return 1;
+}
+
+int tb_delete_forward(TextBuf* tb){
+    if(tb->gapEnd==tb->cap) return 0;
+    char c;
+    raw_delete(tb,tb->gapStart,1,&c);
+    record(tb,EDIT_DELETE,tb->gapStart,&c,1);
+    return 1;
+}
+
+int tb_undo(TextBuf* tb){
+    if(tb->done==0) return 0;
+    EditOp* op = &tb->ops[--tb->done];
+    if(op->kind==EDIT_INSERT){
+        raw_delete(tb,op->pos,op->len,0);
+    }else{
+        tb_set_cursor(tb,op->pos);
+        if(!raw_insert(tb,tb->pool+op->text,op->len)){ tb->done++; return 0; }
+    }
+    return 1;
+}
+
+int tb_redo(TextBuf* tb){
+    if(tb->done==tb->nops) return 0;
+    EditOp* op = &tb->ops[tb->done];
+    if(op->kind==EDIT_INSERT){
+        tb_set_cursor(tb,op->pos);
+        if(!raw_insert(tb,tb->pool+op->text,op->len)) return 0;
+    }else{
+        raw_delete(tb,op->pos,op->len,0);
+    }
+    tb->done++;
+    return 1;
+}
+
+// ======= Benchmark =======
+// One keystroke as the editor sees it: type a character, then answer the
+// viewport's questions (cursor line/column, start of the top line, visible text).
+#define BENCH_KEYS 2000
+#define BENCH_VIEW_ROWS 21
+#define BENCH_VIEW_COLS 76
+
+static volatile UINT32 g_benchSink;     // keeps the viewport reads from being optimised away
+
+void tb_benchmark(void){
+    static const char line[] = "The quick brown fox jumps over the lazy dog, again and again.  \n";
+    for(UINT32 size=16*1024; size<=1024*1024; size*=4){
+        TextBuf tb;
+        if(!tb_init(&tb)) return;
+        int ok=1;
+        for(UINT32 n=0;n<size && ok;n+=sizeof(line)-1) ok=tb_load(&tb,line,sizeof(line)-1);
+        if(!ok){ tb_free(&tb); kprintf("textbuf bench: out of memory at %u bytes\n",size); return; }
+        tb_set_cursor(&tb,tb_length(&tb)/2);
+
+        UINT32 sink=0;
+        UINT64 t0 = rdtsc();
+        for(int k=0;k<BENCH_KEYS;k++){
+            tb_insert(&tb,"x",1);
+            UINT32 cur = tb_cursor_line(&tb);
+            UINT32 top = cur>BENCH_VIEW_ROWS/2 ? cur-BENCH_VIEW_ROWS/2 : 0;
+            UINT32 pos = tb_line_start(&tb,top);
+            for(UINT32 r=0;r<BENCH_VIEW_ROWS;r++){
+                UINT32 n = tb_line_length(&tb,top+r);
+                for(UINT32 c=0;c<n && c<BENCH_VIEW_COLS;c++) sink += (UINT8)tb_char_at(&tb,pos+c);
+                pos += n+1;
+            }
+            sink += tb_cursor_col(&tb);
+        }
+        UINT64 cycles = rdtsc()-t0;
+        g_benchSink = sink;
+        kprintf("textbuf bench: %u KiB, %u lines: %llu ns/keystroke\n",
+                tb_length(&tb)/1024, tb_line_count(&tb), cycles_to_ns(cycles)/BENCH_KEYS);
+        tb_free(&tb);
+    }
+}
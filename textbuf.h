@@ -0,0 +1,75 @@
+#ifndef _TEXTBUF_H_
+#define _TEXTBUF_H_
+
+#include "kernel.h"
+
+// ======= Editor text engine =======
+// A gap buffer: text before the cursor sits at the start of 'buf', text after it
+// at the end, and the unused gap in between moves with the cursor. Inserting or
+// deleting at the cursor is O(1); moving the cursor costs the distance moved.
+// Every edit is recorded so it can be undone and redone.
+//
+// Line lengths are kept in a second gap array whose gap sits at the cursor's
+// line, updated as each byte is inserted, deleted or crossed by the cursor, so
+// the cursor's line/column and the start of nearby lines never need a scan.
+typedef struct {
+    UINT8 kind;              // EDIT_INSERT or EDIT_DELETE
+    UINT32 pos;
+    UINT32 len;
+    UINT32 text;             // offset of the affected text in the undo pool
+} EditOp;
+
+typedef struct {
+    char* buf;
+    UINT32 cap;
+    UINT32 gapStart;         // == cursor position
+    UINT32 gapEnd;
+
+    UINT32* lines;           // lengths (with '\n') of lines before and after the cursor's line
+    UINT32 lineCap;
+    UINT32 lineGapStart;     // == cursor line
+    UINT32 lineGapEnd;
+    UINT32 lineStart;        // offset of the cursor's line
+    UINT32 lineLen;          // its length, including the '\n' if it has one
+
+    EditOp* ops;             // ops[0..done) can be undone, ops[done..nops) redone
+    UINT32 nops, capOps, done;
+    char* pool;
+    UINT32 poolLen, poolCap;
+} TextBuf;
+
+#define EDIT_INSERT 1
+#define EDIT_DELETE 2
+
+int tb_init(TextBuf* tb);
+void tb_free(TextBuf* tb);
+void tb_clear(TextBuf* tb);                  // empty text and history
+
+UINT32 tb_length(const TextBuf* tb);
+UINT32 tb_cursor(const TextBuf* tb);
+char tb_char_at(const TextBuf* tb,UINT32 pos);
+UINT32 tb_read(const TextBuf* tb,UINT32 pos,char* out,UINT32 n);
+
+void tb_set_cursor(TextBuf* tb,UINT32 pos);
+
+// Line index. Lines are numbered from 0; a lookup costs the distance from the cursor's line.
+UINT32 tb_line_count(const TextBuf* tb);
+UINT32 tb_cursor_line(const TextBuf* tb);
+UINT32 tb_cursor_col(const TextBuf* tb);
+UINT32 tb_line_start(const TextBuf* tb,UINT32 line);
+UINT32 tb_line_length(const TextBuf* tb,UINT32 line);   // without the '\n'
+
+// Edits at the cursor; return 0 when out of memory
+int tb_insert(TextBuf* tb,const char* s,UINT32 n);
+int tb_delete_back(TextBuf* tb);             // Backspace
+int tb_delete_forward(TextBuf* tb);          // Delete
+int tb_load(TextBuf* tb,const char* s,UINT32 n);   // insert without history (loading a file)
+
+// Step through the history; the cursor ends up at the edit. 0 if nothing to do.
+int tb_undo(TextBuf* tb);
+int tb_redo(TextBuf* tb);
+
+// Per-keystroke cost (edit + viewport queries) against document size, logged at boot
+void tb_benchmark(void);
+
+#endif
@@ -0,0 +1,390 @@
+#include "ui.h"
+#include "hal.h"
+#include "keyboard.h"
+#include "keymap.h"
+#include "kprintf.h"
+#include "kstring.h"
+
+static volatile UINT16* TERMINAL_BUFFER;
+static unsigned int VGA_INDEX = 0;
+static int Y_INDEX = 0;
+
+// ======= Back buffer =======
+// All drawing lands in an off-screen copy of the 80x25 text page. Each row keeps
+// the span of columns that changed since the last vga_flush(), and only cells in
+// those spans that differ from what is on screen (g_front) are written to video
+// memory (MMIO writes are slow under virtualization).
+static UINT16 g_back[VGA_WIDTH*VGA_HEIGHT];
+static UINT16 g_front[VGA_WIDTH*VGA_HEIGHT];
+static UINT8 g_dirtyLo[VGA_HEIGHT];
+static UINT8 g_dirtyHi[VGA_HEIGHT];
+static VgaStats g_vgaStats;
+
+// Graphics mode: the same cells drawn as glyphs, centred on a surface
+static Surface* g_surface = 0;
+static int g_originX, g_originY;
+
+static void markDirty(int row,int lo,int hi){
+    if(g_dirtyLo[row]>g_dirtyHi[row]){ g_dirtyLo[row]=lo; g_dirtyHi[row]=hi; return; }
+    if(lo<g_dirtyLo[row]) g_dirtyLo[row]=lo;
+    if(hi>g_dirtyHi[row]) g_dirtyHi[row]=hi;
+}
+
+static void backPut(int idx,UINT16 v){
+    if(g_back[idx]==v) return;
+    g_back[idx]=v;
+    markDirty(idx/VGA_WIDTH,idx%VGA_WIDTH,idx%VGA_WIDTH);
+}
+
+// Whole runs of cells are stored without comparing first; the flush still
+// only writes the ones that differ from g_front
+static void backFill(int row,int col,int len,UINT16 v){
+    if(len<=0) return;
+    kmemset16(&g_back[row*VGA_WIDTH+col],v,len);
+    markDirty(row,col,col+len-1);
+}
+
+static void backCopyRow(int row,const UINT16* src){
+    kmemcpy(&g_back[row*VGA_WIDTH],src,VGA_WIDTH*sizeof(UINT16));
+    markDirty(row,0,VGA_WIDTH-1);
+}
+
+static void vgaInit(void){
+    // Adopt whatever is on screen so the first flush only touches real changes
+    for(int i=0;i<VGA_WIDTH*VGA_HEIGHT;i++) g_back[i]=g_front[i]=TERMINAL_BUFFER[i];
+    for(int r=0;r<VGA_HEIGHT;r++){ g_dirtyLo[r]=1; g_dirtyHi[r]=0; }
+}
+
+// ======= VGA helpers =======
+static UINT16 vgaEntry(unsigned char ch) {
+    return (UINT16)ch | ((UINT16)WHITE_COLOR << 8);
+}
+
+// ======= Console with scrollback =======
+// printChar and friends append to a ring of CONSOLE_SCROLLBACK lines. A newline
+// only advances the ring index and clears one line; nothing is moved. While the
+// console is on screen, the visible window is copied from the ring into the back
+// buffer once per vga_flush(), no matter how many lines were printed meanwhile.
+#ifndef CONSOLE_SCROLLBACK
+#define CONSOLE_SCROLLBACK 512               // lines of history (override with -D)
+#endif
+#define CONSOLE_ROWS (VGA_HEIGHT-1)          // last row is the status line
+
+static UINT16 g_conRing[CONSOLE_SCROLLBACK][VGA_WIDTH];
+static unsigned int g_conLine = 0;           // absolute number of the line being written
+static int g_conCol = 0;
+static int g_conScroll = 0;                  // lines scrolled back from the bottom
+static int g_conVisible = 0;
+static int g_conDirty = 0;
+
+static void conClearLine(unsigned int line){
+    kmemset16(g_conRing[line % CONSOLE_SCROLLBACK],vgaEntry(' '),VGA_WIDTH);
+}
+
+static unsigned int conOldest(void){
+    return g_conLine >= CONSOLE_SCROLLBACK ? g_conLine-CONSOLE_SCROLLBACK+1 : 0;
+}
+
+static void conScrollBy(int delta){
+    int maxBack = (int)(g_conLine-conOldest()) - (CONSOLE_ROWS-1);
+    if(maxBack<0) maxBack=0;
+    g_conScroll += delta;
+    if(g_conScroll>maxBack) g_conScroll=maxBack;
+    if(g_conScroll<0) g_conScroll=0;
+    g_conDirty = 1;
+}
+
+static void scrollIfNeeded(void) {
+    if(g_conCol >= VGA_WIDTH) {
+        g_conLine++;
+        g_conCol = 0;
+        conClearLine(g_conLine);
+        // keep a scrolled-back view pinned to the same text
+        if(g_conScroll>0) conScrollBy(1);
+    }
+    g_conDirty = 1;
+}
+
+static void printChar(char c) {
+    if(c=='\n'){
+        g_conCol = VGA_WIDTH;
+        scrollIfNeeded();
+        return;
+    }
+    g_conRing[g_conLine % CONSOLE_SCROLLBACK][g_conCol++] = vgaEntry(c);
+    scrollIfNeeded();
+}
+
+static void printString(const char* str) {
+    for(int i=0;str[i];i++) printChar(str[i]);
+}
+
+void console_write(const char* s){
+    printString(s);
+}
+
+static void conPresent(void){
+    // bottom visible line is g_conLine-g_conScroll; lines before the oldest are blank
+    int bottom = (int)g_conLine - g_conScroll;
+    for(int r=0;r<CONSOLE_ROWS;r++){
+        int line = bottom-(CONSOLE_ROWS-1)+r;
+        if(line<(int)conOldest()) backFill(r,0,VGA_WIDTH,vgaEntry(' '));
+        else backCopyRow(r,g_conRing[line % CONSOLE_SCROLLBACK]);
+    }
+    g_conDirty = 0;
+}
+
+// Redraw the changed part of a dirty span as one run of glyphs, which costs
+// less than starting a new run at every unchanged cell
+static unsigned int surfacePresentRow(int r,int lo,int hi){
+    UINT16* src=&g_back[r*VGA_WIDTH];
+    UINT16* shadow=&g_front[r*VGA_WIDTH];
+    while(lo<=hi && shadow[lo]==src[lo]) lo++;
+    while(hi>=lo && shadow[hi]==src[hi]) hi--;
+    if(lo>hi) return 0;
+    gfx_cells(g_surface,g_originX+lo*GLYPH_W,g_originY+r*GLYPH_H,&src[lo],hi-lo+1);
+    kmemcpy(&shadow[lo],&src[lo],(hi-lo+1)*sizeof(UINT16));
+    return hi-lo+1;
+}
+
+void vga_flush(void){
+    if(g_conVisible && g_conDirty) conPresent();
+    unsigned int cells=0;
+    for(int r=0;r<VGA_HEIGHT;r++){
+        int lo=g_dirtyLo[r], hi=g_dirtyHi[r];
+        if(lo>hi) continue;
+        g_dirtyLo[r]=1; g_dirtyHi[r]=0;
+        if(g_surface){ cells+=surfacePresentRow(r,lo,hi); continue; }
+        UINT16* src=&g_back[r*VGA_WIDTH];
+        UINT16* shadow=&g_front[r*VGA_WIDTH];
+        volatile UINT16* dst=&TERMINAL_BUFFER[r*VGA_WIDTH];
+        for(int c=lo;c<=hi;c++){
+            if(shadow[c]==src[c]) continue;
+            dst[c]=shadow[c]=src[c];
+            cells++;
+        }
+    }
+    g_vgaStats.frames++;
+    g_vgaStats.lastCells=cells;
+    g_vgaStats.totalCells+=cells;
+}
+
+const VgaStats* vga_stats(void){ return &g_vgaStats; }
+
+void ui_set_surface(Surface* s){
+    g_surface=s;
+    if(s){
+        g_originX=(s->width-VGA_WIDTH*GLYPH_W)/2;
+        g_originY=(s->height-VGA_HEIGHT*GLYPH_H)/2;
+        gfx_fill(s,0,0,s->width,s->height,gfx_rgb(s,0));
+    }
+    // nothing on the new target matches g_front: the next flush repaints all
+    for(int i=0;i<VGA_WIDTH*VGA_HEIGHT;i++) g_front[i]=(UINT16)~g_back[i];
+    for(int r=0;r<VGA_HEIGHT;r++) markDirty(r,0,VGA_WIDTH-1);
+}
+
+void ui_init(void){
+    TERMINAL_BUFFER=hal_text_page();
+    VGA_INDEX=0; Y_INDEX=0;
+    vgaInit();
+    conClearLine(0);
+}
+
+void clearScreen(void) {
+    kmemset16(g_back,vgaEntry(' '),VGA_WIDTH*VGA_HEIGHT);
+    for(int r=0;r<VGA_HEIGHT;r++) markDirty(r,0,VGA_WIDTH-1);
+    VGA_INDEX = 0;
+    Y_INDEX = 0;
+    g_conVisible = 0;   // apps own the screen until the console is shown again
+}
+
+// ======= Simple GUI helpers (text-mode) =======
+void setCursor(int row,int col){
+    if(row<0) row=0;
+    if(col<0) col=0;
+    if(row>=VGA_HEIGHT) row=VGA_HEIGHT-1;
+    if(col>=VGA_WIDTH) col=VGA_WIDTH-1;
+    Y_INDEX = row;
+    VGA_INDEX = row*VGA_WIDTH + col;
+}
+
+void putCharAt(int row,int col,char c){
+    if(row<0||row>=VGA_HEIGHT||col<0||col>=VGA_WIDTH) return;
+    backPut(row*VGA_WIDTH + col, vgaEntry(c));
+}
+
+void writeAt(int row,int col,const char* s){
+    for(int i=0;s[i] && (col+i)<VGA_WIDTH;i++){
+        putCharAt(row,col+i,s[i]);
+    }
+}
+
+void fillAt(int row,int col,int len,char ch){
+    if(row<0||row>=VGA_HEIGHT) return;
+    if(col<0){ len+=col; col=0; }
+    if(len>VGA_WIDTH-col) len=VGA_WIDTH-col;
+    backFill(row,col,len,vgaEntry(ch));
+}
+
+void drawBox(int top,int left,int bottom,int right,const char* title){
+    if(top<0) top=0;
+    if(left<0) left=0;
+    if(bottom>=VGA_HEIGHT) bottom=VGA_HEIGHT-1;
+    if(right>=VGA_WIDTH) right=VGA_WIDTH-1;
+    for(int c=left;c<=right;c++){ putCharAt(top,c,'-'); putCharAt(bottom,c,'-'); }
+    for(int r=top;r<=bottom;r++){ putCharAt(r,left,'|'); putCharAt(r,right,'|'); }
+    putCharAt(top,left,'+'); putCharAt(top,right,'+');
+    putCharAt(bottom,left,'+'); putCharAt(bottom,right,'+');
+    if(title){
+        int tlen=0; while(title[tlen]) tlen++;
+        int pos = left+2;
+        for(int i=0;i<tlen && pos+i<right;i++){
+            putCharAt(top,pos+i,title[i]);
+        }
+    }
+}
+
+void drawButton(int row,int col,const char* label,int width,int selected){
+    // simple button: [ label ] with optional highlight using angle brackets
+    char left = selected ? '<' : '[';
+    char right = selected ? '>' : ']';
+    putCharAt(row,col,left);
+    int lablen=0; while(label[lablen]) lablen++;
+    int pad = width-2;
+    int start = col+1;
+    // center label
+    int leftpad = (pad - lablen)/2; if(leftpad<0) leftpad=0;
+    int i=0;
+    for(int p=0;p<pad;p++){
+        char ch=' ';
+        if(p>=leftpad && i<lablen){ ch=label[i++]; }
+        putCharAt(row,start+p,ch);
+    }
+    putCharAt(row,col+width-1,right);
+}
+
+// ======= Input =======
+unsigned char next_key(void){
+    vga_flush();
+    return getkey();
+}
+
+int read_line_gui(int row,int col,char* out,int maxlen){
+    int len=0;
+    for(;;){
+        unsigned char sc = next_key();
+        if(sc==0x01){ // ESC cancel
+            out[0]='\0';
+            return 0;
+        }
+        if(sc==0x0E){ // backspace
+            if(len>0){
+                len--;
+                putCharAt(row,col+len,' ');
+            }
+            continue;
+        }
+        if(sc==0x1C){ // Enter
+            out[len]='\0';
+            return 1;
+        }
+        char c=scancode_to_ascii(sc);
+        if(c && len<maxlen-1){
+            out[len++]=c;
+            putCharAt(row,col+len-1,c);
+        }
+    }
+}
+
+// ======= String helpers =======
+void itoa10(int v,char* buf){
+    char tmp[16]; int n=0,neg=0;
+    if(v==0){buf[0]='0';buf[1]='\0';return;}
+    if(v<0){neg=1;v=-v;}
+    while(v>0 && n<16){tmp[n++]='0'+(v%10); v/=10;}
+    int i=0; if(neg) buf[i++]='-';
+    while(n--) buf[i++]=tmp[n];
+    buf[i]='\0';
+}
+
+// ======= App arena =======
+Arena g_appArena;
+
+void releaseAppArena(void){
+    if(g_appArena.chunks){
+        kprintf("App arena: released %u bytes in %u chunk(s)\n", g_appArena.bytes, g_appArena.chunks);
+    }
+    arena_release(&g_appArena);
+}
+
+// ======= Kernel log viewer =======
+void run_log_viewer(void){
+    clearScreen();
+    g_conVisible = 1;
+    g_conDirty = 1;
+    g_conScroll = 0;
+    for(;;){
+        // status line: which slice of the history is on screen
+        char a[12], b[12], n[12];
+        int bottom = (int)g_conLine - g_conScroll;
+        int top = bottom-(CONSOLE_ROWS-1);
+        if(top<(int)conOldest()) top=(int)conOldest();
+        itoa10(top+1,a); itoa10(bottom+1,b); itoa10((int)g_conLine+1,n);
+        fillAt(24,0,VGA_WIDTH,' ');
+        writeAt(24,1,"Log lines");
+        writeAt(24,11,a); writeAt(24,18,"-"); writeAt(24,20,b);
+        writeAt(24,27,"of"); writeAt(24,30,n);
+        writeAt(24,44,"PgUp/PgDn Up/Down Home/End ESC");
+
+        unsigned char sc = next_key();
+        if(sc==0x01) break;                              // ESC
+        if(sc==0x49) conScrollBy(CONSOLE_ROWS-1);        // Page Up
+        if(sc==0x51) conScrollBy(-(CONSOLE_ROWS-1));     // Page Down
+        if(sc==0x48) conScrollBy(1);                     // Up
+        if(sc==0x50) conScrollBy(-1);                    // Down
+        if(sc==0x47) conScrollBy(CONSOLE_SCROLLBACK);    // Home
+        if(sc==0x4F) conScrollBy(-CONSOLE_SCROLLBACK);   // End
+    }
+    g_conVisible = 0;
+}
+
+// ======= Benchmarks =======
+int ui_bench_clear_screen(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++) clearScreen();
+    return 1;
+}
+
+// Every cell changes, so each flush copies all 2000 cells to video memory
+int ui_bench_full_repaint(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++){
+        for(int r=0;r<VGA_HEIGHT;r++) fillAt(r,0,VGA_WIDTH,(char)('A'+(i&1)));
+        vga_flush();
+    }
+    return 1;
+}
+
+// Every cell drawn as a glyph, into an off-screen surface the size of the grid
+int ui_bench_gfx_redraw(UINT32 iters){
+    static Surface s;
+    if(!s.pixels){
+        void* p=kmalloc(VGA_WIDTH*GLYPH_W*VGA_HEIGHT*GLYPH_H*4);
+        if(!p) return 0;
+        gfx_surface(&s,p,VGA_WIDTH*GLYPH_W,VGA_HEIGHT*GLYPH_H,VGA_WIDTH*GLYPH_W*4,16,8,0);
+    }
+    for(UINT32 i=0;i<iters;i++)
+        for(int r=0;r<VGA_HEIGHT;r++) gfx_cells(&s,0,r*GLYPH_H,&g_back[r*VGA_WIDTH],VGA_WIDTH);
+    return 1;
+}
+
+int ui_bench_scroll(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++){
+        g_conCol = VGA_WIDTH;
+        scrollIfNeeded();
+    }
+    return 1;
+}
+
+int ui_bench_console_line(UINT32 iters){
+    for(UINT32 i=0;i<iters;i++) printString("The quick brown fox jumps over the lazy dog, then the log scrolls by a line.\n");
+    return 1;
+}
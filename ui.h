@@ -0,0 +1,55 @@
+#ifndef _UI_H_
+#define _UI_H_
+
+#include "kernel.h"
+#include "heap.h"
+#include "gfx.h"
+
+// ======= Text-mode UI =======
+// Back buffer, kernel log console, drawing helpers and line input shared by
+// the menu and the apps. Rows and columns are 0-based; the screen is
+// VGA_WIDTH x VGA_HEIGHT. Nothing is visible until vga_flush() (next_key()
+// flushes before it blocks).
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
+
+// Adopt what is on hal_text_page() and start an empty log
+void ui_init(void);
+
+// Present on a graphics surface instead of the text page (0 to go back); every
+// helper below keeps working on the same 80x25 grid
+void ui_set_surface(Surface* s);
+
+void clearScreen(void);       // also hides the log console
+void setCursor(int row,int col);
+void putCharAt(int row,int col,char c);
+void writeAt(int row,int col,const char* s);
+void fillAt(int row,int col,int len,char ch);
+void drawBox(int top,int left,int bottom,int right,const char* title);
+void drawButton(int row,int col,const char* label,int width,int selected);
+
+// Present the frame, then block for the next key press
+unsigned char next_key(void);
+
+// Read a short ASCII line at a fixed screen row/col; 0 if cancelled with ESC
+int read_line_gui(int row,int col,char* out,int maxlen);
+
+void itoa10(int v,char* buf);
+
+// Full-screen scrollback of the kernel log, until ESC
+void run_log_viewer(void);
+
+// ======= App arena =======
+// Apps take their working buffers from here; the menu drops everything in one
+// step when the app returns, so nothing an app allocates can leak.
+extern Arena g_appArena;
+void releaseAppArena(void);
+
+// Benchmark bodies for the console and screen (bench.h cases, 0 on failure)
+int ui_bench_clear_screen(UINT32 iters);
+int ui_bench_full_repaint(UINT32 iters);
+int ui_bench_gfx_redraw(UINT32 iters);
+int ui_bench_scroll(UINT32 iters);
+int ui_bench_console_line(UINT32 iters);
+
+#endif
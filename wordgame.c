@@ -0,0 +1,185 @@
+#include "wordgame.h"
+#include "ui.h"
+#include "keymap.h"
+#include "memfs.h"
+#include "diskfs.h"
+
+#define WORDS_FILE "words.txt"
+#define WORD_MAX 32     // letters are drawn two columns apart
+
+// The dictionary shipped in the initrd: one word per line, a-z only (other
+// lines are skipped). Copied into the app arena; 0 words if it is missing or
+// can't be read whole.
+static int load_words(const char*** out){
+    diskfs_lock();                  // reads move memfs's lookup hints too
+    MemFile* f=memfs_open(WORDS_FILE,0);
+    UINT32 size=memfs_size(f);
+    char* text = size ? (char*)arena_alloc(&g_appArena,size+1) : 0;
+    int got = text ? memfs_read(f,0,text,size) : 0;
+    diskfs_unlock();
+    if(!text || got!=(int)size) return 0;
+    text[size]='\n';
+    int lines=0;
+    for(UINT32 i=0;i<=size;i++) if(text[i]=='\n') lines++;
+    const char** list=(const char**)arena_alloc(&g_appArena,lines*sizeof(char*));
+    if(!list) return 0;
+    int count=0;
+    for(UINT32 start=0,i=0;i<=size;i++){
+        if(text[i]!='\n') continue;
+        UINT32 end=i;
+        if(end>start && text[end-1]=='\r') end--;
+        int ok = end>start && end-start<=WORD_MAX;
+        for(UINT32 j=start;j<end && ok;j++) ok = text[j]>='a' && text[j]<='z';
+        text[end]='\0';
+        if(ok) list[count++]=text+start;
+        start=i+1;
+    }
+    *out=list;
+    return count;
+}
+
+// ======= Word Guessing Game (Hangman-like, without graphics) =======
+void run_word_game(void){
+    static int word_index=0;
+    static const char* builtin[]={
+        "hello","world","friend","family","home","coffee","water","phone","music","movie",
+        "school","work","pizza","bread","happy","sad","love","time","today","night",
+        "morning","evening","summer","winter","spring","rain","sun","cloud","car","bus",
+        "train","apple","banana","orange","grape","milk","tea","sugar","chair","table",
+        "window","door","river","mountain","city","street","house","garden","computer",
+        "keyboard","mouse","screen","light","dark","smile","sleep","dream","game","play"
+    };
+    const char** words=builtin;
+    int num_words=load_words(&words);
+    if(!num_words) num_words=sizeof(builtin)/sizeof(builtin[0]);
+
+    for(;;){ // outer loop to allow "Next word" without exiting
+        const char* secret = words[word_index % num_words];
+        word_index++;
+
+        // state
+        char guessed[26]; int gcount=0;
+        int attempts_left=6;
+
+        clearScreen();
+        drawBox(0,0,24,79," Word Guess ");
+        writeAt(2,4,"Guess letters (a-z). H: next, V: vowel (-1). R: retry on loss. ESC:Menu");
+        writeAt(3,4,"Length: ");
+        // print length
+        int slen=0; while(secret[slen]) slen++;
+        char d1='0'+(slen/10); char d2='0'+(slen%10);
+        if(slen>=10){ putCharAt(3,12,d1); putCharAt(3,13,d2); } else { putCharAt(3,12,d2); }
+
+        int in_guessed(char ch){
+            for(int i=0;i<gcount;i++) if(guessed[i]==ch) return 1;
+            return 0;
+        }
+        int all_revealed(void){
+            for(int i=0;secret[i];i++){
+                char ch=secret[i];
+                int found=0;
+                for(int j=0;j<gcount;j++) if(guessed[j]==ch){ found=1; break; }
+                if(!found) return 0;
+            }
+            return 1;
+        }
+        void render(void){
+            // masked word
+            fillAt(4,4,70,' ');
+            int col=4;
+            for(int i=0;secret[i];i++){
+                char ch=secret[i];
+                int show=in_guessed(ch);
+                putCharAt(4,col, show? ch : '_'); col+=2;
+            }
+            // attempts
+            fillAt(6,4,30,' ');
+            writeAt(6,4,"Attempts left: ");
+            int t=attempts_left; if(t<0)t=0;
+            if(t>=10){ putCharAt(6,19,'1'); putCharAt(6,20,'0'); } else { putCharAt(6,19,'0'+t); }
+            // guessed letters
+            fillAt(8,4,70,' ');
+            writeAt(8,4,"Guessed: ");
+            for(int i=0;i<gcount;i++){ putCharAt(8,14+i*2,guessed[i]); }
+        } render();
+
+        for(;;){
+            if(all_revealed()){
+                writeAt(10,4,"You win! N: Next word, ESC: Exit.");
+            }
+            if(attempts_left==0 && !all_revealed()){
+                writeAt(10,4,"You lose! R: Retry, ESC: Exit.");
+                // Do not reveal the secret word
+                fillAt(12,4,72,' ');
+            }
+            unsigned char sc = next_key();
+            if(sc==0x01) return; // ESC
+            char c=scancode_to_ascii(sc);
+            // Retry same word after loss
+            if((c=='r'||c=='R') && attempts_left==0 && !all_revealed()){
+                gcount=0;
+                attempts_left=6;
+                // clear message lines
+                fillAt(10,4,72,' ');
+                fillAt(12,4,72,' ');
+                render();
+                continue;
+            }
+            // Next word if already won
+            if((c=='n'||c=='N') && all_revealed()){
+                break; // break inner loop, outer loop continues to next word
+            }
+            // Hint: reveal next unrevealed letter (left-to-right), cost 1 attempt
+            if(c=='h' && attempts_left>0 && !all_revealed()){
+                for(int i=0;secret[i];i++){
+                    char ch=secret[i];
+                    if(!in_guessed(ch)){
+                        guessed[gcount++]=ch;
+                        attempts_left--;
+                        break;
+                    }
+                }
+                render();
+                continue;
+            }
+            // Vowel hint
+            if(c=='v' && attempts_left>0 && !all_revealed()){
+                const char* vowels="aeiou";
+                int revealed=0;
+                for(int i=0;vowels[i] && !revealed;i++){
+                    char vw=vowels[i];
+                    for(int j=0;secret[j];j++){
+                        if(secret[j]==vw && !in_guessed(vw)){
+                            guessed[gcount++]=vw;
+                            attempts_left--;
+                            revealed=1;
+                            break;
+                        }
+                    }
+                }
+                // If no vowel left, fall back to next unrevealed
+                if(!revealed){
+                    for(int i=0;secret[i];i++){
+                        char ch=secret[i];
+                        if(!in_guessed(ch)){
+                            guessed[gcount++]=ch;
+                            attempts_left--;
+                            break;
+                        }
+                    }
+                }
+                render();
+                continue;
+            }
+            if(c>='a'&&c<='z' && attempts_left>0 && !all_revealed()){
+                if(!in_guessed(c)){
+                    guessed[gcount++]=c;
+                    // if guess not in secret, consume attempt
+                    int hit=0; for(int i=0;secret[i];i++) if(secret[i]==c){ hit=1; break; }
+                    if(!hit) attempts_left--;
+                }
+                render();
+            }
+        } // end inner loop
+    } // continue with next word
+}
@@ -0,0 +1,7 @@
+#ifndef _WORDGAME_H_
+#define _WORDGAME_H_
+
+// Hangman-style word guessing game; returns on ESC
+void run_word_game(void);
+
+#endif